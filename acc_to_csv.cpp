@@ -31,7 +31,7 @@ int main(int argc, char** argv) {
   //   {7, 10}                                                                                                                                                                                                                                
   // ;                                                                                                                                                                                                
   vector<PTF::Gantry> gantries = {PTF::Gantry0, PTF::Gantry1};                                       
-  Wrapper wrapper = Wrapper(16384, 70, activePMTs, phidgets, gantries, PTF_CAEN_V1730);
+  Wrapper wrapper(activePMTs, phidgets, gantries, PTF_CAEN_V1730);
 
   unordered_set<int> skipLines = {};// {962,1923,2884,5240,6201,9611,10572,11533,12494,13455,15811,16771};                                                                                                                                    
 
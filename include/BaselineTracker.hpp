@@ -0,0 +1,64 @@
+#ifndef __BASELINETRACKER__
+#define __BASELINETRACKER__
+
+#include "WaveformConditioner.hpp"
+
+#include <string>
+#include <vector>
+
+class Configuration;
+
+/// Settings of the online baseline tracking, from the config file
+///
+/// baseline_tracking        use the tracked baseline instead of the BRB settings
+///                          and fixed pedestals (it is always recorded)
+/// baseline_median_window   recent pulse-free waveforms in the running median
+/// baseline_alpha           weight of each new median in the moving average
+/// baseline_pulse_cut       waveforms with a sample this far below the baseline
+///                          in the pre-trigger window are skipped (V)
+///
+/// The pre-trigger window is the conditioner one, condition_baseline_samples.
+struct BaselineTrackerParams {
+  bool   use{false};
+  int    median_window{15};
+  double alpha{0.05};
+  double pulse_cut{0.002};
+
+  void Load( const Configuration& config, const std::string& prefix = "baseline_" );
+};
+
+/// Baseline of one channel, followed as the waveforms of a scan are read,
+/// so that drifts with temperature over a scan are followed.
+///
+/// Each waveform gives the mean of its pre-trigger samples.  Waveforms with
+/// a pulse in that window are skipped.  The median of the last
+/// median_window means removes the odd noisy waveform, and an exponentially
+/// weighted moving average of that median smooths it.
+class BaselineTracker {
+public:
+  BaselineTracker( const BaselineTrackerParams& par );
+
+  /// Add the pre-trigger baseline of wf.  Returns false if it was skipped.
+  bool Update( const ConditionedWaveform& wf );
+
+  bool   Ready()  const { return fAccepted > 0; }
+  double Get()    const { return fBaseline; }  //< tracked baseline (V)
+  double Spread() const;                       //< robust rms of the recent means (V)
+
+  unsigned long long accepted() const { return fAccepted; }
+  unsigned long long rejected() const { return fRejected; }
+  const BaselineTrackerParams& params() const { return fPar; }
+
+private:
+  BaselineTrackerParams fPar;
+  std::vector< double > fRecent;  // ring buffer of pre-trigger means
+  mutable std::vector< double > fSorted;
+  int    fNext{0};
+  double fBaseline{0.};
+  unsigned long long fAccepted{0};
+  unsigned long long fRejected{0};
+
+  double Median( double shift = 0., bool absolute = false ) const;
+};
+
+#endif // __BASELINETRACKER__
@@ -0,0 +1,46 @@
+#ifndef __BUFFERPOOL__
+#define __BUFFERPOOL__
+
+#include <vector>
+#include <cstddef>
+
+/// Equal sized buffers of doubles carved out of one block of memory.
+///
+/// The block is only reallocated when a bigger size is asked for, so a
+/// process that opens many files of the same layout allocates it once.
+/// The memory is released when the pool is destroyed, or by release().
+/// Pointers from buffer() are invalidated by reserve() when it reallocates
+/// (it returns true then), and by release().
+class BufferPool {
+public:
+  BufferPool() { }
+  BufferPool( const BufferPool& ) = delete;
+  BufferPool& operator=( const BufferPool& ) = delete;
+
+  // Make room for nbuffers buffers of size doubles each
+  // Returns true if the memory moved
+  bool reserve( unsigned nbuffers, std::size_t size ){
+    if ( nbuffers <= fNumBuffers && size <= fSize ) return false;
+    if ( nbuffers > fNumBuffers ) fNumBuffers = nbuffers;
+    if ( size > fSize ) fSize = size;
+    std::vector< double >( std::size_t( fNumBuffers ) * fSize ).swap( fArena );
+    return true;
+  }
+
+  double* buffer( unsigned i ){ return fNumBuffers > 0 ? &fArena[ std::size_t( i ) * fSize ] : nullptr; }
+  std::size_t size() const { return fSize; }          //< doubles per buffer
+  std::size_t bytes() const { return fArena.size() * sizeof( double ); }
+
+  void release(){
+    std::vector< double >().swap( fArena );
+    fNumBuffers = 0;
+    fSize = 0;
+  }
+
+private:
+  std::vector< double > fArena;
+  unsigned fNumBuffers{0};
+  std::size_t fSize{0};
+};
+
+#endif // __BUFFERPOOL__
@@ -0,0 +1,57 @@
+#ifndef __EARLYSTOP__
+#define __EARLYSTOP__
+
+#include <string>
+
+class Configuration;
+
+/// Settings of the sequential early stop, from the config file
+///
+/// early_stop                     stop analysing a scan point once its estimates converged
+/// early_stop_min_waveforms       analyse at least this many waveforms of each scan point
+/// early_stop_z                   confidence of the intervals, in gaussian sigma
+/// early_stop_efficiency_width    full width of the detection efficiency (haswf
+///                                fraction) interval to stop at
+/// early_stop_charge_width        full width of the mean charge sum interval to stop
+///                                at (units of qsum), 0 to only use the efficiency
+struct EarlyStopParams {
+  bool   use{false};
+  int    min_waveforms{100};
+  double z{1.96};
+  double efficiency_width{0.02};
+  double charge_width{0.};
+
+  void Load( const Configuration& config, const std::string& prefix = "early_stop_" );
+};
+
+/// Running estimates of one scan point, to stop once they are known well enough.
+///
+/// The detection efficiency uses the Wilson score interval, which stays
+/// sensible at fractions near 0 and 1, such as off the PMT face.  The mean
+/// charge uses the normal interval of the running (Welford) mean, from the
+/// waveforms that have a charge sum.
+class EarlyStop {
+public:
+  EarlyStop( const EarlyStopParams& par ) : fPar( par ) { }
+
+  void BeginScanPoint();
+  /// Add one analysed waveform; charge is NaN if it has no charge sum
+  void Update( bool haswf, double charge );
+  /// True once the intervals are narrower than asked for
+  bool Converged() const;
+
+  double EfficiencyWidth() const;
+  double ChargeWidth() const;
+  unsigned long long analysed() const { return fN; }
+  const EarlyStopParams& params() const { return fPar; }
+
+private:
+  EarlyStopParams fPar;
+  unsigned long long fN{0};       // waveforms analysed
+  unsigned long long fHasWf{0};   // with a pulse
+  unsigned long long fNCharge{0}; // with a charge sum
+  double fMean{0.};
+  double fM2{0.};
+};
+
+#endif // __EARLYSTOP__
@@ -0,0 +1,122 @@
+#ifndef __FASTMATH__
+#define __FASTMATH__
+
+#include <cmath>
+
+/// Approximations of the special functions in the pulse models, which
+/// Minuit evaluates thousands of times per waveform fit.
+///
+/// Tolerances against the libm versions:
+///   ExpErfc, EMG   relative error below 5e-9
+///   SinCos         absolute error below 1e-15 for |x| < 1e6, libm beyond
+///   IPow           exact up to rounding of the repeated products
+///   Pow            relative error below 1e-14 for |y log x| < 50
+namespace FastMath {
+
+  namespace detail {
+    // erfcx( z ) = exp( z^2 ) erfc( z ) and its derivative at z = i / kErfcxScale,
+    // filled in FastMath.cpp
+    const int kErfcxScale = 64;
+    const int kErfcxSize = 16 * kErfcxScale + 2;
+    extern double erfcx_value[ kErfcxSize ];
+    extern double erfcx_deriv[ kErfcxSize ];
+  }
+
+  /// Scaled complementary error function exp( z^2 ) erfc( z ) for z >= 0,
+  /// cubic Hermite interpolation of a table below z = 16 and the
+  /// asymptotic series above
+  inline double Erfcx( double z ){
+    if ( z < 16. ){
+      double u = z * detail::kErfcxScale;
+      int i = int( u );
+      double s = u - i, s2 = s*s, s3 = s2*s;
+      const double h = 1. / detail::kErfcxScale;
+      return detail::erfcx_value[i]   * ( 2*s3 - 3*s2 + 1 ) + detail::erfcx_deriv[i]   * h * ( s3 - 2*s2 + s ) +
+             detail::erfcx_value[i+1] * ( 3*s2 - 2*s3 )     + detail::erfcx_deriv[i+1] * h * ( s3 - s2 );
+    }
+    double r = 1. / ( z*z );
+    return 0.56418958354775628695 / z * ( 1. + r*( -0.5 + r*( 0.75 + r*( -1.875 + r*6.5625 ) ) ) );
+  }
+
+  /// exp( a ) * erfc( b ) with one exponential for b >= 0.  Does not
+  /// overflow for large a when erfc( b ) is small, as the product of the
+  /// two libm functions can.
+  inline double ExpErfc( double a, double b ){
+    double z = std::fabs( b );
+    double r = std::exp( a - z*z ) * Erfcx( z );
+    return b >= 0. ? r : 2. * std::exp( a ) - r;
+  }
+
+  /// Exponentially modified gaussian of unit area times tau/2, as in the
+  /// mPMT pulse fits:
+  ///   (tau/2) exp( (mu + sigma^2/2/tau - x)/tau ) erfc( (mu + sigma^2/tau - x)/sqrt(2)/sigma )
+  /// Minuit evaluates every bin with the same parameters, so the terms that
+  /// only depend on them are kept from the previous call.
+  class EMG {
+  public:
+    double operator()( double x, double mu, double sigma, double tau ){
+      if ( mu != fMu || sigma != fSigma || tau != fTau ){
+        fMu = mu; fSigma = sigma; fTau = tau;
+        fInvTau = 1. / tau;
+        fInvSig = 1. / ( std::sqrt( 2. ) * sigma );
+        fA = mu + 0.5 * sigma * sigma * fInvTau;
+        fB = mu + sigma * sigma * fInvTau;
+      }
+      return 0.5 * tau * ExpErfc( ( fA - x ) * fInvTau, ( fB - x ) * fInvSig );
+    }
+  private:
+    double fMu{NAN}, fSigma{NAN}, fTau{NAN};
+    double fInvTau{0.}, fInvSig{0.}, fA{0.}, fB{0.};
+  };
+
+  /// sin( x ) and cos( x ) from one reduction to |r| <= pi/4 and Taylor
+  /// series in r, to the order where the next term is below 1e-16
+  inline void SinCos( double x, double& s, double& c ){
+    if ( !( std::fabs( x ) < 1e6 ) ){
+      s = std::sin( x );
+      c = std::cos( x );
+      return;
+    }
+    // pi/2 in three parts, the first with few enough bits that n * part is exact
+    const double pio2_1 = 1.57079632673412561417e+00;
+    const double pio2_2 = 6.07710050630396597660e-11;
+    const double pio2_3 = 2.02226624871116645580e-21;
+    double n = std::nearbyint( x * 0.63661977236758134308 );
+    double r = ( ( x - n * pio2_1 ) - n * pio2_2 ) - n * pio2_3;
+    double r2 = r * r;
+    double sr = r * ( 1. + r2*( -1./6 + r2*( 1./120 + r2*( -1./5040 + r2*( 1./362880 +
+                r2*( -1./39916800 + r2*( 1./6227020800. + r2*( -1./1307674368000. ) ) ) ) ) ) ) );
+    double cr = 1. + r2*( -1./2 + r2*( 1./24 + r2*( -1./720 + r2*( 1./40320 +
+                r2*( -1./3628800 + r2*( 1./479001600. + r2*( -1./87178291200. +
+                r2*( 1./20922789888000. ) ) ) ) ) ) ) );
+    switch ( long( n ) & 3 ){
+    case 0:  s =  sr; c =  cr; break;
+    case 1:  s =  cr; c = -sr; break;
+    case 2:  s = -sr; c = -cr; break;
+    default: s = -cr; c =  sr; break;
+    }
+  }
+
+  /// x to an integer power by repeated squaring
+  inline double IPow( double x, int n ){
+    unsigned m = n < 0 ? -n : n;
+    double r = 1.;
+    while ( m ){
+      if ( m & 1 ) r *= x;
+      x *= x;
+      m >>= 1;
+    }
+    return n < 0 ? 1. / r : r;
+  }
+
+  /// x to the power y: repeated squaring when y is a small integer,
+  /// exp( y log x ) otherwise, which is cheaper than libm pow
+  inline double Pow( double x, double y ){
+    if ( std::fabs( y ) <= 64. && y == std::floor( y ) ) return IPow( x, int( y ) );
+    if ( x > 0. ) return std::exp( y * std::log( x ) );
+    return std::pow( x, y );
+  }
+
+}
+
+#endif // __FASTMATH__
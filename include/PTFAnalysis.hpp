@@ -9,23 +9,50 @@
 #include "TMath.h"
 #include <vector>
 #include <string>
+#include <map>
 
 
 #include "wrapper.hpp"
 #include "ScanPoint.hpp"
 #include "WaveformFitResult.hpp"
+#include "WaveformSnapshot.hpp"
+#include "PulseTemplate.hpp"
+#include "PulseFinding.hpp"
+#include "RingingFilter.hpp"
+#include "WaveformConditioner.hpp"
+#include "BaselineTracker.hpp"
+#include "PreviewSampler.hpp"
+#include "EarlyStop.hpp"
+#include "ScanPointSummary.hpp"
 
 using namespace std;
 
+class TreeOutputPolicy;
+
 /// This class takes a PTFWrapper reference, charge errorbar, and PMT as input
 /// It then does main analysis to fill a TTree of WaveformFitResults
 /// Has methods to later read back entries of the TTree
 /// Keeps track of number of Scan Points, and locations used find entries in TTree
 class PTFAnalysis {
 public:
-  PTFAnalysis( TFile * outfile,Wrapper & ptf, double errorbar, PTF::PMT & pmt, string config_file, bool savewf=false );
+  /// With early_stop, leader (the analysis of the main PMT of the same run)
+  /// decides when each scan point stops: this one analyses as many waveforms
+  /// of it as leader did, so that the ptfanalysis trees of all of the PMTs
+  /// line up with the scanpoints tree written from leader
+  PTFAnalysis( TFile * outfile,Wrapper & ptf, double errorbar, PTF::PMT & pmt, string config_file, bool savewf=false,
+               const PTFAnalysis * leader=nullptr );
   ~PTFAnalysis(){
     if ( fitresult ) delete fitresult;
+    if ( snapshot ) delete snapshot;
+    if ( snapshot_select ) delete snapshot_select;
+    if ( pulse_template ) delete pulse_template;
+    if ( pulse_finder ) delete pulse_finder;
+    if ( ringing_filter ) delete ringing_filter;
+    if ( conditioner ) delete conditioner;
+    if ( baseline_tracker ) delete baseline_tracker;
+    if ( preview ) delete preview;
+    if ( early_stop ) delete early_stop;
+    if ( summary ) delete summary;
   }
 
   // Access fit results
@@ -43,35 +70,81 @@ public:
   const std::vector< double >      get_bins( char dim );
   
 private:
-  void ChargeSum( float ped, int bin_low=1, int bin_high=0 ); // Charge sum relative to ped
+  friend class PTFAnalysisBench; // ptf_bench.cpp times the individual stages
+
+  void FillWaveform( const double* sample, double errorbar ); // Condition digitizer counts into hwaveform
+  void ChargeSum( int bin_low=1, int bin_high=0 ); // Charge sum relative to the pedestal of the waveform
   bool MonitorCut( float cut ); // Cut if no monitor PMT pulse
   bool FFTCut(); // Do FFT and check if waveform present
   bool PulseLocationCut( int cut ); // Cut on pulse in first or last bins
   void InitializeFitResult( int wavenum, int nwaves, double evt_timestamp);
 
-  void FitWaveform( int wavenum, int nwaves, PTF::PMT pmt );
+  // Per PMT type processing of the waveforms, see the policies in PTFAnalysis.cpp
+  struct ScanSettings {
+    bool   terminal_output;
+    bool   do_pulse_finding;
+    bool   dofit;
+    double errorbar;   // error of one digitizer count
+  };
+  struct PolicyBase;
+  struct R3600Policy;
+  struct MonitorPolicy;
+  struct ReferencePolicy;
+  template< bool EMG > struct mPMTPolicy;
+  template< class Policy >
+  void AnalyzeScanPoints( Wrapper & wrapper, const PTF::PMT & pmt, const Policy & policy,
+                          const ScanSettings & settings, TreeOutputPolicy & output_policy );
+
+  void FitWaveform( int wavenum, int nwaves, PTF::PMT pmt ); // Fit with the model for the type of pmt
+  void FitR3600();
+  void FitR3600Filtered(); // R3600 with the ringing removed before the fit
+  void FitMonitor();
+  void FitReference();
+  template< bool EMG > void FitMPMT( int channel, double cfd_baseline );
+  double CFDTime( int min_bini, double baseline, double min_value ); // mPMT CFD time
+  double TrackedBaseline( double fallback ) const; // tracked baseline if used, else fallback
+  int TimeBin( double t ) const; // bin of hwaveform at time t (ns)
+  // Fit functions are built once per process and shared by all instances,
+  // so that processing several runs does not rebuild them
+  static TF1* get_fit_function( const std::string& model, double (*func)(double*, double*),
+                                double xmin, double xmax, int npar );
   static double pmt0_gaussian(double *x, double *par);
   static double pmt1_gaussian(double *x, double *par);
   static double funcEMG(double* x, double* p);
   static double pmt2_piecewise(double *x, double *par);
   static double bessel(double *x, double *p);
-  static bool comparison(double i, double j){ return (fabs( i-j ) < 1e-5); }
 
   std::vector< ScanPoint > scanpoints;
+  static std::map< std::string, TF1* > fitfunctions;
 
   //std::vector< ScanPoint > Temperature;
   //TF1* fmygauss{nullptr};  // gaussian function used to fit waveform
   TF1* ffitfunc{nullptr};  // function used to fit waveform
 
-  TH1D* hwaveform{nullptr}; // current waveform
+  WaveformConditioner* conditioner{nullptr}; // raw samples to volts, per channel
+  ConditionedWaveform conditioned; // current waveform, used by the pulse finders and simple fits
+  BaselineTracker* baseline_tracker{nullptr}; // baseline of the channel over the scan
+  bool track_baselines{false}; // use the tracked baseline (baseline_tracking)
+  PreviewSampler* preview{nullptr}; // waveforms of each scan point that are analysed
+  EarlyStop* early_stop{nullptr};   // stops a scan point once its estimates converged
+  const PTFAnalysis* early_stop_leader{nullptr}; // stops each scan point where it did instead, if set
+  unsigned long long early_stopped{0}; // scan points stopped early
+  unsigned long long early_skipped{0}; // waveforms not analysed because of it
+  ScanPointSummary* summary{nullptr}; // of the current scan point, if summary_tree
+  TTree* summary_tree{nullptr};       // one summary per scan point
+  TH1D* hwaveform{nullptr}; // current waveform, as a histogram for the TF1 fits
   TH1* hfftm{nullptr}; // fast fourier transform magnitude
   WaveformFitResult * fitresult{nullptr};
   TTree* ptf_tree{nullptr};
   bool  save_waveforms{false};
-  TDirectory* wfdir{nullptr};
-  TDirectory* nowfdir{nullptr};
-  TDirectory* wfdir_fft{nullptr};
-  TDirectory* nowfdir_fft{nullptr};
+  SnapshotSelector* snapshot_select{nullptr}; // which waveforms to save
+  WaveformSnapshot* snapshot{nullptr};
+  TTree* snapshot_tree{nullptr};
+  PulseTemplate* pulse_template{nullptr}; // mPMT template matching, if used
+  PulseFinder* pulse_finder{nullptr};     // if do_pulse_finding
+  RingingFilter* ringing_filter{nullptr}; // R3600 ringing suppression, if used
+  unsigned long long template_matched{0};  // waveforms done by the template
+  unsigned long long template_fallback{0}; // waveforms the template sent to the fit
 
 };
 
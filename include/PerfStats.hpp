@@ -0,0 +1,132 @@
+#ifndef __PERFSTATS__
+#define __PERFSTATS__
+
+/// Per-stage timers and counters for the waveform analysis.
+///
+/// Only compiled in when PTF_PERF is defined (make PERF=1).  Otherwise
+/// the PERF_* macros expand to nothing and none of this code is built.
+///
+/// Timings and counts are accumulated per PMT and per scan point:
+///
+/// PERF_BEGIN_SCANPOINT( pmt, scanpt );  // start accumulating a new record
+/// { PERF_SCOPE( PerfFit ); ... }        // time a block as one stage call
+/// PERF_COUNT( PerfBytesRead, nbytes );  // add to a counter
+/// PERF_FIT_STATUS( fitstat );           // count a fit call and its status
+/// PERF_REPORT();                        // print summary, write perf TTrees
+///                                       // into the current directory, and
+///                                       // start over (for the next run)
+
+#ifdef PTF_PERF
+
+#include <chrono>
+#include <map>
+#include <vector>
+#include <string>
+#include <utility>
+#include <ostream>
+
+/// Stages of the analysis that are timed
+enum PerfStage {
+  PerfRead = 0,      // Wrapper::setCurrentEntry
+  PerfFill,          // filling hwaveform
+  PerfPulseFinding,  // find_pulses
+  PerfChargeSum,     // PTFAnalysis::ChargeSum
+  PerfLocationCut,   // PTFAnalysis::PulseLocationCut
+  PerfFFTCut,        // PTFAnalysis::FFTCut
+  PerfFit,           // PTFAnalysis::FitWaveform
+  PerfTreeFill,      // ptf_tree->Fill
+  PerfSaveWaveform,  // clones of waveform and FFT histograms
+  NPerfStages
+};
+
+/// Quantities that are counted
+enum PerfCounter {
+  PerfWaveforms = 0,
+  PerfFitCalls,
+  PerfFitFailures,        // fit calls with non-zero fitstat
+  PerfLocationCutRejects,
+  PerfFFTCutRejects,
+  PerfBytesRead,
+  NPerfCounters
+};
+
+/// Accumulated timings and counts for one PMT at one scan point
+struct PerfRecord {
+  int pmt{-1};
+  int scanpt{-1};
+  double seconds[ NPerfStages ] = {};
+  unsigned long long calls[ NPerfStages ] = {};
+  unsigned long long counts[ NPerfCounters ] = {};
+};
+
+/// Singleton holding all of the PerfRecords of the program
+class PerfStats {
+public:
+  static PerfStats* Get();
+
+  static const char* stage_name( PerfStage s );
+  static const char* counter_name( PerfCounter c );
+
+  // Start a new record; following timings and counts go into it
+  void begin_scanpoint( int pmt, int scanpt );
+  void add_time( PerfStage s, double sec ){
+    PerfRecord& r = current();
+    r.seconds[ s ] += sec;
+    ++r.calls[ s ];
+  }
+  void count( PerfCounter c, unsigned long long n = 1 ){ current().counts[ c ] += n; }
+  void fit_status( int fitstat );
+
+  const std::vector< PerfRecord >& records() const { return fRecords; }
+
+  // Terminal summary, totals per PMT
+  void print( std::ostream& os ) const;
+  // Write tree of records (one entry per PMT and scan point), and tree of
+  // fit status counts (one entry per PMT and fitstat value)
+  void write( const std::string& treename = "perf" ) const;
+  void clear();
+
+private:
+  PerfStats() { }
+  PerfRecord& current(){
+    if ( fRecords.empty() ) fRecords.push_back( PerfRecord() );
+    return fRecords.back();
+  }
+
+  static PerfStats* fInstance;
+  std::vector< PerfRecord > fRecords;
+  std::map< std::pair< int, int >, unsigned long long > fFitStat; // ( pmt, fitstat ) -> count
+};
+
+/// Times its own lifetime as one call of a stage
+class PerfScopedTimer {
+public:
+  PerfScopedTimer( PerfStage s ) : fStage( s ), fStart( std::chrono::steady_clock::now() ) { }
+  ~PerfScopedTimer(){
+    std::chrono::duration< double > dt = std::chrono::steady_clock::now() - fStart;
+    PerfStats::Get()->add_time( fStage, dt.count() );
+  }
+private:
+  PerfStage fStage;
+  std::chrono::steady_clock::time_point fStart;
+};
+
+#define PERF_CONCAT_( a, b ) a##b
+#define PERF_CONCAT( a, b ) PERF_CONCAT_( a, b )
+#define PERF_SCOPE( stage ) PerfScopedTimer PERF_CONCAT( perf_timer_, __LINE__ )( stage )
+#define PERF_COUNT( counter, n ) PerfStats::Get()->count( counter, n )
+#define PERF_BEGIN_SCANPOINT( pmt, scanpt ) PerfStats::Get()->begin_scanpoint( pmt, scanpt )
+#define PERF_FIT_STATUS( fitstat ) PerfStats::Get()->fit_status( fitstat )
+#define PERF_REPORT() do { PerfStats::Get()->print( std::cout ); PerfStats::Get()->write(); PerfStats::Get()->clear(); } while ( 0 )
+
+#else
+
+#define PERF_SCOPE( stage )
+#define PERF_COUNT( counter, n ) do { (void)sizeof( n ); } while ( 0 )
+#define PERF_BEGIN_SCANPOINT( pmt, scanpt ) do { } while ( 0 )
+#define PERF_FIT_STATUS( fitstat ) do { (void)sizeof( fitstat ); } while ( 0 )
+#define PERF_REPORT() do { } while ( 0 )
+
+#endif // PTF_PERF
+
+#endif // __PERFSTATS__
@@ -0,0 +1,60 @@
+#ifndef __PREVIEWSAMPLER__
+#define __PREVIEWSAMPLER__
+
+#include "TRandom3.h"
+
+#include <string>
+#include <vector>
+
+class Configuration;
+
+/// Settings of the preview mode, from the config file
+///
+/// preview_fraction        fraction of the waveforms of each scan point that
+///                         are analysed, 1 (the default) for all of them
+/// preview_mode            stride (evenly spaced waveforms) or random
+/// preview_seed            seed of the random subsets
+/// preview_min_waveforms   analyse at least this many waveforms per scan point
+struct PreviewParams {
+  double      fraction{1.};
+  std::string mode{"stride"};
+  int         seed{4357};
+  int         min_waveforms{20};
+
+  bool enabled() const { return fraction < 1.; }
+  void Load( const Configuration& config, const std::string& prefix = "preview_" );
+};
+
+/// Picks the waveforms of each scan point that are analysed in preview mode.
+///
+/// Exactly k = max( min_waveforms, ceil( fraction * n ) ) of the n waveforms
+/// of a scan point are taken: every n/k-th one, or a random subset with every
+/// subset of k equally likely.  Each stands for weight() = n/k waveforms, so
+/// means over the scan point are unbiased, and sums weighted by it estimate
+/// those of the whole scan point.  A stride subset only depends on n.  A
+/// random one also depends on where the scan point is in the run: the
+/// generator is seeded once and runs on from one scan point to the next, so
+/// the subset depends on the seed and on the n of this and all of the
+/// earlier scan points.  The PMTs of one scan go through the same scan
+/// points in the same order, so they still get the same waveforms.
+class PreviewSampler {
+public:
+  PreviewSampler( const PreviewParams& par );
+
+  /// Pick the waveforms of a scan point of nwaveforms
+  void BeginScanPoint( int nwaveforms );
+  bool   Take( int j ) const { return fTake[ j ] != 0; }  //< analyse waveform j
+  int    selected() const { return fK; }
+  double weight()   const { return fK > 0 ? double( fN ) / fK : 1.; }
+  const PreviewParams& params() const { return fPar; }
+
+private:
+  PreviewParams fPar;
+  bool fRandom{false};
+  TRandom3 fRand;
+  std::vector< char > fTake;
+  int fN{0};
+  int fK{0};
+};
+
+#endif // __PREVIEWSAMPLER__
@@ -4,19 +4,129 @@
 #include "TH1D.h"
 #include "WaveformFitResult.hpp"
 #include "wrapper.hpp"
+#include "WaveformConditioner.hpp"
+
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+class Configuration;
+
+/// Settings of the pulse finders, from the config file.  Voltages are
+/// below the baseline, all keys optional:
+///
+/// pulse_finder_algorithm          threshold, slope, cfd or matched
+/// pulse_finder_threshold          pulse height to start a pulse (V)
+/// pulse_finder_slope              slope: drop over one sample on the leading edge (V)
+/// pulse_finder_cfd_fraction       cfd: fraction of the pulse height
+/// pulse_finder_cfd_delay          cfd: delay of the inverted signal (samples)
+/// pulse_finder_filter_sigma       matched: width of the gaussian filter (ns)
+/// pulse_finder_filter_threshold   matched: filtered amplitude to start a pulse (V)
+struct PulseFinderParams {
+  std::string algorithm{"threshold"};
+  double threshold{0.004};
+  double slope{0.002};
+  double cfd_fraction{0.5};
+  int    cfd_delay{2};
+  double filter_sigma{8.0};
+  double filter_threshold{0.003};
+
+  void Load( const Configuration& config, const std::string& prefix = "pulse_finder_" );
+};
+
+/// Waveforms handed to a pulse finder together: nwaves waveforms of
+/// nsamples voltages each, one after the other, with a common baseline
+/// and binning
+struct WaveformBatch {
+  const double* volts{nullptr};
+  int    nwaves{0};
+  int    nsamples{0};
+  double sample_ns{8.0};
+  double t0{0.};          //< start of the first sample (ns)
+  double baseline{1.0};
+  const double* wave( int i ) const { return volts + std::size_t( i ) * nsamples; }
+};
+
+typedef std::vector< PulseInfo > PulseList;
+
+/// Base of the pulse finding algorithms.
+///
+/// Pulses are negative going.  Pulse times are t0 plus the sample number
+/// (from 1) times the sample width, the charge is the pulse height.
+class PulseFinder {
+public:
+  PulseFinder( const PulseFinderParams& par ) : fPar( par ) { }
+  virtual ~PulseFinder() { }
+
+  // Find the pulses of every waveform in the batch, pulses[i] are the
+  // pulses of waveform i
+  virtual void Find( const WaveformBatch& batch, std::vector< PulseList >& pulses ) const;
+
+  // Find the pulses of a batch of one waveform, into fitresult
+  void Find( const WaveformBatch& batch, WaveformFitResult* fitresult );
+
+  // Find the pulses of one waveform histogram, into fitresult
+  void Find( const TH1D* h, double baseline, WaveformFitResult* fitresult );
+
+  virtual std::string name() const = 0;
+  const PulseFinderParams& params() const { return fPar; }
+
+protected:
+  // Find the pulses of waveform v of the batch
+  virtual void FindOne( const double* v, const WaveformBatch& batch, PulseList& pulses ) const = 0;
+
+  // Add the pulse with its minimum at sample imin, whose leading edge is
+  // after sample istart.  timeCFD is where the leading edge crosses the
+  // fraction of the height, charge is the height unless given.
+  void AddPulse( const double* v, const WaveformBatch& batch, int istart, int imin,
+                 PulseList& pulses, double fraction = 0.5, double charge = -1. ) const;
+
+  PulseFinderParams fPar;
+
+private:
+  std::vector< double > fSamples;    // for Find of a histogram
+  std::vector< PulseList > fPulses;
+};
+
+/// Pulse finders by name, so that they can be picked in the config file.
+///
+/// PulseFinder* finder = PulseFinderRegistry::Get()->Create( params );
+///
+/// Built in: threshold, slope, cfd and matched.  Other algorithms are added
+/// with Register( name, factory ) before the analysis is made.
+class PulseFinderRegistry {
+public:
+  typedef PulseFinder* (*Factory)( const PulseFinderParams& par );
+
+  static PulseFinderRegistry* Get();
+
+  void Register( const std::string& name, Factory factory );
+
+  // New finder for par.algorithm, owned by the caller.  Exits if the
+  // name is unknown.
+  PulseFinder* Create( const PulseFinderParams& par ) const;
+
+  std::vector< std::string > Names() const;
+
+private:
+  PulseFinderRegistry();
+  static PulseFinderRegistry* singleton_;
+  std::map< std::string, Factory > fFactories;
+};
 
 // Find pulses in a given waveform
 // arguments:
-// int algo_type : which pulse finding algorithm to use?
+// PulseFinder& finder : which pulse finding algorithm to use
 // TH1D *hwaveform : the input waveform
 // WaveformFitResult *fitresult : store the list of pulses in WaveformFitResult
-void find_pulses(int algo_type, TH1D *hwaveform, WaveformFitResult *fitresult, PTF::PMT pmt );
+// PTF::PMT pmt : baseline is 1 V, or from the BRB settings tree for mPMT channels
+void find_pulses( PulseFinder& finder, TH1D *hwaveform, WaveformFitResult *fitresult, PTF::PMT pmt );
 
-// Do simple comparison to fixed threshold to find pulses
-void simple_threshold_technique(TH1D *hwaveform, WaveformFitResult *fitresult, PTF::PMT pmt );
-
-// Another function to find peaks and compare the results to the first one
-void another_pulse_finding_function(TH1D *hwaveform, WaveformFitResult *fitresult, PTF::PMT pmt );
+// The same on a conditioned waveform, without going through a histogram.
+// The baseline is the conditioned one if it was subtracted, otherwise
+// baseline if it is not NaN (eg. from a BaselineTracker), otherwise as above.
+void find_pulses( PulseFinder& finder, const ConditionedWaveform& wf, WaveformFitResult *fitresult, PTF::PMT pmt,
+                  double baseline = NAN );
 
 #endif // __PULSEFINDING__
-
@@ -0,0 +1,97 @@
+#ifndef __PULSETEMPLATE__
+#define __PULSETEMPLATE__
+
+#include "TH1D.h"
+
+#include <string>
+#include <vector>
+
+class Configuration;
+
+/// Settings of the mPMT pulse template matching, from the config file
+///
+/// use_pulse_template         turn on template matching for mPMT channels
+/// template_training_pulses   good fits averaged into the template
+/// template_oversample        template points per digitizer sample
+/// template_tmin, _tmax       template range around the fitted time (ns)
+/// template_search            search range around the expected time (ns)
+/// template_train_chi2ndf     largest fit chi2/ndf of a training pulse
+/// template_min_height        smallest pulse height of a training pulse (V)
+/// template_max_chi2ndf       larger template chi2/ndf falls back to the fit
+struct PulseTemplateParams {
+  bool   use{false};
+  int    training_pulses{500};
+  int    oversample{8};
+  double tmin{-64.};
+  double tmax{96.};
+  double search{24.};
+  double train_chi2ndf{3.0};
+  double min_height{0.002};
+  double max_chi2ndf{3.0};
+
+  void Load( const Configuration& config, const std::string& prefix = "template_" );
+};
+
+/// Average pulse shape of one channel, and matched filter with it.
+///
+/// The template is built from waveforms with good full fits: each is
+/// baseline subtracted, divided by its height and added to a grid finer
+/// than the digitizer sampling, aligned at the fitted time.  Once enough
+/// pulses are added the template is normalised to unit height and used to
+/// find the amplitude and time of a pulse by direct cross-correlation,
+/// over a search window of lags on the fine grid, with parabolic
+/// interpolation between lags.  The window is a few tens of samples, so the
+/// direct sum is cheaper than going through an FFT.
+///
+/// The fitted parameters of the training pulses are also fit with straight
+/// lines against the template amplitude, so that template results can be
+/// reported in the same units as the full fit (Calibrated).
+class PulseTemplate {
+public:
+  PulseTemplate( const PulseTemplateParams& par, double sample_ns );
+
+  /// Result of matching the template to a waveform
+  struct Match {
+    double time{0.};  //< time of the template reference (ns)
+    double amp{0.};   //< amplitude in units of the template (V)
+    double chi2{0.};
+    int    ndf{0};
+  };
+
+  // Add a pulse with a good fit, fitted at time t0, with the fit parameters
+  // pars[0..npars-1] for calibration.  Builds the template after the last
+  // training pulse.
+  void Add( const TH1D* h, double baseline, double height, double t0, double tpeak,
+            const double* pars, int npars );
+  bool Ready() const { return fReady; }
+
+  // Match near the peak time tpeak of the waveform
+  Match Find( const TH1D* h, double baseline, double tpeak ) const;
+
+  // Fit parameter ipar of the full fit for a pulse of template amplitude amp
+  double Calibrated( int ipar, double amp ) const;
+
+  // Template value at time t relative to the reference
+  double Eval( double t ) const;
+
+  const PulseTemplateParams& params() const { return fPar; }
+
+private:
+  void Build();
+
+  PulseTemplateParams fPar;
+  double fStep;                  // ns between template points
+  std::vector< double > fSum;    // sums and counts of training samples
+  std::vector< int > fCount;
+  std::vector< double > fShape;  // normalised template
+  int fNum{0};                   // training pulses added
+  double fPeakOffset{0.};        // mean of t0 - tpeak of the training pulses
+  bool fReady{false};
+
+  // sums for the straight line fits of the fit parameters against amplitude
+  std::vector< double > fSy, fSxy;
+  std::vector< double > fIntercept, fSlope;
+  double fSx{0.}, fSxx{0.};
+};
+
+#endif // __PULSETEMPLATE__
@@ -0,0 +1,81 @@
+#ifndef __RINGINGFILTER__
+#define __RINGINGFILTER__
+
+#include "TH1D.h"
+
+#include <string>
+
+class Configuration;
+
+/// Settings of the ringing suppression of the R3600 waveforms, from the
+/// config file
+///
+/// ringing_filter            turn on the filter, the gaussian fit then has 4 parameters
+/// ringing_tmin, _tmax       pre-pulse window the ringing is estimated in (ns)
+/// ringing_wmin, _wmax       range of ringing frequencies searched (rad/ns)
+/// ringing_nfreq             frequencies tried in the range before refining
+struct RingingFilterParams {
+  bool   use{false};
+  double tmin{0.};
+  double tmax{40.};
+  double wmin{0.2};
+  double wmax{0.35};
+  int    nfreq{16};
+
+  void Load( const Configuration& config, const std::string& prefix = "ringing_" );
+};
+
+/// Removes the ringing on the PTF main PMT waveforms before the fit.
+///
+/// The ringing is a sine wave of about 0.25 rad/ns that is there before the
+/// pulse.  In the pre-pulse window the waveform is an offset plus
+/// a sin( w t ) + b cos( w t ), which is linear in the offset, a and b for
+/// a given w.  That least squares fit is made for a grid of w, the smallest
+/// chi2 is refined with a parabola, and the sine is subtracted from the
+/// whole waveform.  This is a projection of the window onto the ringing,
+/// which unlike a notch filter leaves the shape of the pulse alone.
+class RingingFilter {
+public:
+  RingingFilter( const RingingFilterParams& par ) : fPar( par ) { }
+
+  /// Ringing found by the last Estimate, in the sinamp, sinw, sinphi
+  /// convention of PTFAnalysis::pmt0_gaussian
+  struct Ringing {
+    double amp{0.};       //< amplitude (V), >= 0
+    double w{0.};         //< frequency (rad/ns)
+    double phi{0.};       //< phase (rad), in [-pi, pi]
+    double offset{0.};    //< baseline in the window (V)
+    double amp_err{0.};
+    double w_err{0.};
+    double phi_err{0.};
+    double offset_err{0.};
+  };
+
+  /// Estimate the ringing of h in the pre-pulse window.  Returns false if
+  /// the window has fewer than 4 bins.
+  bool Estimate( const TH1D* h );
+
+  /// Subtract the estimated ringing from every bin of h
+  void Subtract( TH1D* h ) const;
+
+  /// Estimate and Subtract
+  bool Apply( TH1D* h ){
+    if ( !Estimate( h ) ) return false;
+    Subtract( h );
+    return true;
+  }
+
+  const Ringing& ringing() const { return fRing; }
+  const RingingFilterParams& params() const { return fPar; }
+
+private:
+  // Least squares of offset + a sin( w t ) + b cos( w t ) over bins
+  // bmin..bmax at frequency w.  Returns the chi2, and fills coef[3] with
+  // offset, a, b and inv[9] with the inverse of the normal matrix if asked
+  double Project( const TH1D* h, int bmin, int bmax, double w, double* coef = nullptr, double* inv = nullptr ) const;
+
+  RingingFilterParams fPar;
+  Ringing fRing;
+};
+
+#endif // __RINGINGFILTER__
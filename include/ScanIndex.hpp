@@ -0,0 +1,122 @@
+#ifndef __SCANINDEX__
+#define __SCANINDEX__
+
+#include "wrapper.hpp"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+/// Metadata of one entry (scan point) of a raw scan_tree.  Values whose
+/// branch is not in the run are NaN.
+struct ScanIndexEntry {
+  unsigned long long entry{0};
+  GantryData gantry0{NAN, NAN, NAN, NAN, NAN}; // x, y, z, theta (rot), phi (tilt)
+  GantryData gantry1{NAN, NAN, NAN, NAN, NAN};
+  double timestamp{NAN};
+  double ext2_temp{NAN};
+  unsigned long long num_points{0};
+
+  const GantryData& gantry( PTF::Gantry g ) const { return g == PTF::Gantry0 ? gantry0 : gantry1; }
+};
+
+/// Where the data of a branch for an entry is in the raw file
+struct BasketLocation {
+  std::string branch;
+  int basket;                     // basket number in the branch
+  unsigned long long first_entry; // first entry in the basket
+  long long seek;                 // byte offset of the basket in the file
+  int bytes;                      // compressed size of the basket
+};
+
+/// The raw run an index was built from, to tell when the index is out of
+/// date: the tree and its entries, and the size and modification time of
+/// the file
+struct ScanIndexSource {
+  std::string tree;
+  unsigned long long entries{0};
+  long long size{-1};  // bytes
+  long long mtime{-1}; // unix time (s)
+
+  bool operator==( const ScanIndexSource& o ) const {
+    return tree == o.tree && entries == o.entries && size == o.size && mtime == o.mtime;
+  }
+  bool operator!=( const ScanIndexSource& o ) const { return !( *this == o ); }
+};
+
+/// Sidecar index of the metadata of a raw run.
+///
+/// Built once per raw run by reading only the gantry, timestamp, temperature
+/// and num_points branches of the scan_tree (the waveforms are never
+/// decompressed), and saved next to it in a small ROOT file with the trees
+/// scan_index (one entry per scan_tree entry), scan_baskets (the baskets
+/// of every branch of the scan_tree) and scan_source (the ScanIndexSource
+/// of the run).  Open rebuilds an index that no longer matches its run, for
+/// example after the run was rewritten.  Reading the index back is enough to
+/// find the entries of a region or time window, and the bytes of the file
+/// that hold them:
+///
+///   ScanIndex index;
+///   if ( !index.Open( "out_run04554.root" ) ) exit( EXIT_FAILURE );
+///   for ( unsigned long long e : index.InCircle( PTF::Gantry1, 0.46, 0.38, 0.01 ) ) ...
+///
+/// The region queries go through all entries, the time window ones through
+/// the entries sorted by timestamp.
+class ScanIndex {
+public:
+  /// Index the scan_tree of raw run rawfile; false if it can not be read
+  bool Build( const std::string& rawfile, const std::string& treeName = "scan_tree" );
+  bool Write( const std::string& indexfile ) const;
+  bool Read( const std::string& indexfile );
+  /// Read the sidecar index of rawfile, building and writing it first if
+  /// there is none, or if it does not match the tree treeName of rawfile
+  bool Open( const std::string& rawfile, const std::string& treeName = "scan_tree" );
+  /// Source of the tree treeName of rawfile as it is now; false if it can
+  /// not be read
+  static bool CurrentSource( const std::string& rawfile, const std::string& treeName, ScanIndexSource& source );
+
+  /// Sidecar file of a raw run, out_run04554.root -> out_run04554.index.root
+  static std::string FileName( const std::string& rawfile );
+
+  const std::string& source() const { return fSource; }
+  /// What the index was built from, empty tree for indexes without it
+  const ScanIndexSource& source_info() const { return fSourceInfo; }
+  unsigned long long size() const { return fEntries.size(); }
+  const ScanIndexEntry& operator[]( unsigned long long entry ) const { return fEntries[ entry ]; }
+  const std::vector< ScanIndexEntry >& entries() const { return fEntries; }
+  unsigned long long total_points() const;
+
+  /// Entries with gantry g in the box, in entry order
+  std::vector< unsigned long long > InBox( PTF::Gantry g, double xmin, double xmax, double ymin, double ymax,
+                                           double zmin = -INFINITY, double zmax = INFINITY ) const;
+  /// Entries with gantry g within r of (x,y) in the xy plane, in entry order
+  std::vector< unsigned long long > InCircle( PTF::Gantry g, double x, double y, double r ) const;
+  /// Entries with t0 <= timestamp < t1, in entry order
+  std::vector< unsigned long long > InTimeWindow( double t0, double t1 ) const;
+  /// Entry with the timestamp nearest to t, or size() if there are none
+  unsigned long long NearestInTime( double t ) const;
+
+  /// Basket of each indexed branch that holds entry
+  std::vector< BasketLocation > Baskets( unsigned long long entry ) const;
+  /// Names of the indexed branches
+  std::vector< std::string > BasketBranches() const;
+
+private:
+  struct BranchBaskets {
+    std::string name;
+    std::vector< int > basket;
+    std::vector< unsigned long long > first_entry;
+    std::vector< long long > seek;
+    std::vector< int > bytes;
+  };
+
+  void SortByTime();
+
+  std::string fSource;
+  ScanIndexSource fSourceInfo;
+  std::vector< ScanIndexEntry > fEntries;
+  std::vector< unsigned long long > fByTime; // entries with a timestamp, sorted by it
+  std::vector< BranchBaskets > fBaskets;
+};
+
+#endif // __SCANINDEX__
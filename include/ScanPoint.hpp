@@ -19,6 +19,13 @@ public:
 	     unsigned long long entry, unsigned long long entries = 0 );
 
   ScanPoint & operator++(){ ++fEntries; return *this; }// prefix increment operator
+
+  // waveforms recorded at the scan point, when only some are analysed (preview
+  // mode or early stop)
+  void set_nwaveforms( unsigned long long n ){ fWaveforms = n; }
+
+  // tracked baseline at the end of the scan point, see BaselineTracker
+  void set_baseline( double baseline, double spread ){ fBaseline = baseline; fBaselineSpread = spread; }
   
   void get_xyz( double& xx, double &yy, double&zz, double&tti,double&tt_ext2 ) const { xx=fX; yy=fY; zz=fZ;tti=fTime_1;tt_ext2=fT_ext2; }
   double x() const { return fX; }
@@ -30,11 +37,20 @@ public:
   double t_ext2()	const	{return fT_ext2;}
   unsigned long long get_entry() const { return fEntry; }
   unsigned long long nentries() const { return fEntries; }
+  unsigned long long nwaveforms() const { return fWaveforms > fEntries ? fWaveforms : fEntries; }
+  double sampled_fraction() const { return nwaveforms() > 0 ? double( fEntries ) / nwaveforms() : 1.; }
+  // waveforms recorded that each entry stands for, to weight sums over entries
+  double weight() const { return fEntries > 0 ? double( nwaveforms() ) / fEntries : 1.; }
+  double baseline() const { return fBaseline; }
+  double baseline_spread() const { return fBaselineSpread; }
 
 private:
   double fX, fY, fZ,fTime_1,fT_ext2;            // x, y, z location of scan point
   unsigned long long fEntry;    // first entry in TTree of this scan pt
   unsigned long long fEntries;  // number of entries (waveforms) in TTree for this scan pt
+  unsigned long long fWaveforms{0}; // waveforms recorded at this scan pt, 0 if all are in the TTree
+  double fBaseline{0.};         // tracked baseline (V), 0 if not known
+  double fBaselineSpread{0.};   // rms of the recent pre-trigger baselines (V)
 };
 
 
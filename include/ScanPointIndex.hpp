@@ -0,0 +1,76 @@
+#ifndef __SCANPOINTINDEX__
+#define __SCANPOINTINDEX__
+
+#include "ScanPoint.hpp"
+
+#include <vector>
+
+/// Positions of a scan along one axis, inferred from the positions of its
+/// scan points.  Positions within the tolerance of the first of a group
+/// (in sorted order) are the same position, as in Utilities::get_bins.
+struct ScanAxis {
+  std::vector< double > positions; // distinct positions, sorted
+  std::vector< double > edges;     // positions.size()+1 edges, half way between positions and half a step past the ends
+  double origin{0.};               // first position
+  double step{0.};                 // median spacing of the positions, 0 if there is only one
+  bool   regular{false};           // every position is origin + i*step within the tolerance
+
+  /// Axis of the positions of the scan points, in any order and with repeats
+  static ScanAxis Infer( std::vector< double > values, double tolerance = 1e-5 );
+  /// Axis of n positions from origin in steps of step
+  static ScanAxis Regular( double origin, double step, int n );
+
+  int size() const { return positions.size(); }
+  /// Bin of v (between edges[bin] and edges[bin+1]), -1 outside of the edges
+  int FindBin( double v ) const;
+  /// Index of the position nearest to v, -1 if there are none
+  int Nearest( double v ) const;
+};
+
+/// Grid of the scan points of a file in x and y, for finding the scan
+/// points of a region or near a position without going through all of them.
+///
+/// The grid is inferred once from the scan points (ScanAxis of x and y), and
+/// each scan point is put in the cell of its nearest x and y positions.  The
+/// points at (0,0), where the gantry parks, are left out of the grid, as in
+/// Utilities::get_bins, but are still found by the queries.
+///
+///   ScanPointIndex index( scanpoints );
+///   TH2D h( "h", "", index.xaxis().size(), &index.xaxis().edges[0], ... );
+///   for ( unsigned iscan : index.InCircle( circ.xc, circ.yc, circ.r ) ) ...
+///
+/// The queries return scan point numbers (the index in scanpoints) in scan
+/// order.
+class ScanPointIndex {
+public:
+  ScanPointIndex( const std::vector< ScanPoint >& scanpoints, double tolerance = 1e-5 );
+
+  unsigned size() const { return fX.size(); }
+  const ScanAxis& xaxis() const { return fXAxis; }
+  const ScanAxis& yaxis() const { return fYAxis; }
+
+  /// Cell of scan point iscan on each axis, -1 for the points at (0,0)
+  int xbin( unsigned iscan ) const { return fXBin[ iscan ]; }
+  int ybin( unsigned iscan ) const { return fYBin[ iscan ]; }
+  /// Scan points in cell (ix, iy), none outside of the grid
+  const std::vector< unsigned >& InCell( int ix, int iy ) const;
+
+  /// Scan point nearest to (x,y), size() if there are none
+  unsigned Nearest( double x, double y ) const;
+  /// Scan points with xmin <= x <= xmax and ymin <= y <= ymax
+  std::vector< unsigned > InBox( double xmin, double xmax, double ymin, double ymax ) const;
+  /// Scan points less than r from (xc,yc), as Circle_st::is_inside
+  std::vector< unsigned > InCircle( double xc, double yc, double r ) const;
+  /// For each scan point, whether it is less than r from (xc,yc)
+  std::vector< bool > InsideCircle( double xc, double yc, double r ) const;
+
+private:
+  double fTolerance;
+  std::vector< double > fX, fY;
+  ScanAxis fXAxis, fYAxis;
+  std::vector< int > fXBin, fYBin;
+  std::vector< std::vector< unsigned > > fCells; // scan points of cell ix + nx * iy
+  std::vector< unsigned > fParked;               // scan points at (0,0)
+};
+
+#endif // __SCANPOINTINDEX__
@@ -0,0 +1,107 @@
+#ifndef __SCANPOINTSUMMARY__
+#define __SCANPOINTSUMMARY__
+
+#include <string>
+#include <vector>
+
+class Configuration;
+class TFile;
+class TTree;
+class TH1;
+class WaveformFitResult;
+
+/// Fixed binning of a summary histogram
+struct SummaryBinning {
+  int    nbins;
+  double xmin;
+  double xmax;
+};
+
+/// Settings of the per scan point summaries, from the config file
+///
+/// summary_tree                  write the scansummary tree of each PMT (default true)
+/// summary_charge_bins/min/max   fitted charge, as in ptf_charge_analysis
+/// summary_fine_bins/min/max     fitted charge, fine binning near the pedestal
+/// summary_amp_bins/min/max      fitted amplitude
+/// summary_time_bins/min/max     fitted pulse time (ns)
+/// The downstream tools fill their histograms at the centres of these bins,
+/// so they should be the same as or a multiple of the ones they book.
+struct ScanPointSummaryParams {
+  bool use{true};
+  SummaryBinning charge{100, 0., 5000.};
+  SummaryBinning fine{100, 0., 200.};
+  SummaryBinning amp{100, 0., 500.};
+  SummaryBinning time{280, 0., 140.};
+
+  void Load( const Configuration& config, const std::string& prefix = "summary_" );
+};
+
+/// Histogram of a summary, with the underflow in counts[0] and the overflow
+/// in counts[nbins+1]
+struct SummaryHistogram {
+  SummaryBinning binning{0, 0., 0.};
+  std::vector< int > counts;
+
+  void   Book( const SummaryBinning& b );
+  void   Fill( double x );
+  void   Add( const SummaryHistogram& other );
+  void   Reset();
+  double Center( int i ) const;
+  /// Add the counts times weight to h, each at its bin centre plus shift,
+  /// less the counts of subtract if given.  The errors of h are the
+  /// sqrt of the sum of count * weight^2, its entries go up by the counts.
+  void   AddTo( TH1* h, double weight = 1., double shift = 0.,
+                const SummaryHistogram* subtract = nullptr ) const;
+};
+
+/// Mergeable summary of the analysed waveforms of one PMT at one scan point.
+///
+/// Holds what the map making tools need from the ptfanalysis trees: the
+/// counts, the sums and sums of squares of the charges and pulse times, and
+/// fixed binning histograms of them.  The fitted charge is that of
+/// ptf_charge_analysis, sqrt(2 pi) |amp sigma|; "signal" is haswf.
+/// PTFAnalysis writes one entry per scan point to the scansummary<pmt> tree.
+struct ScanPointSummary {
+  int   scanpt{-1};
+  float x{0.}, y{0.}, z{0.};
+  unsigned long long entries{0};   // waveforms analysed
+  unsigned long long waveforms{0}; // waveforms recorded (preview mode, early stop)
+  unsigned long long nhaswf{0};    // analysed waveforms with a pulse
+  unsigned long long nqsum{0};     // with a charge sum
+  double qsum_sum{0.},  qsum_sum2{0.};   // charge sum, of the nqsum
+  double q_sum{0.},     q_sum2{0.};      // fitted charge, of all entries
+  double qsig_sum{0.},  qsig_sum2{0.};   // fitted charge, of the signals
+  double t_sum{0.},     t_sum2{0.};      // fitted time, of the signals
+  double tall_sum{0.},  tall_sum2{0.};   // fitted time, of all entries
+  SummaryHistogram hq;     // fitted charge, all entries
+  SummaryHistogram hqsig;  // fitted charge, signals
+  SummaryHistogram hqfine; // fitted charge, all entries, fine binning
+  SummaryHistogram hamp;   // fitted amplitude, all entries
+  SummaryHistogram ht;     // fitted time, signals
+  SummaryHistogram htall;  // fitted time, all entries
+
+  void Book( const ScanPointSummaryParams& par );
+  /// Start the summary of a scan point
+  void BeginScanPoint( int scanpt, float x, float y, float z, unsigned long long waveforms );
+  void Fill( const WaveformFitResult& wf );
+  /// Merge the summary of the same scan point from another run or file
+  void Add( const ScanPointSummary& other );
+  void Reset();
+
+  double efficiency() const { return entries > 0 ? double( nhaswf ) / entries : 0.; }
+  double mean_time() const { return nhaswf > 0 ? t_sum / nhaswf : 0.; }
+  double mean_time_all() const { return entries > 0 ? tall_sum / entries : 0.; }
+  // waveforms recorded that each entry stands for, as ScanPoint::weight()
+  double weight() const { return entries > 0 && waveforms > entries ? double( waveforms ) / entries : 1.; }
+
+  void MakeTTreeBranches( TTree * t );
+  void SetBranchAddresses( TTree * t );
+};
+
+/// Name of the summary tree of pmt
+std::string ScanPointSummaryTreeName( int pmt );
+
+/// Read the summaries of pmt, one per scan point; empty if the file has none
+std::vector< ScanPointSummary > ReadScanPointSummaries( TFile * fin, int pmt );
+
+#endif // __SCANPOINTSUMMARY__
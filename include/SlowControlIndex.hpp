@@ -0,0 +1,92 @@
+#ifndef __SLOWCONTROLINDEX__
+#define __SLOWCONTROLINDEX__
+
+#include <map>
+#include <string>
+#include <vector>
+
+/// Readings of one slow control quantity, kept sorted by time
+///
+/// The value at any time is interpolated linearly between the readings
+/// either side of it; before the first or after the last reading it is that
+/// reading.  At() finds the readings by binary search; a Cursor walks
+/// forward through them, for times that (mostly) come in increasing order,
+/// such as the evt_timestamp of the entries of a ptfanalysis tree.
+class TimeSeries {
+public:
+  TimeSeries( const std::string& name = "" ) : fName( name ) { }
+
+  /// Add a reading, in any order; readings with a time or value that is not
+  /// finite are left out.  entry is the tree entry it was read from, if any
+  void Add( double t, double value, long long entry = -1 );
+
+  const std::string& name() const { return fName; }
+  unsigned size() const { return fT.size(); }
+  bool     empty() const { return fT.empty(); }
+  double   time( unsigned i ) const { return fT[i]; }
+  double   value( unsigned i ) const { return fV[i]; }
+  long long entry( unsigned i ) const { return fE[i]; }
+
+  /// Value at t, NaN if there are no readings
+  double At( double t ) const;
+
+  class Cursor {
+  public:
+    Cursor( const TimeSeries& series ) : fSeries( &series ) { }
+    /// Value at t, as TimeSeries::At; a binary search only when t goes back
+    double At( double t );
+  private:
+    const TimeSeries* fSeries;
+    int fI{-1}; // last reading at or before the previous t
+  };
+  Cursor cursor() const { return Cursor( *this ); }
+
+private:
+  // last reading at or before t, -1 if t is before all of them
+  int Before( double t ) const;
+  // value at t from the readings i and i+1
+  double Interpolate( int i, double t ) const;
+
+  std::string fName;
+  std::vector< double > fT, fV;
+  std::vector< long long > fE;
+};
+
+
+/// Slow control readings of a raw run, one TimeSeries per quantity.
+///
+/// Each entry of the scan_tree has one reading of each quantity, at its
+/// timestamp: ext2_temp, and the field and acceleration of each phidget
+/// (the first value of the phidg<n>_Bx... arrays, as the other tools use).
+/// Only those branches are read.  The series are named after their
+/// branches, "ext2_temp", "phidg4_Bx", ... and have the same clock as the
+/// evt_timestamp of the waveforms (unix time, s, as recorded, not rounded
+/// to whole seconds), so the readings at the time of each waveform are
+///
+///   SlowControlIndex sc;
+///   if ( !sc.Build( "out_run04554.root" ) ) exit( EXIT_FAILURE );
+///   TimeSeries::Cursor temp = sc[ "ext2_temp" ].cursor();
+///   for ( ... each entry of ptfanalysis0 ... ) double T = temp.At( wf->evt_timestamp );
+class SlowControlIndex {
+public:
+  /// Read the readings of the scan_tree of rawfile, with those of the given
+  /// phidgets; false if it can not be read or has no timestamp branch.
+  /// Phidgets that are not in the run are left out.
+  bool Build( const std::string& rawfile, const std::vector< int >& phidgets = { 0, 1, 3, 4 },
+              const std::string& treeName = "scan_tree" );
+
+  bool Has( const std::string& name ) const { return fSeries.count( name ) > 0; }
+  /// Series of name; exits if there is none
+  const TimeSeries& operator[]( const std::string& name ) const;
+  /// Names of the series, in alphabetical order
+  std::vector< std::string > Names() const;
+
+  /// First and last reading time of all of the series
+  double tmin() const;
+  double tmax() const;
+
+private:
+  std::map< std::string, TimeSeries > fSeries;
+};
+
+#endif // __SLOWCONTROLINDEX__
@@ -0,0 +1,142 @@
+#ifndef __TIMESERIESAGGREGATOR__
+#define __TIMESERIESAGGREGATOR__
+
+#include "MeanRMSCalc.hpp"
+#include "WaveformFitResult.hpp"
+
+#include "TTree.h"
+
+#include <map>
+#include <vector>
+#include <string>
+#include <functional>
+
+/// Streaming quantile estimate using the P-square algorithm
+/// (R. Jain and I. Chlamtac, Comm. ACM 28 (1985) 1076).
+/// Keeps five markers, so memory use is fixed no matter how many
+/// values are added.
+class P2Quantile {
+public:
+  P2Quantile( double p = 0.5 );
+  void   add( double val );                 //< add a data point
+  double value() const;                     //< current estimate of the p-quantile
+  double prob() const { return fP; }
+  unsigned long long ndatapts() const { return npts; }
+
+private:
+  double parabolic( int i, int d ) const;
+  double linear( int i, int d ) const;
+
+  double fP;
+  double q[5];      // marker heights
+  double n[5];      // marker positions
+  double np[5];     // desired marker positions
+  double dn[5];     // increment of desired marker positions
+  unsigned long long npts{0};
+};
+
+
+/// Summary of the values that fell into one time window
+class TimeWindowStats {
+public:
+  TimeWindowStats( double tstart, double tstop, const std::vector< double >& quantiles,
+                   unsigned nbins, double xmin, double xmax );
+
+  void add( double val );
+
+  double tstart() const { return fTStart; }
+  double tstop()  const { return fTStop; }
+  unsigned long long nentries() const { return fMeanRMS.ndatapts(); }
+  double mean() const { return fMeanRMS.mean(); }
+  double rms()  const { return fMeanRMS.rms(); }
+  double mean_err() const;
+  double quantile( unsigned iq ) const { return fQuantiles[ iq ].value(); }
+  unsigned nquantiles() const { return fQuantiles.size(); }
+  // Peak (mode) estimate from the fixed binning histogram, refined by a
+  // parabola through the maximum bin and its neighbours.  No fit is done.
+  double peak() const;
+  // Half width at half maximum around the peak, from the same histogram
+  double peak_hwhm() const;
+  // Number of values outside the histogram range used for the peak
+  unsigned long long overflow() const { return fOverflow; }
+
+private:
+  double fTStart;
+  double fTStop;
+  MeanRMSCalc fMeanRMS;
+  std::vector< P2Quantile > fQuantiles;
+  std::vector< unsigned > fHist;
+  double fXMin;
+  double fBinWid;
+  unsigned long long fOverflow{0};
+};
+
+
+/// Streaming aggregator of a quantity as a function of time.
+/// Values are keyed on a timestamp (normally WaveformFitResult::evt_timestamp,
+/// in seconds) and summarised per time window.
+///
+/// Windows start at origin + k*step and are width long.  Setting step equal
+/// to width gives fixed (non-overlapping) windows, step smaller than width
+/// gives sliding windows.  Windows are created on demand and stay open, so
+/// timestamps can arrive in any order.  Each window uses a fixed amount of
+/// memory (MeanRMSCalc, one P2Quantile per requested quantile, and an nbins
+/// histogram for the peak estimate).
+///
+/// Example usage, average pulse height per minute:
+///
+/// TimeSeriesAggregator agg( 60. );
+/// agg.set_peak_binning( 200, 0., 20. );
+/// agg.fill_from_tree( tt, wf, []( const WaveformFitResult& w, std::vector<double>& vals ){
+///     for ( const PulseInfo& p : w.pulses() ) vals.push_back( p.charge );
+/// } );
+/// for ( const TimeWindowStats& w : agg.windows() ) ...
+class TimeSeriesAggregator {
+public:
+  // Extract zero or more values to aggregate from one waveform
+  typedef std::function< void( const WaveformFitResult&, std::vector< double >& ) > Extractor;
+
+  // width and step in seconds; step <= 0 means step = width (fixed windows)
+  TimeSeriesAggregator( double width, double step = 0. );
+
+  // Set the window origin explicitly; otherwise the first timestamp seen
+  // is used (earlier timestamps still work, they get negative window index)
+  void set_origin( double t0 ){ fOrigin = t0; fHaveOrigin = true; }
+  // Quantiles tracked in each window (default 0.16, 0.5, 0.84)
+  void set_quantiles( const std::vector< double >& q ){ fQuantiles = q; }
+  // Binning of the per-window histogram used for the peak estimate
+  void set_peak_binning( unsigned nbins, double xmin, double xmax ){
+    fNBins = nbins; fXMin = xmin; fXMax = xmax;
+  }
+
+  // Add one value at time t
+  void add( double t, double val );
+
+  // Run over a ptfanalysisN tree in one pass.  The WaveformFitResult must
+  // already have its branch addresses set on the tree.
+  // Returns the number of entries read.
+  unsigned long long fill_from_tree( TTree* tt, WaveformFitResult* wf, Extractor extract );
+
+  // Windows sorted in time; only windows that received data are listed
+  std::vector< TimeWindowStats > windows() const;
+  unsigned nwindows() const { return fWindows.size(); }
+  double origin() const { return fOrigin; }
+
+  // Write the window summaries to a TTree in the current directory
+  void write( const std::string& treename = "timeseries" ) const;
+
+private:
+  double fWidth;
+  double fStep;
+  double fOrigin{0.};
+  bool   fHaveOrigin{false};
+  std::vector< double > fQuantiles;
+  unsigned fNBins{100};
+  double fXMin{0.};
+  double fXMax{100.};
+
+  // open windows keyed on window index
+  std::map< long long, TimeWindowStats > fWindows;
+};
+
+#endif // __TIMESERIESAGGREGATOR__
@@ -0,0 +1,60 @@
+#ifndef __TREEOUTPUTPOLICY__
+#define __TREEOUTPUTPOLICY__
+
+#include <string>
+
+class Configuration;
+class TFile;
+class TTree;
+
+/// How an output TTree is written: compression, clustering and basket size.
+///
+/// Read from the configuration file (all keys optional, ROOT defaults otherwise):
+///
+/// output_compression            = default, none, zlib, lzma, lz4 or zstd
+/// output_compression_level      = 1 to 9 (default depends on the algorithm)
+/// output_autoflush              = default, scanpoint, or a number of entries
+/// output_scanpoints_per_cluster = scan points per cluster with scanpoint
+/// output_basket_size            = buffer size of each branch (bytes)
+///
+/// or from a spec "compression[:level[:autoflush[:basket_size]]]",
+/// eg. "lz4:4:scanpoint:16000", which ptf_bench uses to compare policies.
+///
+/// With autoflush = scanpoint the automatic flushing of the tree is turned
+/// off, and the baskets are flushed after every output_scanpoints_per_cluster
+/// scan points (EndScanPoint).  Each cluster then holds whole scan points, so
+/// reading back one scan point only decompresses baskets of that scan point.
+/// (FlushBaskets only starts a new cluster from ROOT 6.14 on.)
+class TreeOutputPolicy {
+public:
+  TreeOutputPolicy() { }
+  TreeOutputPolicy( const std::string& spec ) { Parse( spec ); }
+
+  void Load( const Configuration& config, const std::string& prefix = "output_" );
+  void Parse( const std::string& spec );
+
+  // Compression settings to use for new branches of the file
+  // (only branches made after this call are affected)
+  void Apply( TFile * f ) const;
+  // Flushing and basket size of a tree, after its branches are made
+  void Apply( TTree * t );
+  // Call at the end of each scan point
+  void EndScanPoint( TTree * t );
+
+  // ROOT compression settings (100*algorithm + level), -1 for ROOT default
+  int CompressionSettings() const;
+  // Short description, eg. "lz4:4:scanpoint"
+  std::string Name() const;
+
+  std::string compression{"default"};
+  int  level{-1};                    //< -1 for the default level of the algorithm
+  bool flush_scanpoint{false};       //< flush at scan point boundaries
+  long flush_entries{0};             //< SetAutoFlush value, 0 for ROOT default
+  int  scanpoints_per_cluster{1};
+  int  basket_size{0};               //< 0 for ROOT default
+
+private:
+  int fScanPoints{0}; // scan points since last flush
+};
+
+#endif // __TREEOUTPUTPOLICY__
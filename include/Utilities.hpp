@@ -5,8 +5,17 @@
 #include "WaveformFitResult.hpp"
 
 #include <vector>
+#include <string>
 #include <cmath>
 
+class TH1;
+
+/// One line of a run list file: input file name and run number
+struct RunFile {
+  std::string filename;
+  std::string run;
+};
+
 /// Class for providing utility functions for analyses
 
 class Utilities {
@@ -15,14 +24,24 @@ public:
   //default constructor takes no input
   Utilities(){};
   //get vector of bin edges from scan points
-  const std::vector<double> get_bins( std::vector< ScanPoint > scanpoints, char dim);
+  const std::vector<double> get_bins( const std::vector< ScanPoint >& scanpoints, char dim);
   //set a style for plots
   void set_style();
   //does the PMT signal contain a waveform?
   bool HasWaveform( WaveformFitResult *wf, int pmt );
-
-private:
-  static bool comparison (double i, double j){ return (fabs( i-j ) < 1e-5); }
+  //read a run list, one "filename run_number" per line, # for comments
+  std::vector< RunFile > read_run_list( const std::string& listfile );
+  //fraction of the recorded waveforms that were analysed, below 1 in preview mode
+  //or with the early stop
+  double sampled_fraction( const std::vector< ScanPoint >& scanpoints );
+  //mean number of analysed waveforms per scan point
+  double mean_entries( const std::vector< ScanPoint >& scanpoints );
+  //to add to the title of a map made from part of the waveforms: the fraction analysed and
+  //the typical statistical error of one scan point (left out if negative)
+  //empty if all of the waveforms were analysed
+  std::string preview_label( const std::vector< ScanPoint >& scanpoints, double error = -1. );
+  //add the preview_label to the title of h, ahead of the axis titles
+  void label_preview( TH1* h, const std::vector< ScanPoint >& scanpoints, double error = -1. );
 
 };
 
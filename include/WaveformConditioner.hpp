@@ -0,0 +1,113 @@
+#ifndef __WAVEFORMCONDITIONER__
+#define __WAVEFORMCONDITIONER__
+
+#include <string>
+#include <vector>
+
+class Configuration;
+
+/// Settings of the waveform conditioning, from the config file.  Every key
+/// can be set for all channels as condition_<key>, and for one channel as
+/// condition_ch<channel>_<key>, which takes precedence:
+///
+/// condition_baseline_samples    first raw samples averaged for the baseline
+/// condition_subtract_baseline   move the baseline to condition_baseline_level
+/// condition_baseline_level      baseline after subtraction (V)
+/// condition_smooth              boxcar smoothing width (samples, odd)
+/// condition_decimate            raw samples averaged into one conditioned sample
+/// condition_invert              flip the sign, for positive pulses
+/// condition_roi_tmin, _tmax     time range kept (ns), whole waveform if tmax <= tmin
+///
+/// The defaults only scale the digitizer counts to volts.
+struct ConditioningParams {
+  int    baseline_samples{20};
+  bool   subtract_baseline{false};
+  double baseline_level{1.0};
+  int    smooth{1};
+  int    decimate{1};
+  bool   invert{false};
+  double roi_tmin{0.};
+  double roi_tmax{0.};
+
+  // Read the settings for all channels, then those of channel (if >= 0)
+  void Load( const Configuration& config, int channel = -1 );
+};
+
+/// One conditioned waveform, in volts
+struct ConditionedWaveform {
+  std::vector< double > volts;
+  int    nsamples{0};
+  double t0{0.};            //< start of the first sample (ns)
+  double sample_ns{0.};     //< width of a sample (ns)
+  double pedestal{0.};      //< level of the baseline in volts (V)
+  double raw_baseline{0.};  //< baseline estimate before any subtraction (V)
+  double raw_baseline_min{0.}; //< lowest sample of the baseline estimate (V)
+  bool   baseline_subtracted{false};
+
+  double time( int k ) const { return t0 + ( k + 0.5 ) * sample_ns; } //< centre of sample k
+};
+
+/// Turns raw digitizer samples into the waveform that the fits and pulse
+/// finders work on.  The stages, in order:
+///
+///   scale       digitizer counts to volts
+///   baseline    mean of the first baseline_samples, optionally subtracted
+///   smooth      boxcar of smooth samples
+///   decimate    mean of each decimate samples
+///   invert      sign flip
+///   roi         only samples in [roi_tmin, roi_tmax)
+///
+/// The baseline is taken from a short pass over the start of the waveform,
+/// then the other stages are done together in one pass over the region of
+/// interest: the boxcar is a running sum over the raw counts, decimation
+/// adds decimate of those sums, and scale, baseline and inversion are a
+/// single multiply and add per output sample.
+///
+/// The pipeline is this one fixed, hand fused pass, not a list of stages
+/// that can be composed or reordered.  Every stage but the region of
+/// interest is linear, so any other order of them gives the same samples,
+/// and a stage list would only add a call per stage and sample.  There is
+/// no explicit SIMD: the build has no optimisation or architecture flags,
+/// and the boxcar is a running sum carried from one sample to the next.
+/// ptf_bench times the pass as condition_waveform (scale only) and
+/// condition_waveform_smooth5_decimate2.
+///
+/// Example usage:
+///
+/// ConditioningParams par;
+/// par.Load( config, channel );
+/// WaveformConditioner cond( par, nsamples, 2.0, 2.0/16384 );
+/// ConditionedWaveform wf;
+/// cond.Process( raw_samples, wf );
+class WaveformConditioner {
+public:
+  WaveformConditioner( const ConditioningParams& par, int nraw, double raw_sample_ns, double scale );
+
+  // Condition nraw samples of raw, into out
+  void Process( const double* raw, ConditionedWaveform& out ) const;
+
+  // Binning of the conditioned waveforms
+  int    nsamples()  const { return fN; }
+  double sample_ns() const { return fRawSampleNs * fDecimate; }
+  double tmin()      const { return fFirst * fRawSampleNs; }
+  double tmax()      const { return tmin() + fN * sample_ns(); }
+  bool   has_roi()   const { return fPar.roi_tmax > fPar.roi_tmin; }
+
+  // Error on a conditioned sample, for an error of one raw count
+  double error_scale() const;
+
+  const ConditioningParams& params() const { return fPar; }
+  std::string Describe() const;
+
+private:
+  ConditioningParams fPar;
+  int    fNraw;
+  double fRawSampleNs;
+  double fScale;      // volts per count
+  int    fFirst;      // first raw sample of the region of interest
+  int    fN;          // conditioned samples
+  int    fHalf;       // half width of the boxcar
+  int    fDecimate;
+};
+
+#endif // __WAVEFORMCONDITIONER__
@@ -3,20 +3,72 @@
 
 #include "TTree.h"
 #include <string>
+#include <vector>
 
-#define MAX_PULSES 10
+// Initial capacity of the pulse arrays, they grow as needed
+#define PULSES_RESERVE 10
+
+/// One pulse found in a waveform
+struct PulseInfo {
+  float time;      //< pulse time (minimum bin)
+  float timeCFD;   //< pulse time using CFD calculation
+  float timeErr;   //< pulse time error
+  float charge;    //< pulse charge (height)
+  float chargeErr; //< pulse charge error
+};
+
+class WaveformFitResult;
+
+/// Iterator over the pulses of a WaveformFitResult
+class PulseIterator {
+public:
+  PulseIterator( const WaveformFitResult* wf, int i ) : fWf( wf ), fIdx( i ) { }
+  PulseInfo operator*() const;
+  PulseIterator& operator++() { ++fIdx; return *this; }
+  bool operator!=( const PulseIterator& o ) const { return fIdx != o.fIdx; }
+private:
+  const WaveformFitResult* fWf;
+  int fIdx;
+};
+
+/// Range over the pulses of a WaveformFitResult, for range-based for loops
+struct PulseRange {
+  PulseIterator b, e;
+  PulseIterator begin() const { return b; }
+  PulseIterator end() const { return e; }
+};
 
 /// Structure to hold information about one waveform fit
 /// It is of the form that it can be used to set up a TTree readout
+///
+/// The pulse arrays have no fixed size limit.  They are stored as
+/// variable length arrays (pulseTimes[numPulses]/F etc.) so only numPulses
+/// values are written per waveform, and files written with the old fixed
+/// size arrays can still be read.  Only the first numPulses entries of the
+/// arrays are valid.  Pulses can be looped over with:
+///
+/// for ( const PulseInfo& p : wf->pulses() ) h->Fill( p.time );
 class WaveformFitResult {
 public:
-  WaveformFitResult(){ Init(); } // default constructor
+  WaveformFitResult(){ GrowPulses( PULSES_RESERVE ); Init(); } // default constructor
   ~WaveformFitResult(){}; // default destructor
+  // Not copyable: the tree branches point into the pulse arrays of this one
+  WaveformFitResult( const WaveformFitResult& ) = delete;
+  WaveformFitResult& operator=( const WaveformFitResult& ) = delete;
   void Init();
   const char * GetRootString();
   void MakeTTreeBranches(TTree * t);
+  // Sizes the pulse arrays to the largest numPulses in the tree
   void SetBranchAddresses(TTree * t);
 
+  // Pulse access
+  void ClearPulses(){ numPulses = 0; }
+  void AddPulse( float time, float timeCFD, float charge, float timeErr = 0., float chargeErr = 0. );
+  PulseInfo pulse( int i ) const {
+    return PulseInfo{ pulseTimes[i], pulseTimesCFD[i], pulseTimeErr[i], pulseCharges[i], pulseChargeErr[i] };
+  }
+  PulseRange pulses() const { return PulseRange{ PulseIterator( this, 0 ), PulseIterator( this, numPulses ) }; }
+
   int scanpt;       //< scan point number
   int wavenum;      //< waveform number in scan
   int nwaves;       //< number of waveforms in this scan point
@@ -48,16 +100,22 @@ public:
   float qped;       //< fixed pedestal
   float qsum;       //< charge sum
   int numPulses; //< number of pulses found in waveform
-  float pulseTimes[MAX_PULSES]; // Pulse times
-  float pulseTimesCFD[MAX_PULSES]; // Pulse times using CFD calculation
-  float pulseTimeErr[MAX_PULSES]; // Pulse time errors
-  float pulseCharges[MAX_PULSES]; // Pulse charges
-  float pulseChargeErr[MAX_PULSES]; // Pulse charge errors
+  std::vector< float > pulseTimes; // Pulse times
+  std::vector< float > pulseTimesCFD; // Pulse times using CFD calculation
+  std::vector< float > pulseTimeErr; // Pulse time errors
+  std::vector< float > pulseCharges; // Pulse charges
+  std::vector< float > pulseChargeErr; // Pulse charge errors
   float pulseArea; //< area under the fit gaussian
 
 private:
+  // Resize the pulse arrays, and point the TTree branches at the new storage
+  void GrowPulses( unsigned n );
+  void SetPulseAddresses();
+
   // hold copy of string needed for making TTree
   std::string rootstring;
+  // tree the pulse arrays are attached to
+  TTree * fTree{nullptr};
 
 };
 
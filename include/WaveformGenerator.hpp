@@ -0,0 +1,100 @@
+#ifndef __WAVEFORMGENERATOR__
+#define __WAVEFORMGENERATOR__
+
+#include "TRandom3.h"
+
+#include <vector>
+#include <string>
+
+class Configuration;
+
+/// Shapes available for the simulated PMT pulses
+enum PulseShape {
+  GaussianPulse = 0, // same shape as PTFAnalysis::pmt0_gaussian
+  EMGPulse = 1       // exponentially modified gaussian, as PTFAnalysis::funcEMG
+};
+
+/// Parameters of the simulated waveforms.  Times in ns, voltages in V.
+/// Pulses are negative going from the baseline, like the PTF and mPMT data.
+struct WaveformGeneratorParams {
+  int    nsamples{70};          //< samples per waveform
+  double sample_ns{2.0};        //< ns per sample (1000/sampling rate in MS/s)
+  double full_scale{2.0};       //< digitizer full scale range (Vpp)
+  int    resolution{14};        //< digitizer resolution (bits)
+  double baseline{1.0};         //< baseline (V)
+  double noise{4.0e-4};         //< gaussian white noise rms (V)
+  int    shape{GaussianPulse};  //< PulseShape
+  double pulse_time{70.0};      //< laser pulse arrival time (ns)
+  double pulse_jitter{1.0};     //< rms of laser pulse arrival time (ns)
+  double pulse_sigma{5.2};      //< gaussian width of a pulse (ns)
+  double pulse_tau{15.8};       //< exponential decay constant for EMG pulses (ns)
+  double pe_amplitude{5.0e-3};  //< peak amplitude of a single photoelectron (V)
+  double pe_spread{0.3};        //< fractional rms of single photoelectron amplitude
+  double mu{0.2};               //< mean number of photoelectrons per laser pulse
+  double ring_amp{0.0};         //< ringing amplitude (V)
+  double ring_freq{0.25};       //< ringing frequency (rad/ns)
+  double afterpulse_prob{0.0};  //< afterpulse probability per photoelectron
+  double afterpulse_delay{1000.};  //< mean afterpulse delay (ns)
+  double afterpulse_spread{200.};  //< rms of afterpulse delay (ns)
+  double dark_rate{0.0};        //< dark pulse rate (Hz)
+
+  // Read any parameters present in the configuration file, with the
+  // given prefix in front of each key (eg. "gen_mu")
+  void Load( const Configuration& config, const std::string& prefix = "gen_" );
+};
+
+/// Known truth of one simulated waveform
+struct WaveformTruth {
+  int    npe{0};          //< photoelectrons from the laser pulse
+  int    nafterpulses{0}; //< afterpulses generated
+  int    ndark{0};        //< dark pulses generated
+  double time{0.};        //< laser arrival time (ns)
+  double amp{0.};         //< summed peak amplitude of the laser pulse photoelectrons (V)
+  double charge{0.};      //< integral of all pulses (V ns)
+  double ring_amp{0.};    //< ringing amplitude (V)
+  double ring_phase{0.};  //< ringing phase (rad)
+  std::vector< double > pulse_times; //< time of every pulse (ns), laser pulses first
+  std::vector< double > pulse_amps;  //< peak amplitude of every pulse (V)
+  void Clear();
+};
+
+/// Generates digitized PMT waveforms with known truth.
+/// Samples are written in ADC counts, as stored in the scan_tree, so that
+/// they go through the same Wrapper / PTFAnalysis path as real data.
+///
+/// Example usage:
+///
+/// WaveformGeneratorParams par;
+/// par.mu = 1.0;
+/// WaveformGenerator gen( par, 4357 );
+/// std::vector< double > samples( par.nsamples );
+/// WaveformTruth truth;
+/// gen.generate( &samples[0], truth );
+class WaveformGenerator {
+public:
+  WaveformGenerator( const WaveformGeneratorParams& par, unsigned seed = 4357 );
+
+  // Fill out[0..nsamples-1] with one waveform in ADC counts
+  void generate( double* out, WaveformTruth& truth );
+
+  const WaveformGeneratorParams& params() const { return fPar; }
+
+  // Pulse shape of unit peak amplitude, centred (gaussian) or with
+  // gaussian mean (EMG) at t0
+  double shape( double t, double t0 ) const;
+  // Integral of a pulse of unit peak amplitude (ns)
+  double shape_area() const { return fArea; }
+
+private:
+  void add_pulse( double t0, double amp, WaveformTruth& truth );
+
+  WaveformGeneratorParams fPar;
+  TRandom3 fRand;
+  double fNorm{1.};            // EMG normalization to unit peak
+  double fArea{1.};            // area of unit peak pulse
+  double fCountsPerVolt{1.};
+  double fMaxCounts{1.};
+  std::vector< double > fVolts; // work buffer in volts
+};
+
+#endif // __WAVEFORMGENERATOR__
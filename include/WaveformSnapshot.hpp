@@ -0,0 +1,108 @@
+#ifndef __WAVEFORMSNAPSHOT__
+#define __WAVEFORMSNAPSHOT__
+
+#include "TTree.h"
+#include "TH1.h"
+#include "TH1D.h"
+#include "TRandom3.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+class Configuration;
+class WaveformFitResult;
+
+/// Which waveforms PTFAnalysis keeps snapshots of (save_waveforms on).
+/// Read from the configuration file, all keys optional:
+///
+/// snapshot_x, snapshot_y     centre of the scan region (m), default 0.46, 0.38
+/// snapshot_radius            half width of the region (m), default 0.0005,
+///                            negative for the whole scan
+/// snapshot_haswf             -1 any, 1 only with a pulse, 0 only without
+/// snapshot_fitstat           -1 any, 0 only good fits, 1 only failed fits
+/// snapshot_prescale          fraction of the selected waveforms to keep
+/// snapshot_max               maximum snapshots with and without a pulse
+/// snapshot_fft               also keep the FFT magnitude spectrum
+/// snapshot_seed              seed for the prescale
+struct SnapshotSelection {
+  double x{0.46};
+  double y{0.38};
+  double radius{0.0005};
+  int    haswf{-1};
+  int    fitstat{-1};
+  double prescale{1.0};
+  int    max{500};
+  bool   fft{true};
+  int    seed{4357};
+
+  void Load( const Configuration& config, const std::string& prefix = "snapshot_" );
+};
+
+/// Decides if a waveform is kept, and counts what was kept
+class SnapshotSelector {
+public:
+  SnapshotSelector( const SnapshotSelection& sel ) : fSel( sel ), fRand( sel.seed ) { }
+  bool Select( const WaveformFitResult& wf );
+  const SnapshotSelection& selection() const { return fSel; }
+
+private:
+  SnapshotSelection fSel;
+  TRandom3 fRand;
+  int fNum[2] = { 0, 0 }; // kept without, with a pulse
+  // the region cut only changes with the scan point, so it is worked out
+  // once for each position
+  float fLastX{NAN}, fLastY{NAN};
+  bool  fInRegion{false};
+};
+
+/// One saved waveform, and optionally its FFT, as one row of a TTree
+/// (snapshots<pmt>).  Samples are stored as floats in the units of the
+/// histogram they were taken from, with the histogram range, so that the
+/// TH1D can be made again when it is wanted for plotting:
+///
+/// WaveformSnapshot snap;
+/// snap.SetBranchAddresses( tt );
+/// tt->GetEntry( i );
+/// TH1D * h = snap.MakeWaveform( "hwf" );
+///
+/// or find the snapshot of a ptfanalysis entry with
+/// TH1D * h = WaveformSnapshot::GetWaveform( tt, entry, "hwf" );
+class WaveformSnapshot {
+public:
+  WaveformSnapshot() { }
+
+  void MakeTTreeBranches( TTree * t );
+  void SetBranchAddresses( TTree * t );
+
+  // Copy the contents of the waveform (and FFT if not null) into this row
+  void Set( unsigned long long entry, int channel, const WaveformFitResult& wf,
+            const TH1 * hwaveform, const TH1 * hfft );
+
+  // Make histograms from the current row, owned by the caller
+  TH1D * MakeWaveform( const char * name ) const;
+  TH1D * MakeFFT( const char * name ) const;
+
+  // Histogram of the snapshot of ptfanalysis entry in tree t, nullptr if
+  // that entry was not saved
+  static TH1D * GetWaveform( TTree * t, unsigned long long entry, const char * name, bool fft = false );
+
+  unsigned long long entry{0}; //< entry in the ptfanalysis tree
+  int   scanpt{0};             //< scan point number
+  int   wavenum{0};            //< waveform number in scan point
+  int   channel{0};            //< digitizer channel
+  int   haswf{0};              //< 1 if has a pulse, 0 if not
+  int   fitstat{0};            //< fit status
+  int   nsamples{0};
+  float tmin{0.}, tmax{0.};    //< range of the waveform histogram (ns)
+  int   nfft{0};               //< 0 if FFT not saved
+  float fmin{0.}, fmax{0.};    //< range of the FFT histogram
+  std::vector< float > samples;
+  std::vector< float > fft;
+
+private:
+  void Resize( int n, int nf );
+  TTree * fTree{nullptr};
+};
+
+#endif // __WAVEFORMSNAPSHOT__
@@ -0,0 +1,84 @@
+#ifndef __ZEROSUPPRESSION__
+#define __ZEROSUPPRESSION__
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class Configuration;
+
+/// Settings of the zero suppression, from the config file
+///
+/// zs_threshold         keep samples further than this from the baseline (ADC counts)
+/// zs_nsigma            or further than this many baseline rms, if larger
+/// zs_pre, zs_post      samples kept before and after each crossing
+/// zs_baseline_samples  first samples used for the baseline statistics
+/// zs_keep_baseline     always keep the baseline samples, so that the baseline
+///                      and its noise are exact when reading back
+/// zs_keep_first,       always keep this range of samples (e.g. the charge
+///   zs_keep_last       window), off if zs_keep_last < zs_keep_first
+struct ZeroSuppressionParams {
+  double threshold{5.};
+  double nsigma{0.};
+  int    pre{8};
+  int    post{16};
+  int    baseline_samples{20};
+  bool   keep_baseline{true};
+  int    keep_first{0};
+  int    keep_last{-1};
+
+  void Load( const Configuration& config, const std::string& prefix = "zs_" );
+};
+
+/// Zero suppressed waveforms of one channel.
+///
+/// Each waveform keeps the windows of samples around the threshold crossings;
+/// everything else is replaced by the baseline (mean of the first
+/// baseline_samples) when it is read back.  The samples in the windows are
+/// stored losslessly: they must be integer ADC counts, and are written as
+/// zigzag coded differences from the previous sample, bit-packed with the
+/// width of the largest difference in the window.
+///
+/// Layout of the bytes of one waveform (n = varint, LEB128):
+///   n windows, then for each window:
+///     n gap from the end of the previous window, n length, 1 byte bit width,
+///     ceil( length * width / 8 ) bytes of packed differences
+/// The first difference of a window is from the rounded baseline.
+class ZeroSuppressor {
+public:
+  ZeroSuppressor( const ZeroSuppressionParams& par );
+
+  /// Append the compressed samples[0..n) to out, and give the baseline mean
+  /// and rms.  Returns false if a sample is not an integer ADC count.
+  bool Encode( const double* samples, int n, std::vector< unsigned char >& out,
+               float& baseline, float& rms );
+
+  unsigned long long samples_in()   const { return fSamplesIn; }
+  unsigned long long samples_kept() const { return fSamplesKept; }
+  unsigned long long waveforms()    const { return fWaveforms; }
+  double suppressed_fraction() const {
+    return fSamplesIn > 0 ? 1. - double( fSamplesKept ) / fSamplesIn : 0.;
+  }
+  const ZeroSuppressionParams& params() const { return fPar; }
+
+private:
+  ZeroSuppressionParams fPar;
+  std::vector< std::pair< int, int > > fWindows; // kept ranges, before merging
+  std::vector< int > fStart, fEnd; // windows [start,end) of the current waveform
+  unsigned long long fSamplesIn{0};
+  unsigned long long fSamplesKept{0};
+  unsigned long long fWaveforms{0};
+};
+
+/// Decode one waveform of n samples starting at p, filling the suppressed
+/// samples with baseline.  Advances p past the waveform, and returns false
+/// if the bytes run past end or a window runs past n.
+bool ZeroSuppressedDecode( const unsigned char*& p, const unsigned char* end,
+                           double baseline, double* out, int n );
+
+/// Branch names of the zero suppressed channel whose raw branch is name:
+/// zs_<name> packed bytes, zs_<name>_nbytes their number,
+/// zs_<name>_baseline and zs_<name>_rms the baseline of each waveform
+std::string ZeroSuppressedBranch( const std::string& name, const std::string& suffix = "" );
+
+#endif // __ZEROSUPPRESSION__
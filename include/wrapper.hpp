@@ -9,6 +9,7 @@
 #include <exception>
 #include <algorithm>
 #include <unordered_map>
+#include <memory>
 #include <iostream>
 #include <iostream>
 #include <fstream>
@@ -18,10 +19,10 @@
 #include "TFile.h"
 #include "TTree.h"
 #include "TBranch.h"
+#include "TLeaf.h"
 
 #include "config.hpp"
-
-#define nPoints_max 6000 
+#include "BufferPool.hpp"
 
 /// Classes to to help with reading in PTF data
 /// PTF::PmtChannel           holds pmt number and channel number
@@ -126,9 +127,17 @@ struct Timing {
 struct PMTSet {
   int      channel;
   PTF::PMTType  type;
-  double*  data{nullptr};
+  double*  data{nullptr}; // owned by the Wrapper's BufferPool
   TBranch* branch{nullptr};
 
+  // zero suppressed files (see ZeroSuppression.hpp): the packed bytes and
+  // baselines of the entry, decoded into data by setCurrentEntry
+  std::vector<unsigned char> zsBytes;
+  std::vector<float> zsBaseline;
+  int      zsNBytes{0};
+  TBranch* zsBranch{nullptr};
+  TBranch* zsNBytesBranch{nullptr};
+  TBranch* zsBaselineBranch{nullptr};
 };
 
 struct EvtTimestampSet {
@@ -171,10 +180,28 @@ struct Digitizer {
 
 
 
+/// The waveform and timestamp buffers are sized from the leaves of the tree
+/// when a file is opened (largest num_points and waveform length), and grow
+/// if a later file or entry needs more.  The maxSamples and sampleSize
+/// arguments of the older constructors are only used for files whose
+/// branches do not give the sizes.
+///
+/// Files written by mpmt_zs_export, with the zero suppressed zs_V1730_wave<ch>
+/// branches in place of the waveforms, are read the same way: each entry is
+/// decoded into the waveform buffers, with the suppressed samples at the
+/// baseline of their waveform.
+///
+/// The Wrapper owns all of its buffers.  The waveform buffers come from one
+/// BufferPool that is reused by every file opened, so one Wrapper can go
+/// through many runs without growing.  It can not be copied; construct it
+/// in place: Wrapper wrapper( activePMTs, phidgets, gantries, digi );
 struct Wrapper {
+	Wrapper(const std::vector<PTF::PMT>& activePMTs, const std::vector<int>& phidgets, const std::vector<PTF::Gantry>& gantries, DigitizerModel digi);
 	Wrapper(unsigned long long maxSamples, unsigned long long sampleSize, const std::vector<PTF::PMT>& activePMTs, const std::vector<int>& phidgets, const std::vector<PTF::Gantry>& gantries, DigitizerModel digi);
     Wrapper(unsigned long long maxSamples, unsigned long long sampleSize, const std::vector<PTF::PMT>& activePMTs, const std::vector<int>& phidgets, const std::vector<PTF::Gantry>& gantries, DigitizerModel digi, const std::string& fileName, const std::string& treeName = "scan_tree");
 	~Wrapper();
+	Wrapper(const Wrapper&) = delete;
+	Wrapper& operator=(const Wrapper&) = delete;
 
 
 public:
@@ -187,6 +214,14 @@ public:
   // Does nothing if the file is already closed 
   void closeFile();
 
+  // Run lists, to process several files in one process.
+  // The data buffers are allocated once and reused for every run.
+  void setRunList(const std::vector<std::string>& fileNames, const std::string& treeName = "scan_tree");
+  unsigned getNumRuns() const { return runFiles.size(); }
+  const std::string& getRunFileName(unsigned irun) const { return runFiles.at(irun); }
+  // Closes the current file and opens run irun of the run list
+  void openRun(unsigned irun);
+
   // Load the BRB settings tree; returns -1 on failure
   int LoadBrbSettingsTree();
   
@@ -209,11 +244,16 @@ public:
 
   // Gets the data for a given sample on the current
   // Throws on invalid sample or file not open
+  // The pointer is valid until the buffers grow (on opening a file, or
+  // on an entry with more samples than any before)
   double* getPmtSample(int pmt, unsigned long long sample) const;
 
   // Returns the length of the samples
   int getSampleLength() const;
 
+  // True if the open file is zero suppressed
+  bool isZeroSuppressed() const { return zeroSuppressed; }
+
   // Return the event timestamp
   double getEventTimestamp(unsigned long long sample) const;
 
@@ -235,15 +275,22 @@ public:
 private:
   TFile* file{0};
   TTree* tree{0};
-  unsigned long long maxSamples;
-  unsigned long long sampleSize;
+  unsigned long long maxSamples{0};   // waveforms per entry the buffers hold
+  unsigned long long sampleSize{0};   // samples per waveform
+  unsigned long long defaultMaxSamples{0}; // used if the file does not give the sizes
+  unsigned long long defaultSampleSize{0};
   unsigned long long entry{ULONG_MAX};
-  double evt_timestamp[nPoints_max];
+  std::vector<double> evt_timestamp;
+  TBranch* numSamplesBranch{nullptr};
+  bool zeroSuppressed{false};
+  std::vector<std::string> runFiles;
+  std::string runTreeName{"scan_tree"};
 
   // data
-  std::unordered_map<int, PMTSet*>     pmtData;
-  std::unordered_map<int, PhidgetSet*> phidgetData;
-  std::unordered_map<int, GantrySet*>  gantryData;
+  std::unordered_map<int, std::unique_ptr<PMTSet>>     pmtData;
+  std::unordered_map<int, std::unique_ptr<PhidgetSet>> phidgetData;
+  std::unordered_map<int, std::unique_ptr<GantrySet>>  gantryData;
+  BufferPool bufferPool; // waveform buffers of the PMTs, PMTSet::data points into it
   Digitizer digiData;
   
 
@@ -260,10 +307,29 @@ private:
   // Returns nullptr if not found
   double* getDataForPmt(int pmt) const;
 
+  // Finds the largest num_points and the waveform length from the leaves
+  // of the tree, and grows the buffers to fit them
+  // Returns false if the PMT branches have different waveform lengths
+  bool sizeBuffers();
+
+  // Makes the buffers big enough for points waveforms of length samples,
+  // and points the branches at the new buffers
+  void growBuffers(unsigned long long points, unsigned long long length);
+
   // Sets the pointers in the tree to the newly opened tree
   // Returns false on failure, true on success
   bool setDataPointers();
 
+  // Points the zero suppressed branches of channel branchName at pmt
+  // Returns false if the file does not have them
+  bool setZeroSuppressedPointers(PMTSet& pmt, const std::string& branchName);
+
+  // Makes the packed buffers big enough for entry, before it is read
+  void reserveZeroSuppressed(unsigned long long entry);
+
+  // Unpacks the zero suppressed waveforms of the entry just read
+  void decodeZeroSuppressed();
+
   // Sets all branch pointers to nullptr
   // Returns false on failure, true on success
   bool unsetDataPointers();
@@ -317,6 +383,11 @@ namespace Exceptions {
     DataPointerError() : runtime_error("Error while setting data pointers.") {}
   };
 
+  class ZeroSuppressedDataError : public std::runtime_error {
+  public:
+    ZeroSuppressedDataError() : runtime_error("Corrupt zero suppressed waveform.") {}
+  };
+
   class CSVFileError : public std::runtime_error {
   public:
     CSVFileError() : runtime_error("Error while trying to open CSV file.") {}
@@ -220,19 +220,19 @@ int main( int argc, char* argv[] ) {
             std::cout << "Channel: " << chan << " Number of Pulses: " << wf[chan]->numPulses << std::endl;
 
             std::vector<Pulse> sameChannel = {};
-            for(int k = 0; k < wf[chan]->numPulses; k++){ // loop over each pulse
+            for(const PulseInfo& p : wf[chan]->pulses()){ // loop over each pulse
 
                 // pulse height
-                double pulse_height = wf[chan]->pulseCharges[k]*1000.0;
+                double pulse_height = p.charge*1000.0;
 
                 // pulse charge
                 double pulse_charge = pulse_height/7.7;
 
                 // pulse CFDtime
-                double pulse_CFDtime = wf[chan]->pulseTimesCFD[k];
+                double pulse_CFDtime = p.timeCFD;
 
                 // pulse time
-                double pulse_time = wf[chan]->pulseTimes[k];
+                double pulse_time = p.time;
 
                 //pulse fittedTime
                 double pulse_fittedtime = wf[chan]->mean;
@@ -128,12 +128,12 @@ int main( int argc, char* argv[] ) {
 		for(int j : myChannels){ // loop over channels
 			tt[j]->GetEvent(i);
 			
-			for(int k = 0; k < wf[j]->numPulses; k++){ // loop over each pulse
+			for(const PulseInfo& p : wf[j]->pulses()){ // loop over each pulse
 				
 				std::cout << "Pulses found: " << wf[j]->numPulses << " Event: " << i << " Channel: " << j << std::endl;
 				
 				// pulse height
-				double pulse_height = wf[j]->pulseCharges[k]*1000.0;
+				double pulse_height = p.charge*1000.0;
 				h1[j]->Fill(pulse_height);
 				
 				// pulse charge in photoelectron assume 7.7mV
@@ -141,7 +141,7 @@ int main( int argc, char* argv[] ) {
 				h2[j]->Fill(pulse_charge);
 				
 				// pulse time
-				double pulse_time = wf[j]->pulseTimesCFD[k];
+				double pulse_time = p.timeCFD;
 				
 				// Time Calibration (not yet completed)
 				/*
@@ -211,19 +211,19 @@ int main( int argc, char* argv[] ) {
 			
 			std::vector<Pulse> sameChannel = {};
 			
-			for(int k = 0; k < wf[j]->numPulses; k++){ // loop over each pulse
+			for(const PulseInfo& p : wf[j]->pulses()){ // loop over each pulse
 				
 				// pulse height
-				double pulse_height = wf[j]->pulseCharges[k]*1000.0;
+				double pulse_height = p.charge*1000.0;
 				
 				// pulse charge
 				double pulse_charge = pulse_height/7.7;
 				
 				// pulse CFDtime
-				double pulse_CFDtime = wf[j]->pulseTimesCFD[k];
+				double pulse_CFDtime = p.timeCFD;
 				
 				// pulse time
-				double pulse_time = wf[j]->pulseTimes[k];
+				double pulse_time = p.time;
 				
 				//pulse fittedTime
 				double pulse_fittedtime = wf[j]->mean;
@@ -1,5 +1,7 @@
 #include "WaveformFitResult.hpp"
+#include "WaveformSnapshot.hpp"
 #include "ScanPoint.hpp"
+#include "FastMath.hpp"
 #include "TFile.h"
 #include "TCanvas.h"
 #include "TH1D.h"
@@ -20,8 +22,8 @@ double funcEMG(double *x, double *p){
   // p[3]: exponential decay constant
   // p[4]: baseline
   
- double y = p[4] + (p[0]/0.3)*(p[3]/2.)*exp((p[1]+p[2]*p[2]/p[3]/2.-x[0])/(p[3]))*
-   TMath::Erfc((p[1]+p[2]*p[2]/p[3] -x[0])/sqrt(2.)/p[2]) *
+  static thread_local FastMath::EMG emg;
+ double y = p[4] + (p[0]/0.3)*emg( x[0], p[1], p[2], p[3] ) *
    TMath::Sin(p[5] * (x[0]-p[6]));
 
  return y ;
@@ -36,8 +38,11 @@ double bessel(double *x, double *p){
     y = p[3];
   }else{
     //y = p[3] + p[2] * (TMath::Sin(xx) / (xx * xx) - TMath::Cos(xx)/xx); 
-    y = p[3] + p[2] / pow(xx,p[4]) *
-      ((15/(xx*xx*xx) - 6/xx) * TMath::Sin(xx) / (xx) - ((15/(xx*xx) -1) *TMath::Cos(xx)/xx) ); 
+    double inv = 1./xx, inv2 = inv*inv;
+    double s, c;
+    FastMath::SinCos( xx, s, c );
+    y = p[3] + p[2] * FastMath::Pow( xx, -p[4] ) * inv *
+      ( (15*inv2 - 6)*inv*s - (15*inv2 - 1)*c );
   }
 
   return y ;
@@ -411,9 +416,8 @@ int main( int argc, char* argv[] ) {
 
   TCanvas *c4 = new TCanvas("C4");
 
-  char name[100];
-  sprintf(name,"PMT1_NoWaveforms/hwf_%i;1",103);
-  TH1 *ch0 = (TH1*) fin->Get(name);
+  TTree *snapshots1 = (TTree*) fin->Get("snapshots1");
+  TH1 *ch0 = WaveformSnapshot::GetWaveform(snapshots1, 103, "hwf_103");
 
   if(ch0){
     ch0->Draw();
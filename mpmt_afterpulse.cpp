@@ -340,28 +340,28 @@ void analysis(TTree* tt, WaveformFitResult* wf, const Double_t peHeight, const D
 
 
       // Data for the histograms.
-      for(int i = 0; i < wf->numPulses; i++){
+      for ( const PulseInfo& p : wf->pulses() ){
 
         // Overall pulse distributions
-        vecT.push_back(wf->pulseTimes[i]);
-        vecQ.push_back(wf->pulseCharges[i]*1000./peHeight);
+        vecT.push_back(p.time);
+        vecQ.push_back(p.charge*1000./peHeight);
         vecA.push_back(wf->pulseArea);  
 
         // Collect pulse time with laser time at zero.
-        if (wf->pulseTimes[i]-afpTimeThreshold1 > 0) {
-          vecDeltaT.push_back(wf->pulseTimes[i]-afpTimeThreshold1);
+        if (p.time-afpTimeThreshold1 > 0) {
+          vecDeltaT.push_back(p.time-afpTimeThreshold1);
         }
         
         // check if it is laser pulse. 
-        if (wf->pulseTimes[i]>=afpTimeThreshold1 && wf->pulseTimes[i]<afpTimeThreshold2){
+        if (p.time>=afpTimeThreshold1 && p.time<afpTimeThreshold2){
           vecAlsr.push_back(wf->pulseArea);
-          vecQlsr.push_back(wf->pulseCharges[i]*1000.0/peHeight);
-	  histPE->Fill(wf->pulseCharges[i]*1000.0/peHeight);
+          vecQlsr.push_back(p.charge*1000.0/peHeight);
+	  histPE->Fill(p.charge*1000.0/peHeight);
         
         // otherwise it is afterpulse
-        } else if (wf->pulseTimes[i]>=afpTimeThreshold2){
+        } else if (p.time>=afpTimeThreshold2){
           vecAafp.push_back(wf->pulseArea);
-          vecQafp.push_back(wf->pulseCharges[i]*1000.0/peHeight);
+          vecQafp.push_back(p.charge*1000.0/peHeight);
         }
       }
     }             
@@ -433,7 +433,7 @@ void dcr_estimate(TTree* tt, WaveformFitResult* wf, const Double_t early_thresho
     if (wf->numPulses > 0) {
     
       Int_t darkPulse_counter = 0;
-      while (wf->pulseTimes[darkPulse_counter] >= 20. && wf->pulseTimes[darkPulse_counter] < afpTimeThreshold1) {
+      while (darkPulse_counter < wf->numPulses && wf->pulseTimes[darkPulse_counter] >= 20. && wf->pulseTimes[darkPulse_counter] < afpTimeThreshold1) {
         darkPulse_counter++;
       }
 
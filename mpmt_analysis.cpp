@@ -34,6 +34,7 @@
 #include "WaveformFitResult.hpp"
 #include "ScanPoint.hpp"
 #include "PTFAnalysis.hpp"
+#include "PerfStats.hpp"
 #include "Utilities.hpp"
 #include <string>
 #include <iostream>
@@ -65,6 +66,8 @@ int main(int argc, char** argv) {
   if (argc != 4) {
     cerr << "give path to file to read" << endl;
     cerr << "usage: ptf_analysis filename.root run_number config_file" << endl;
+    cerr << "   or: mpmt_analysis -l runlist.txt config_file" << endl;
+    cerr << "where runlist.txt has one \"filename.root run_number\" per line" << endl;
     return 0;
   }
 
@@ -77,10 +80,10 @@ int main(int argc, char** argv) {
   // Set style
   utils.set_style();
 
-  // Opening the output root file
-  string outname = string("mpmt_Analysis_run0") + argv[2] + ".root";
-  TFile * outFile = new TFile(outname.c_str(), "NEW");
-  //TFile * outFile = new TFile("ptf_analysis.root", "NEW");
+  // Runs to process, each gets its own output file
+  vector<RunFile> runs;
+  if ( string(argv[1]) == "-l" ) runs = utils.read_run_list( argv[2] );
+  else runs.push_back( RunFile{ argv[1], argv[2] } );
 
   std::cout << "Config file: " << string(argv[3]) << std::endl;
   Configuration config;
@@ -113,30 +116,54 @@ int main(int argc, char** argv) {
 
   }
 
+  // Wrapper buffers are shared by all of the runs
   vector<PTF::Gantry> gantries = {PTF::Gantry0, PTF::Gantry1};
-  Wrapper wrapper = Wrapper(1, 1024, activePMTs, phidgets, gantries,mPMT_DIGITIZER);
-  std::cout << "Open file: " << std::endl;
-  wrapper.openFile( string(argv[1]), "scan_tree");
-  cerr << "Num entries: " << wrapper.getNumEntries() << endl << endl;
-  cout << "Points ready " << endl;
+  Wrapper wrapper(activePMTs, phidgets, gantries,mPMT_DIGITIZER);
+  vector<string> fileNames;
+  for ( const RunFile& rf : runs ) fileNames.push_back( rf.filename );
+  wrapper.setRunList( fileNames, "scan_tree" );
+
+  for ( unsigned irun = 0; irun < runs.size(); ++irun ) {
+    cout << "Run " << runs[irun].run << " (" << irun+1 << " / " << runs.size() << "): " << runs[irun].filename << endl;
+
+    // Opening the output root file
+    string outname = string("mpmt_Analysis_run0") + runs[irun].run + ".root";
+    TFile * outFile = new TFile(outname.c_str(), "NEW");
+    //TFile * outFile = new TFile("ptf_analysis.root", "NEW");
+
+    std::cout << "Open file: " << std::endl;
+    wrapper.openRun( irun );
+    cerr << "Num entries: " << wrapper.getNumEntries() << endl << endl;
+    cout << "Points ready " << endl;
   
 
-  // Open the BRB Settings tree 
-  wrapper.LoadBrbSettingsTree();
+    // Open the BRB Settings tree 
+    wrapper.LoadBrbSettingsTree();
 
   
-  for(unsigned int i = 0; i < active_channels.size(); i++){
-    PTF::PMT pmt = activePMTs[i];
-    PTFAnalysis *analysis = new PTFAnalysis( outFile, wrapper, 2.1e-3, pmt, string(argv[3]), true );
-    if(i == 0) analysis->write_scanpoints();
-
+    vector<PTFAnalysis*> analyses;
+    for(unsigned int i = 0; i < active_channels.size(); i++){
+      PTF::PMT pmt = activePMTs[i];
+      // the first channel writes the scanpoints tree, and decides the early stop for all of them
+      PTFAnalysis *analysis = new PTFAnalysis( outFile, wrapper, 2.1e-3, pmt, string(argv[3]), true,
+                                               analyses.empty() ? nullptr : analyses[0] );
+      if(i == 0) analysis->write_scanpoints();
+      analyses.push_back( analysis );
+    }
+
+    // Timers and counters of the analysis stages (only with make PERF=1)
+    outFile->cd();
+    PERF_REPORT();
+
+    outFile->Write();
+    outFile->Close();
+    delete outFile;
+
+    for ( PTFAnalysis* analysis : analyses ) delete analysis;
   }
-
-  outFile->Write();
-  outFile->Close();
+  wrapper.closeFile();
     
   cout << "Done" << endl; 
 
   return 0;
 }
-
@@ -0,0 +1,169 @@
+/// Export of a scan file in the zero suppressed format
+///
+/// Copies the scan_tree of the input, with each waveform branch
+/// V1730_wave<ch>[num_points][len] replaced by (see ZeroSuppression.hpp):
+///   zs_V1730_wave<ch>_nbytes                       packed bytes in this entry
+///   zs_V1730_wave<ch>[zs_V1730_wave<ch>_nbytes]    kept samples of all the waveforms
+///   zs_V1730_wave<ch>_baseline[num_points]         baseline of each waveform (ADC counts)
+///   zs_V1730_wave<ch>_rms[num_points]              baseline rms of each waveform
+///   zs_length                                      samples per waveform
+/// All other branches, and the settings_tree, are copied as they are.  The
+/// Wrapper reads the output like the original, with the suppressed samples at
+/// the baseline, so it can be given to mpmt_analysis in place of the input.
+///
+/// The settings are the zs_ keys of the config file (see mpmt.config.dat).
+/// The fraction of suppressed samples is printed for each channel.
+///
+/// Usage: mpmt_zs_export.app input.root output.root config_file
+
+#include "wrapper.hpp"
+#include "Configuration.hpp"
+#include "ZeroSuppression.hpp"
+
+#include "TFile.h"
+#include "TTree.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+
+using namespace std;
+
+int main( int argc, char** argv ) {
+  if ( argc != 4 ) {
+    cerr << "usage: mpmt_zs_export.app input.root output.root config_file" << endl;
+    return 0;
+  }
+
+  Configuration config;
+  if ( !config.Load( argv[3] ) ) exit( EXIT_FAILURE );
+  ZeroSuppressionParams par;
+  par.Load( config );
+
+  TFile * inFile = new TFile( argv[1], "READ" );
+  if ( !inFile->IsOpen() ) {
+    cout << "Could not open input file " << argv[1] << endl;
+    exit( EXIT_FAILURE );
+  }
+  TTree * inTree = nullptr;
+  inFile->GetObject( "scan_tree", inTree );
+  if ( inTree == nullptr ) {
+    cout << "No scan_tree in " << argv[1] << endl;
+    exit( EXIT_FAILURE );
+  }
+
+  // waveform branches of the input, all with the same length
+  unsigned long long num_points = 0;
+  unsigned long long max_points = (unsigned long long) inTree->GetMaximum( "num_points" );
+  int length = 0;
+  vector< string > names;
+  vector< int > channels;
+  char branchName[64];
+  for ( int ch = 0; ch < 64; ++ch ) {
+    snprintf( branchName, 64, PMT_CHANNEL_FORMAT, ch );
+    TBranch* br = inTree->GetBranch( branchName );
+    TLeaf* leaf = br ? br->GetLeaf( branchName ) : nullptr;
+    if ( leaf == nullptr ) continue;
+    int len = leaf->GetLenStatic();
+    if ( length != 0 && len != length ) {
+      cout << "Waveform length " << len << " of " << branchName << " differs from " << length << endl;
+      exit( EXIT_FAILURE );
+    }
+    length = len;
+    names.push_back( branchName );
+    channels.push_back( ch );
+  }
+  if ( names.empty() || max_points == 0 ) {
+    cout << "No waveforms in " << argv[1] << endl;
+    exit( EXIT_FAILURE );
+  }
+  cout << "Zero suppressing " << names.size() << " channels of up to " << max_points
+       << " waveforms of " << length << " samples" << endl;
+  cout << "threshold " << par.threshold << " counts or " << par.nsigma << " sigma, keeping "
+       << par.pre << " samples before and " << par.post << " after" << endl;
+
+  // addresses are set before cloning, so the copy shares them
+  unsigned nch = names.size();
+  vector< vector< double > > wavedata( nch, vector< double >( max_points * length ) );
+  inTree->SetBranchAddress( "num_points", &num_points );
+  for ( unsigned ich = 0; ich < nch; ++ich ) {
+    inTree->SetBranchAddress( names[ich].c_str(), &wavedata[ich][0] );
+    inTree->SetBranchStatus( names[ich].c_str(), 0 );
+  }
+
+  TFile * outFile = new TFile( argv[2], "NEW" );
+  if ( !outFile->IsOpen() ) {
+    cout << "Could not create output file " << argv[2] << endl;
+    exit( EXIT_FAILURE );
+  }
+  TTree * outTree = inTree->CloneTree( 0 );
+  for ( unsigned ich = 0; ich < nch; ++ich ) inTree->SetBranchStatus( names[ich].c_str(), 1 );
+
+  int zs_length = length;
+  outTree->Branch( "zs_length", &zs_length, "zs_length/I" );
+  vector< ZeroSuppressor > suppressors( nch, ZeroSuppressor( par ) );
+  vector< vector< unsigned char > > packed( nch, vector< unsigned char >( 1 ) );
+  vector< int > nbytes( nch );
+  vector< vector< float > > baseline( nch, vector< float >( max_points ) );
+  vector< vector< float > > rms( nch, vector< float >( max_points ) );
+  vector< TBranch* > packedBranches( nch );
+  for ( unsigned ich = 0; ich < nch; ++ich ) {
+    string zs = ZeroSuppressedBranch( names[ich] );
+    string zsn = ZeroSuppressedBranch( names[ich], "_nbytes" );
+    string zsb = ZeroSuppressedBranch( names[ich], "_baseline" );
+    string zsr = ZeroSuppressedBranch( names[ich], "_rms" );
+    outTree->Branch( zsn.c_str(), &nbytes[ich], ( zsn + "/I" ).c_str() );
+    packedBranches[ich] = outTree->Branch( zs.c_str(), &packed[ich][0], ( zs + "[" + zsn + "]/b" ).c_str() );
+    outTree->Branch( zsb.c_str(), &baseline[ich][0], ( zsb + "[num_points]/F" ).c_str() );
+    outTree->Branch( zsr.c_str(), &rms[ich][0], ( zsr + "[num_points]/F" ).c_str() );
+  }
+
+  unsigned long long nentries = inTree->GetEntries();
+  for ( unsigned long long i = 0; i < nentries; ++i ) {
+    if ( i % 10 == 0 ) {
+      cout << "Entry " << i << " / " << nentries << endl;
+    }
+    inTree->GetEntry( i );
+    for ( unsigned ich = 0; ich < nch; ++ich ) {
+      packed[ich].clear();
+      for ( unsigned long long j = 0; j < num_points; ++j ) {
+        if ( !suppressors[ich].Encode( &wavedata[ich][j * length], length, packed[ich],
+                                       baseline[ich][j], rms[ich][j] ) ) {
+          cout << "Entry " << i << " waveform " << j << " of " << names[ich]
+               << " has samples that are not ADC counts, can not be packed losslessly" << endl;
+          exit( EXIT_FAILURE );
+        }
+      }
+      nbytes[ich] = packed[ich].size();
+      if ( packed[ich].empty() ) packed[ich].push_back( 0 );
+      packedBranches[ich]->SetAddress( &packed[ich][0] ); // the vector may have moved
+    }
+    outTree->Fill();
+  }
+
+  // BRB settings, read by BrbSettingsTree::LoadSettingsTree
+  TTree * settings = nullptr;
+  inFile->GetObject( "settings_tree", settings );
+  outFile->cd();
+  if ( settings ) settings->CloneTree( -1 );
+
+  outFile->Write();
+
+  unsigned long long in = 0, kept = 0;
+  for ( unsigned ich = 0; ich < nch; ++ich ) {
+    cout << names[ich] << ": " << suppressors[ich].waveforms() << " waveforms, "
+         << 100. * suppressors[ich].suppressed_fraction() << "% of samples suppressed" << endl;
+    in += suppressors[ich].samples_in();
+    kept += suppressors[ich].samples_kept();
+  }
+  cout << "All channels: " << ( in > 0 ? 100. * ( 1. - double( kept ) / in ) : 0. )
+       << "% of samples suppressed, file size " << inFile->GetSize() << " -> "
+       << outFile->GetSize() << " bytes" << endl;
+
+  outFile->Close();
+  inFile->Close();
+  cout << "Done" << endl;
+
+  return 0;
+}
@@ -2,6 +2,7 @@
 // 2022-05-27
 #include "WaveformFitResult.hpp"
 #include "ScanPoint.hpp"
+#include "ScanPointIndex.hpp"
 #include "TCanvas.h"
 #include "TFile.h"
 #include "TF1.h"
@@ -101,12 +102,33 @@ int main( int argc, char* argv[] )
   int num_ch = 2; //number of active channels
   int f_ch = 2; //first channel
   
-  int num_bins_x = static_cast<int>(x_scan_dist/step_size)+1 ;
-  int num_bins_y = static_cast<int>(y_scan_dist/step_size)+1 ;
-  float x_low = xstart - step_size/2;
-  float x_high = xstart + x_scan_dist + step_size/2;
-  float y_low = ystart - step_size/2;;
-  float y_high = ystart + y_scan_dist + step_size/2;
+  //Read ROOT file;
+  if ( argc != 2 ){
+    std::cerr<<"Usage: ptf_ttree_analysis.app ptf_analysis.root\n";
+    exit(0); }
+  TFile * fin = new TFile( argv[1], "read" );
+
+  //Scan grid: inferred from the scan points of the file when it has them and
+  //they are on a regular grid, the parameters above otherwise
+  /*---------------------------------------------------------------------------------*/
+  ScanAxis xaxis = ScanAxis::Regular( xstart, step_size, static_cast<int>(x_scan_dist/step_size)+1 );
+  ScanAxis yaxis = ScanAxis::Regular( ystart, step_size, static_cast<int>(y_scan_dist/step_size)+1 );
+  if ( fin->Get("scanpoints") ){
+    ScanPointIndex scanindex( ReadScanPoints( fin ) );
+    if ( scanindex.xaxis().regular && scanindex.yaxis().regular ){
+      xaxis = scanindex.xaxis();
+      yaxis = scanindex.yaxis();
+      std::cout << "Scan grid from the scan points: x from " << xaxis.origin << " in " << xaxis.size() << " steps of " << xaxis.step
+		<< ", y from " << yaxis.origin << " in " << yaxis.size() << " steps of " << yaxis.step << std::endl;
+    }
+  }
+
+  int num_bins_x = xaxis.size();
+  int num_bins_y = yaxis.size();
+  float x_low = xaxis.edges.front();
+  float x_high = xaxis.edges.back();
+  float y_low = yaxis.edges.front();
+  float y_high = yaxis.edges.back();
 
   std::cout << "There are approx" << num_bins_x * num_bins_y << "scan points" << std::endl;
   std::cout << "We expect" << dwelltime * num_bins_x * num_bins_y << "events in total" << std::endl;
@@ -115,8 +137,8 @@ int main( int argc, char* argv[] )
   /*---------------------------------------------------------------------------------*/
   float POI_y = 0.385; //scan point of interest y
   float POI_x = 0.37; //scan point of interest x
-  int BOI_x = static_cast<int>((POI_x-xstart)/step_size);
-  int BOI_y = static_cast<int>((POI_y-ystart)/step_size);
+  int BOI_x = xaxis.FindBin(POI_x);
+  int BOI_y = yaxis.FindBin(POI_y);
 
   //Initialize histograms and bins of combined channels
   /*---------------------------------------------------------------------------------*/
@@ -132,11 +154,6 @@ int main( int argc, char* argv[] )
   TH2F *h_mph_bin[num_ch];
 
   
-  //Read ROOT file;
-  if ( argc != 2 ){
-    std::cerr<<"Usage: ptf_ttree_analysis.app ptf_analysis.root\n";
-    exit(0); }
-  TFile * fin = new TFile( argv[1], "read" );
   TTree * tt0;    
   WaveformFitResult * wf0;
  
@@ -200,43 +217,29 @@ int main( int argc, char* argv[] )
 	  tt0->GetEvent(i);
 	  //std::cout << "Number of pulses found: " << wf0->numPulses << std::endl;
 
-	  for(int ypoint = 0; ypoint < num_bins_y ; ypoint++)
-	    {//START YLOOP
-
-	      float ycenter = step_size*ypoint + ystart;
-	      float y_l = ycenter - step_size/2.0;
-	      float y_r = ycenter + step_size/2.0;
-
-	      for(int xpoint = 0; xpoint < num_bins_x ; xpoint++)
-		{//START XLOOP
-		  float xcenter = step_size*xpoint + xstart;
-		  float x_l = xcenter - step_size/2.0;
-		  float x_r = xcenter + step_size/2.0;
-
-		  if((wf0->x>x_l && wf0->x < x_r) and (wf0->y >y_l && wf0->y < y_r))
-		    {//FILTER XY COORDS
+	  //Scan point bin of the waveform, straight from the grid
+	  int xpoint = xaxis.FindBin(wf0->x);
+	  int ypoint = yaxis.FindBin(wf0->y);
+	  if(xpoint >= 0 && ypoint >= 0)
+	    {//FILTER XY COORDS
 
-		      events_bin[xpoint][ypoint] += 1;
-		      pulse_bin[xpoint][ypoint] += wf0->numPulses;
+	      events_bin[xpoint][ypoint] += 1;
+	      pulse_bin[xpoint][ypoint] += wf0->numPulses;
 
-		      for(int k = 0; k < wf0->numPulses; k++ )
-			{//START PULSE LOOP
+	      for(const PulseInfo& p : wf0->pulses())
+		{//START PULSE LOOP
 
-			  if(wf0->pulseTimes[k] > 2300 and wf0->pulseTimes[k] < 2420 and wf0->pulseCharges[k]*1000.0 > 2.0)
-			    {//FILTER PULSE TIME
+		  if(p.time > 2300 and p.time < 2420 and p.charge*1000.0 > 2.0)
+		    {//FILTER PULSE TIME
 		      
-			      h[xpoint][ypoint]->Fill(wf0->pulseCharges[k]*1000.0);
-			      h_scan_pt->SetBinContent(xpoint+1,ypoint+1,wf0->scanpt);
+		      h[xpoint][ypoint]->Fill(p.charge*1000.0);
+		      h_scan_pt->SetBinContent(xpoint+1,ypoint+1,wf0->scanpt);
 			  			 
-			    }//DONE FILTER PULSE TIME
+		    }//DONE FILTER PULSE TIME
 
-			}//DONE PULSE LOOP
+		}//DONE PULSE LOOP
 		  
-		    }//DONE FILTER XY COORDS
-		 
-		}//DONE XLOOP
-		    
-	    }//DONE YLOOP
+	    }//DONE FILTER XY COORDS
 
 	}//DONE WAVEFORM LOOP
   
@@ -286,7 +289,7 @@ int main( int argc, char* argv[] )
       TCanvas *c0 = new TCanvas("C0");
       char *title0 = Form("pulse height distribution channel %d (%f,%f) bin (%d,%d)",ch_name,POI_x,POI_y,BOI_x,BOI_y);
       char *name0 = Form("pulse_height_distribution%d.png",ch_name);
-      plot1D(c0,plot_h,h[BOI_x][BOI_y],title0, name0);
+      if(BOI_x >= 0 && BOI_y >= 0) plot1D(c0,plot_h,h[BOI_x][BOI_y],title0, name0);
       
       //Style;
       gStyle->SetPalette(1);
@@ -1,5 +1,6 @@
 #include "WaveformFitResult.hpp"
 #include "ScanPoint.hpp"
+#include "TimeSeriesAggregator.hpp"
 #include "TFile.h"
 #include "TStyle.h"
 #include "TCanvas.h"
@@ -29,6 +30,8 @@
 // It outputs a plot of average pulse
 // height in PE vs time, for a specified
 // interval of time (eg every minute)
+// The per-period summaries are built in a
+// single pass with TimeSeriesAggregator
 
 
 
@@ -56,10 +59,6 @@ int main( int argc, char* argv[] ) {
     // P.E. values
     double peHeight   = 13.18; //< mV
 
-    // Gaussian fit bounds
-    double gausMin = 3;
-    double gausMax = 7;
-
     // Length of time each average data point analyzes, in minutes
     double periodLen = 1;
 
@@ -73,108 +72,51 @@ int main( int argc, char* argv[] ) {
     WaveformFitResult * wf = new WaveformFitResult;
     wf->SetBranchAddresses( tt );
 
-    // Initialize some variables/histograms
-    TH1F * hist = new TH1F("pulse_height","Pulse Height",200,0,200*0.48828125);
-    float_t lsrPulseFlt;
+    // Initialize some variables
     char filename[1024];
-    auto canvas = new TCanvas("canvas","",1200,800);
-
-
-
-    // Determine General Timestamp info
-    // Find the time of the first event
-    tt->GetEvent(0);
-    int UStaTime = wf->evt_timestamp;
-
-    // Find the time of the final event
-    tt->GetEvent((tt->GetEntries())-1);
-    int UEndTime = wf->evt_timestamp;
-
-    // Determine the total number of minutes the root file ran for, in minutes.
-    // Partial minutes at the end of the run are NOT included (i.e. a 90s run would have totMins = 1)
-    int totMins = int(floor((UEndTime - UStaTime)/60));
-
-    // Determine the total number of (full) time periods the root file ran for, in minutes
-    int totPeriods = int(floor(totMins / periodLen));
 
-    
-    
-    //Define the arrays for storing mean pulse height
-    double means[totPeriods];
-    double meanErrs[totPeriods];
-    double mins[totPeriods];
-    double minErrs[totPeriods];
-    for(int i=0; i<totPeriods; i++){
-        mins[i] = periodLen*i;
-        minErrs[i] = 0;    // The minute-error is always 0 because we don't want horizontal error bars later
+    // Accumulate the laser pulse heights per time-period in one pass over the tree.
+    // Windows are keyed on evt_timestamp, so entries do not need to be time ordered.
+    // Windows start at the earliest timestamp rather than the first one read,
+    // so that events out of time order do not land before the origin
+    TimeSeriesAggregator agg( periodLen*60. );
+    agg.set_origin( tt->GetMinimum( "evt_timestamp" ) );
+    double lastTime = tt->GetMaximum( "evt_timestamp" );
+    agg.set_peak_binning( 200, 0., 20. );
+    agg.fill_from_tree( tt, wf, [&]( const WaveformFitResult& w, std::vector<double>& vals ){
+        // If there are pulses on waveform
+        if ( w.numPulses == 0 ) return;
+        // Loop over each pulse
+        for ( int i = 0; i < w.numPulses; i++ ){
+            // check if it is laser pulse (and not an afterpulse)
+            if ( w.pulseTimes[i] >= afpTimeThreshold1 && w.pulseTimes[i] < afpTimeThreshold2 ){
+                // Find the pulse height
+                vals.push_back( w.pulseCharges[i]*1000.0/peHeight );
+            }
+        }
+    } );
+
+    // Keep only the full time-periods.  The last window is partial if the run
+    // ended before it did.
+    std::vector< TimeWindowStats > windows = agg.windows();
+    if ( !windows.empty() && windows.back().tstop() > lastTime ) windows.pop_back();
+    if ( windows.empty() ){
+        std::cerr << "No complete time-period of " << periodLen << " min in " << argv[3] << std::endl;
+        return 0;
     }
 
-
-    
-    // Create a Histogram for each minute of data
-    // Declare some variables
-    int endLoop;
-    int k = 0; 
-    // Note: we set k = 0 BEFORE the looping because we don't want to reset it to 0 once we start counting
-    // events until we're done running the program to avoid double counting
-    int currentTime;
-
-    // Loop over each time-period
-    for(int period = 0; period < totPeriods; period++){
-        // Reset a few things before making a new minute-hist
-        hist->Reset();
-        endLoop = 0;
-
-        // Loop over each waveform in that time-period
-        while(endLoop == 0){
-            // Get event information from tree.
-	    tt->GetEvent(k);
-
-	    // Check if the event is actually in the next time-period
-	    if((wf->evt_timestamp - UStaTime) >= ((period + 1)*periodLen*60)){
-	      endLoop = 1;
-	      k -= 1;    // This is so that this event will be included in the next period
-	    } 
-	    else {
-	        // If there are pulses on waveform
-	        if(wf->numPulses > 0){
-
-	            if ((wf->pulseTimes[0]>=afpTimeThreshold1) && (wf->pulseTimes[0]<afpTimeThreshold2)) {
-	                // Find the pulse height
-		        lsrPulseFlt = wf->pulseCharges[0]*1000.0/peHeight;
-		    }
-
-		    // Loop over each pulse
-		    for(int i = 0; i < wf->numPulses; i++){
-		        // check if it is laser pulse (and not an afterpulse) 
-		        if (wf->pulseTimes[i]>=afpTimeThreshold1 && wf->pulseTimes[i]<afpTimeThreshold2){
-		            hist->Fill(lsrPulseFlt);
-		        }
-		    }
-	        }
-	        
-	        k++;
-	    }
-	}
-	
-	// Format the histogram
-	hist->Draw();
-	hist->SetTitle("Laser Intensity");
-	hist->GetXaxis()->SetTitle("Pulse height (PE)");
-	hist->GetXaxis()->SetRangeUser(0, 20);
-	hist->GetYaxis()->SetTitle("Number of events");
-	TFitResultPtr fitRes = hist->Fit("gaus","QS","",gausMin,gausMax);
-	gStyle->SetOptFit(11);
-	// Un-comment the following 2 lines to save each avg-pulse-height histogram
-	//sprintf(filename, "../images/%s-%s-pulse-height-hist-minute-%d.png", argv[2], argv[3], min);
-	//canvas->SaveAs(filename);
-
-	// Store the fit results
-	Double_t mean = fitRes->Parameter(1);
-	means[period] = mean;
-	Double_t meanErr = fitRes->ParError(1);
-	meanErrs[period] = meanErr;
-	//std::cout << "Mean: "  << mean << std::endl;
+    //Define the arrays for storing mean pulse height
+    std::vector< double > means, meanErrs, mins, minErrs;
+    for ( unsigned period = 0; period < windows.size(); period++ ){
+        const TimeWindowStats& w = windows[ period ];
+        mins.push_back( ( w.tstart() - agg.origin() ) / 60. );
+        minErrs.push_back( 0 );    // The minute-error is always 0 because we don't want horizontal error bars later
+        // Mean of the pulse heights and its error, the peak of the window
+        // histogram (no gaussian fit) is printed for comparison
+        means.push_back( w.mean() );
+        meanErrs.push_back( w.mean_err() );
+        std::cout << "Period " << period << " N=" << w.nentries() << " Peak: " << w.peak()
+                  << " Mean: " << w.mean() << " Median: " << w.quantile( 1 ) << std::endl;
     }
 
 
@@ -182,7 +124,7 @@ int main( int argc, char* argv[] ) {
     // Plot the mean pulse height over time
     // Create the graph and canvas
     auto canvas2 = new TCanvas("canvas2","",1200,800);
-    TGraphErrors * timeGraph = new TGraphErrors(totPeriods,mins,means,minErrs,meanErrs);
+    TGraphErrors * timeGraph = new TGraphErrors(means.size(),&mins[0],&means[0],&minErrs[0],&meanErrs[0]);
     
     //formatting and saving
     timeGraph->SetTitle("Laser Stability over Time");
@@ -35,6 +35,7 @@
 #include "WaveformFitResult.hpp"
 #include "ScanPoint.hpp"
 #include "PTFAnalysis.hpp"
+#include "PerfStats.hpp"
 #include "PTFQEAnalysis.hpp"
 #include "Utilities.hpp"
 #include <string>
@@ -65,6 +66,8 @@ int main(int argc, char** argv) {
   if (argc != 4) {
     cerr << "give path to file to read" << endl;
     cerr << "usage: ptf_analysis filename.root run_number config_file" << endl;
+    cerr << "   or: ptf_analysis -l runlist.txt config_file" << endl;
+    cerr << "where runlist.txt has one \"filename.root run_number\" per line" << endl;
     return 0;
   }
 
@@ -74,53 +77,76 @@ int main(int argc, char** argv) {
   // Set style
   utils.set_style();
 
-  // Opening the output root file
-  string outname = string("ptf_analysis_run0") + argv[2] + ".root";
-  TFile * outFile = new TFile(outname.c_str(), "NEW");
-  //TFile * outFile = new TFile("ptf_analysis.root", "NEW");
+  // Runs to process, each gets its own output file
+  vector<RunFile> runs;
+  if ( string(argv[1]) == "-l" ) runs = utils.read_run_list( argv[2] );
+  else runs.push_back( RunFile{ argv[1], argv[2] } );
+  string config_file = argv[3];
 
-  // Set up PTF Wrapper
+  // Set up PTF Wrapper, buffers are shared by all of the runs
   vector<int> phidgets = {0, 1, 3};
   PTF::PMT PMT0 = {0,0,PTF::Hamamatsu_R3600_PMT}; // only looking at one PMT at a time
   PTF::PMT PMT1 = {1,5,PTF::PTF_Monitor_PMT}; // only looking at one PMT at a time
   PTF::PMT REF = {2,1,PTF::Reference}; // only looking at one PMT at a time
   vector<PTF::PMT> activePMTs = { PMT0, PMT1, REF }; // must be ordered {main,monitor}
   vector<PTF::Gantry> gantries = {PTF::Gantry0, PTF::Gantry1};
-  Wrapper wrapper = Wrapper(6000, 70, activePMTs, phidgets, gantries, PTF_CAEN_V1730);
-  wrapper.openFile( string(argv[1]), "scan_tree");
-  cerr << "Num entries: " << wrapper.getNumEntries() << endl << endl;
-
-  // Determine error bars to use on waveforms
-  // Commented to save time
-  // Approximate error bars for waveforms are sufficient for fitting
-  //ErrorBarAnalysis * errbars0 = new ErrorBarAnalysis( outFile, wrapper, PMT0 );
-  //std::cout << "Using PMT0 errorbar size " << errbars0->get_errorbar() << std::endl;
-  //ErrorBarAnalysis * errbars1 = new ErrorBarAnalysis( outFile, wrapper, PMT1 );
-  //std::cout << "Using PMT1 errorbar size " << errbars1->get_errorbar() << std::endl;
+  Wrapper wrapper(activePMTs, phidgets, gantries, PTF_CAEN_V1730);
+  vector<string> fileNames;
+  for ( const RunFile& rf : runs ) fileNames.push_back( rf.filename );
+  wrapper.setRunList( fileNames, "scan_tree" );
+
+  for ( unsigned irun = 0; irun < runs.size(); ++irun ) {
+    cout << "Run " << runs[irun].run << " (" << irun+1 << " / " << runs.size() << "): " << runs[irun].filename << endl;
+
+    // Opening the output root file
+    string outname = string("ptf_analysis_run0") + runs[irun].run + ".root";
+    TFile * outFile = new TFile(outname.c_str(), "NEW");
+    //TFile * outFile = new TFile("ptf_analysis.root", "NEW");
+
+    wrapper.openRun( irun );
+    cerr << "Num entries: " << wrapper.getNumEntries() << endl << endl;
+
+    // Determine error bars to use on waveforms
+    // Commented to save time
+    // Approximate error bars for waveforms are sufficient for fitting
+    //ErrorBarAnalysis * errbars0 = new ErrorBarAnalysis( outFile, wrapper, PMT0 );
+    //std::cout << "Using PMT0 errorbar size " << errbars0->get_errorbar() << std::endl;
+    //ErrorBarAnalysis * errbars1 = new ErrorBarAnalysis( outFile, wrapper, PMT1 );
+    //std::cout << "Using PMT1 errorbar size " << errbars1->get_errorbar() << std::endl;
   
-  // Do analysis of waveforms for each scanpoint
-  PTFAnalysis *analysis0 = new PTFAnalysis( outFile, wrapper, 4.4/*errbars0->get_errorbar()*/, PMT0, string(argv[3]), true );
-  analysis0->write_scanpoints();
+    // Do analysis of waveforms for each scanpoint
+    PTFAnalysis *analysis0 = new PTFAnalysis( outFile, wrapper, 4.4/*errbars0->get_errorbar()*/, PMT0, config_file, true );
+    analysis0->write_scanpoints();
 
-  // Switch PMT to monitor PMT
+    // Switch PMT to monitor PMT
   
-  // Do analysis of waveforms for each scanpoint
-  PTFAnalysis *analysis1 = new PTFAnalysis( outFile, wrapper, 4.4/*errbars1->get_errorbar()*/, PMT1, string(argv[3]), true );
+    // Do analysis of waveforms for each scanpoint
+    PTFAnalysis *analysis1 = new PTFAnalysis( outFile, wrapper, 4.4/*errbars1->get_errorbar()*/, PMT1, config_file, true, analysis0 );
 
-  // Switch to reference waveform
+    // Switch to reference waveform
   
-  // Do analysis of waveforms for each scanpoint
-  PTFAnalysis *analysis2 = new PTFAnalysis( outFile, wrapper, 4.4/*errbars2->get_errorbar()*/, REF, string(argv[3]), true );
+    // Do analysis of waveforms for each scanpoint
+    PTFAnalysis *analysis2 = new PTFAnalysis( outFile, wrapper, 4.4/*errbars2->get_errorbar()*/, REF, config_file, true, analysis0 );
   
-  // Do quantum efficiency analysis
-  // This is now also done in a separate analysis script (including temperature corrections)
-  //PTFQEAnalysis *qeanalysis = new PTFQEAnalysis( outFile, analysis0, analysis1 );
+    // Do quantum efficiency analysis
+    // This is now also done in a separate analysis script (including temperature corrections)
+    //PTFQEAnalysis *qeanalysis = new PTFQEAnalysis( outFile, analysis0, analysis1 );
 
-  outFile->Write();
-  outFile->Close();
+    // Timers and counters of the analysis stages (only with make PERF=1)
+    outFile->cd();
+    PERF_REPORT();
+
+    outFile->Write();
+    outFile->Close();
+    delete outFile;
+
+    delete analysis0;
+    delete analysis1;
+    delete analysis2;
+  }
+  wrapper.closeFile();
     
   cout << "Done" << endl; 
 
   return 0;
 }
-
@@ -0,0 +1,616 @@
+/// Benchmarks of the PTFAnalysis stages
+///
+/// Times each stage of the waveform analysis on a fixture, and writes the
+/// throughput of every stage to <output_prefix>.json and <output_prefix>.csv
+/// so that it can be compared across commits.
+///
+/// The fixture is a scan file, either a recorded one (bench_input in the
+/// config file) or one generated with WaveformGenerator.  mPMT fits always use
+/// generated waveforms.
+///
+/// Stages timed:
+///   wrapper_setCurrentEntry   reading scan points through the Wrapper
+///   condition_waveform        WaveformConditioner with the analysis settings
+///   condition_waveform_smooth5_decimate2
+///                             the same with baseline subtraction, smoothing
+///                             and decimation
+///   fill_waveform             conditioning and filling hwaveform
+///   pulse_location_cut        PTFAnalysis::PulseLocationCut
+///   fft_cut                   PTFAnalysis::FFTCut
+///   find_pulses               threshold pulse finding of one waveform histogram
+///   find_pulses_<name>        each registered pulse finder on a batch of generated
+///                             mPMT waveforms, with the efficiency for the laser
+///                             pulse and the rate of fake pulses
+///   charge_sum                PTFAnalysis::ChargeSum
+///   fit_pmt0_gaussian         PTFAnalysis::FitWaveform, PTF main PMT
+///   fit_pmt0_gaussian_ringing_filter
+///                             the same with the ringing removed by RingingFilter
+///                             and a 4 parameter fit
+///   fit_funcEMG               PTFAnalysis::FitWaveform, mPMT channel >= 16
+///   fit_bessel                PTFAnalysis::FitWaveform, mPMT channel < 16
+///   fit_*_roi                 the same on the region of interest of the mPMT
+///                             pulses (bench_mpmt_roi_tmin, _tmax) only
+///   eval_*                    single evaluations of the model functions
+///   eval_*_libm               the same with the libm special functions that
+///                             FastMath replaces, and the largest relative
+///                             difference between the two
+///   hough_find_circles        CircleHough::find_circles on a noisy ring
+///   ptf_analysis              full PTFAnalysis over the fixture (macro)
+///   output_write_<policy>     copying the ptfanalysis tree to a new file with
+///                             each TreeOutputPolicy (bench_output_policies),
+///                             bytes is the size of the file
+///   output_read_<policy>      reading that file back one scan point at a time
+///   output_source_read        reading the source tree, included in the writes
+///
+/// Usage: ptf_bench.app output_prefix config_file [label]
+/// The label (eg. git commit) is written with each result.
+
+#include "wrapper.hpp"
+#include "Configuration.hpp"
+#include "PTFAnalysis.hpp"
+#include "PulseFinding.hpp"
+#include "WaveformGenerator.hpp"
+#include "Hough.hpp"
+#include "pmt_response_function.hpp"
+#include "BrbSettingsTree.hxx"
+#include "TreeOutputPolicy.hpp"
+#include "RingingFilter.hpp"
+#include "WaveformConditioner.hpp"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TH1D.h"
+#include "TRandom3.h"
+#include "TMath.h"
+#include "TError.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <functional>
+#include <cmath>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+/// Access to the private stages of PTFAnalysis for timing
+class PTFAnalysisBench {
+public:
+  PTFAnalysisBench( PTFAnalysis & ana ) : fAna( ana ) { }
+  TH1D* & hwaveform() { return fAna.hwaveform; }
+  WaveformFitResult * fitresult() { return fAna.fitresult; }
+  TTree * tree() { return fAna.ptf_tree; }
+  void fill( const double* sample, double errorbar ) { fAna.FillWaveform( sample, errorbar ); }
+  WaveformConditioner* & conditioner() { return fAna.conditioner; }
+  bool pulse_location_cut() { return fAna.PulseLocationCut( 10 ); }
+  bool fft_cut() { return fAna.FFTCut(); }
+  void charge_sum() { fAna.ChargeSum(); }
+  void fit( PTF::PMT pmt ) { fAna.FitWaveform( 0, 1, pmt ); }
+  // the fit function is picked on the first fit, so forget it when changing model
+  void reset_fitfunc() { fAna.ffitfunc = nullptr; }
+  RingingFilter* & ringing_filter() { return fAna.ringing_filter; }
+  static double pmt0_gaussian( double* x, double* p ) { return PTFAnalysis::pmt0_gaussian( x, p ); }
+  static double funcEMG( double* x, double* p ) { return PTFAnalysis::funcEMG( x, p ); }
+  static double bessel( double* x, double* p ) { return PTFAnalysis::bessel( x, p ); }
+private:
+  PTFAnalysis & fAna;
+};
+
+/// The mPMT model functions as they were before FastMath, for comparison
+double funcEMG_libm( double* x, double* p ) {
+  return p[4] + (p[0]/0.3)*(p[3]/2.)*exp((p[1]+p[2]*p[2]/p[3]/2.-x[0])/(p[3]))*
+    TMath::Erfc((p[1]+p[2]*p[2]/p[3] -x[0])/sqrt(2.)/p[2]);
+}
+
+double bessel_libm( double* x, double* p ) {
+  double xx = (x[0] - p[1]) * p[0];
+  if ( x[0] < p[1] ) return p[3];
+  return p[3] + p[2] / pow(xx,p[4]) *
+    ((15/(xx*xx*xx) - 6/xx) * TMath::Sin(xx) / (xx) - ((15/(xx*xx) -1) *TMath::Cos(xx)/xx) );
+}
+
+/// Largest relative difference of f from fref over [xmin, xmax) relative
+/// to the pulse height of fref above the baseline p[ibase]
+double max_deviation( double (*f)( double*, double* ), double (*fref)( double*, double* ),
+                      double* p, int ibase, double xmin, double xmax ) {
+  double x[1], height = 0., dev = 0.;
+  for ( int k = 0; k < 10000; ++k ) {
+    x[0] = xmin + ( xmax - xmin ) * k / 10000.;
+    height = std::max( height, fabs( fref( x, p ) - p[ibase] ) );
+    dev = std::max( dev, fabs( f( x, p ) - fref( x, p ) ) );
+  }
+  return height > 0. ? dev / height : dev;
+}
+
+/// Result of one benchmark
+struct BenchResult {
+  string stage;
+  string unit;            // what one item is
+  unsigned long long items;
+  double seconds;
+  unsigned long long bytes; // size of output, for the output policy benchmarks
+  double rate() const { return seconds > 0. ? items / seconds : 0.; }
+  double ns_per_item() const { return items > 0 ? 1.e9 * seconds / items : 0.; }
+};
+
+/// Time calls of f( i ) for i = 0 .. ncalls-1.  Throughput is counted in
+/// nitems (default one item per call).
+BenchResult time_stage( const string& stage, const string& unit, unsigned long long ncalls,
+                        std::function< void( unsigned long long ) > f, unsigned long long nitems = 0 ) {
+  auto t0 = std::chrono::steady_clock::now();
+  for ( unsigned long long i = 0; i < ncalls; ++i ) f( i );
+  auto t1 = std::chrono::steady_clock::now();
+  BenchResult r{ stage, unit, nitems > 0 ? nitems : ncalls, std::chrono::duration< double >( t1 - t0 ).count() };
+  cout << "  " << stage << ": " << r.rate() << " " << unit << "/s (" << r.ns_per_item() << " ns/" << unit << ")" << endl;
+  return r;
+}
+
+/// Write a BRB settings_tree with all baselines at 1 V for the mPMT fits
+void write_settings( const string& fname ) {
+  TFile fout( fname.c_str(), "RECREATE" );
+  double baselines[20], hv[20];
+  TTree * tt = new TTree( "settings_tree", "settings_tree" );
+  tt->Branch( "CalcBaseline", baselines, "CalcBaseline[20]/D" );
+  tt->Branch( "HVsetpoints", hv, "HVsetpoints[20]/D" );
+  for ( int k = 0; k < 20; ++k ) {
+    baselines[k] = 2048.;
+    hv[k] = 0.;
+  }
+  tt->Fill();
+  fout.Write();
+  fout.Close();
+}
+
+/// Write a scan file of pmt0 (channel 0) waveforms for the Wrapper
+void write_fixture( const string& fname, int nentries, int nwaves, const WaveformGeneratorParams& par, unsigned seed ) {
+  TFile fout( fname.c_str(), "RECREATE" );
+  TTree * tt = new TTree( "scan_tree", "scan_tree" );
+  unsigned long long num_points = nwaves;
+  vector< double > wave( (size_t)nwaves * par.nsamples );
+  vector< double > evt_timestamp( nwaves );
+  GantryData gantry[2] = {};
+  double ext2_temp = 20., timestamp = 0.;
+  char name[64], leaf[128];
+  tt->Branch( "num_points", &num_points, "num_points/l" );
+  snprintf( name, 64, PMT_CHANNEL_FORMAT, 0 );
+  snprintf( leaf, 128, "%s[num_points][%d]/D", name, par.nsamples );
+  tt->Branch( name, &wave[0], leaf );
+  for ( int g = 0; g < 2; ++g ) {
+    snprintf( name, 64, GANTRY_FORMAT_X, g );     tt->Branch( name, &gantry[g].x,     (string(name)+"/D").c_str() );
+    snprintf( name, 64, GANTRY_FORMAT_Y, g );     tt->Branch( name, &gantry[g].y,     (string(name)+"/D").c_str() );
+    snprintf( name, 64, GANTRY_FORMAT_Z, g );     tt->Branch( name, &gantry[g].z,     (string(name)+"/D").c_str() );
+    snprintf( name, 64, GANTRY_FORMAT_THETA, g ); tt->Branch( name, &gantry[g].theta, (string(name)+"/D").c_str() );
+    snprintf( name, 64, GANTRY_FORMAT_PHI, g );   tt->Branch( name, &gantry[g].phi,   (string(name)+"/D").c_str() );
+  }
+  tt->Branch( "evt_timestamp", &evt_timestamp[0], "evt_timestamp[num_points]/D" );
+  tt->Branch( "ext2_temp", &ext2_temp, "ext2_temp/D" );
+  tt->Branch( "timestamp", &timestamp, "timestamp/D" );
+
+  WaveformGenerator gen( par, seed );
+  WaveformTruth truth;
+  for ( int i = 0; i < nentries; ++i ) {
+    gantry[1].x = 0.4 + 0.01 * i;
+    gantry[1].y = 0.4;
+    timestamp = 1.6e9 + 10. * i;
+    for ( int j = 0; j < nwaves; ++j ) {
+      evt_timestamp[j] = timestamp + 10. * j / nwaves;
+      gen.generate( &wave[(size_t)j * par.nsamples], truth );
+    }
+    tt->Fill();
+  }
+  fout.Write();
+  fout.Close();
+}
+
+/// Copy the ptfanalysis tree into a new file written with the output policy
+/// and time it, then time reading the file back one scan point at a time.
+/// Scan points are visited with a stride, like analyses that jump around the
+/// scan, so consecutive reads do not share clusters.
+void bench_output_policy( const string& fname, TTree * src, const vector< ScanPoint >& scanpoints,
+                          TreeOutputPolicy policy, vector< BenchResult >& results ) {
+  string name = policy.Name();
+  unsigned long long nentries = src->GetEntries();
+
+  WaveformFitResult * wf = new WaveformFitResult();
+  wf->SetBranchAddresses( src );
+  results.push_back( time_stage( "output_write_" + name, "waveform", 1, [&]( unsigned long long ) {
+        TFile fout( fname.c_str(), "RECREATE" );
+        policy.Apply( &fout );
+        TTree * tt = new TTree( src->GetName(), src->GetTitle() );
+        wf->MakeTTreeBranches( tt );
+        policy.Apply( tt );
+        for ( const ScanPoint& sp : scanpoints ) {
+          for ( unsigned long long e = sp.get_entry(); e < sp.get_entry() + sp.nentries(); ++e ) {
+            src->GetEntry( e );
+            tt->Fill();
+          }
+          policy.EndScanPoint( tt );
+        }
+        fout.Write();
+        fout.Close();
+      }, nentries ) );
+  delete wf;
+  src->ResetBranchAddresses();
+
+  TFile fin( fname.c_str(), "READ" );
+  results.back().bytes = fin.GetSize();
+  TTree * tt = (TTree*) fin.Get( src->GetName() );
+  WaveformFitResult * rd = new WaveformFitResult();
+  rd->SetBranchAddresses( tt );
+  unsigned nsp = scanpoints.size();
+  unsigned stride = nsp / 3 + 1;
+  auto gcd = []( unsigned a, unsigned b ) { while ( b ) { unsigned t = a % b; a = b; b = t; } return a; };
+  while ( nsp > 1 && gcd( stride, nsp ) != 1 ) ++stride;
+  results.push_back( time_stage( "output_read_" + name, "waveform", nsp, [&]( unsigned long long i ) {
+        const ScanPoint& sp = scanpoints[ ( i * stride ) % nsp ];
+        for ( unsigned long long e = sp.get_entry(); e < sp.get_entry() + sp.nentries(); ++e ) tt->GetEntry( e );
+      }, nentries ) );
+  results.back().bytes = fin.GetSize();
+  tt->ResetBranchAddresses();
+  delete rd;
+  fin.Close();
+}
+
+void write_results( const string& prefix, const string& label, const vector< BenchResult >& results ) {
+  ofstream csv( prefix + ".csv" );
+  csv << "label,stage,unit,items,seconds,rate_per_s,ns_per_item,bytes" << endl;
+  for ( const BenchResult& r : results ) {
+    csv << label << "," << r.stage << "," << r.unit << "," << r.items << ","
+        << r.seconds << "," << r.rate() << "," << r.ns_per_item() << "," << r.bytes << endl;
+  }
+
+  ofstream json( prefix + ".json" );
+  json << "{" << endl;
+  json << "  \"label\": \"" << label << "\"," << endl;
+  json << "  \"results\": [" << endl;
+  for ( unsigned i = 0; i < results.size(); ++i ) {
+    const BenchResult& r = results[i];
+    json << "    { \"stage\": \"" << r.stage << "\", \"unit\": \"" << r.unit
+         << "\", \"items\": " << r.items << ", \"seconds\": " << r.seconds
+         << ", \"rate_per_s\": " << r.rate() << ", \"ns_per_item\": " << r.ns_per_item()
+         << ", \"bytes\": " << r.bytes << " }"
+         << ( i + 1 < results.size() ? "," : "" ) << endl;
+  }
+  json << "  ]" << endl;
+  json << "}" << endl;
+}
+
+int main( int argc, char** argv ) {
+  if ( argc != 3 && argc != 4 ) {
+    cerr << "usage: ptf_bench.app output_prefix config_file [label]" << endl;
+    return 0;
+  }
+  string prefix = argv[1];
+  string config_file = argv[2];
+  string label = ( argc == 4 ) ? argv[3] : "";
+
+  Configuration config;
+  if ( !config.Load( config_file ) ) exit( EXIT_FAILURE );
+
+  string input;              // recorded fixture, generated if empty
+  int nentries = 12;         // scan points in generated fixture (2 home + 10)
+  int nwaves = 1000;         // waveforms per scan point in generated fixture
+  int nfits = 2000;          // waveforms per fit benchmark
+  int neval = 1000000;       // model function evaluations
+  int nhough = 20;           // calls of find_circles
+  int seed = 4357;
+  config.Get( "bench_input", input );
+  config.Get( "bench_entries", nentries );
+  config.Get( "bench_waveforms_per_point", nwaves );
+  config.Get( "bench_fits", nfits );
+  config.Get( "bench_evaluations", neval );
+  config.Get( "bench_hough_calls", nhough );
+  config.Get( "bench_seed", seed );
+
+  // fits print nothing useful here
+  gErrorIgnoreLevel = kWarning;
+
+  WaveformGeneratorParams ptfpar;
+  ptfpar.mu = 1.0;
+  ptfpar.Load( config, "bench_gen_" );
+  if ( input.empty() ) {
+    input = prefix + "_fixture.root";
+    cout << "Generating fixture " << input << " with " << nentries << " scan points x " << nwaves << " waveforms" << endl;
+    write_fixture( input, nentries, nwaves, ptfpar, seed );
+  }
+
+  vector< BenchResult > results;
+
+  PTF::PMT PMT0 = { 0, 0, PTF::Hamamatsu_R3600_PMT };
+  vector< PTF::PMT > activePMTs = { PMT0 };
+  vector< int > phidgets;
+  vector< PTF::Gantry > gantries = { PTF::Gantry0, PTF::Gantry1 };
+  Wrapper wrapper( activePMTs, phidgets, gantries, PTF_CAEN_V1730 );
+  wrapper.openFile( input, "scan_tree" );
+  unsigned long long nscan = wrapper.getNumEntries();
+  cout << "Fixture " << input << " has " << nscan << " scan points" << endl;
+  if ( nscan < 3 ) {
+    cout << "Need at least 3 scan points in the fixture" << endl;
+    exit( EXIT_FAILURE );
+  }
+
+  // Wrapper throughput, counted in waveforms
+  unsigned long long nall = 0, nanalysed = 0;
+  for ( unsigned long long i = 0; i < nscan; ++i ) {
+    wrapper.setCurrentEntry( i );
+    nall += wrapper.getNumSamples();
+    if ( i >= 2 ) nanalysed += wrapper.getNumSamples();
+  }
+  cout << "Micro benchmarks:" << endl;
+  results.push_back( time_stage( "wrapper_setCurrentEntry", "waveform", nscan, [&]( unsigned long long i ) {
+        wrapper.setCurrentEntry( i );
+      }, nall ) );
+
+  // Macro benchmark: whole PTFAnalysis for the main PMT
+  TFile * outFile = new TFile( ( prefix + "_ptf_analysis.root" ).c_str(), "RECREATE" );
+  cout << "Macro benchmark:" << endl;
+  PTFAnalysis * analysis = nullptr;
+  results.push_back( time_stage( "ptf_analysis", "waveform", 1, [&]( unsigned long long ) {
+        analysis = new PTFAnalysis( outFile, wrapper, 4.4, PMT0, config_file, false );
+      }, nanalysed ) );
+
+  // Copy waveforms from the fixture for the per-stage benchmarks
+  Digitizer digi = wrapper.getDigitizerSettings();
+  double scale = digi.fullScaleRange / pow( 2.0, digi.resolution );
+  int nsamples = wrapper.getSampleLength();
+  vector< vector< double > > waves;
+  for ( unsigned long long i = 2; i < nscan && (int)waves.size() < nfits; ++i ) {
+    wrapper.setCurrentEntry( i );
+    for ( unsigned long long j = 0; j < wrapper.getNumSamples() && (int)waves.size() < nfits; ++j ) {
+      double* s = wrapper.getPmtSample( PMT0.pmt, j );
+      waves.push_back( vector< double >( s, s + nsamples ) );
+    }
+  }
+  unsigned long long nw = waves.size();
+
+  PTFAnalysisBench bench( *analysis );
+  cout << "Stage benchmarks on " << nw << " waveforms:" << endl;
+  ConditionedWaveform conditioned;
+  results.push_back( time_stage( "condition_waveform", "waveform", nw, [&]( unsigned long long i ) {
+        bench.conditioner()->Process( &waves[i][0], conditioned );
+      } ) );
+  ConditioningParams smooth_params;
+  smooth_params.subtract_baseline = true;
+  smooth_params.smooth = 5;
+  smooth_params.decimate = 2;
+  WaveformConditioner smoother( smooth_params, nsamples, 1000. / digi.samplingRate, scale );
+  results.push_back( time_stage( "condition_waveform_smooth5_decimate2", "waveform", nw, [&]( unsigned long long i ) {
+        smoother.Process( &waves[i][0], conditioned );
+      } ) );
+  results.push_back( time_stage( "fill_waveform", "waveform", nw, [&]( unsigned long long i ) {
+        bench.fill( &waves[i][0], 4.4 );
+      } ) );
+  results.push_back( time_stage( "pulse_location_cut", "waveform", nw, [&]( unsigned long long i ) {
+        bench.fill( &waves[i][0], 4.4 );
+        bench.pulse_location_cut();
+      } ) );
+  results.push_back( time_stage( "fft_cut", "waveform", nw, [&]( unsigned long long i ) {
+        bench.fill( &waves[i][0], 4.4 );
+        bench.fft_cut();
+      } ) );
+  PulseFinder * threshold_finder = PulseFinderRegistry::Get()->Create( PulseFinderParams() );
+  results.push_back( time_stage( "find_pulses", "waveform", nw, [&]( unsigned long long i ) {
+        bench.fill( &waves[i][0], 4.4 );
+        find_pulses( *threshold_finder, bench.hwaveform(), bench.fitresult(), PMT0 );
+      } ) );
+  delete threshold_finder;
+  results.push_back( time_stage( "charge_sum", "waveform", nw, [&]( unsigned long long i ) {
+        bench.fill( &waves[i][0], 4.4 );
+        bench.charge_sum();
+      } ) );
+  bench.reset_fitfunc();
+  results.push_back( time_stage( "fit_pmt0_gaussian", "waveform", nw, [&]( unsigned long long i ) {
+        bench.fill( &waves[i][0], 4.4 );
+        bench.fit( PMT0 );
+      } ) );
+  RingingFilter * ptf_ringing = bench.ringing_filter();
+  RingingFilter * ringing = new RingingFilter( RingingFilterParams() );
+  bench.ringing_filter() = ringing;
+  bench.reset_fitfunc();
+  results.push_back( time_stage( "fit_pmt0_gaussian_ringing_filter", "waveform", nw, [&]( unsigned long long i ) {
+        bench.fill( &waves[i][0], 4.4 );
+        bench.fit( PMT0 );
+      } ) );
+  bench.ringing_filter() = ptf_ringing;
+  delete ringing;
+
+  // mPMT fits on generated waveforms with the mPMT binning
+  WaveformGeneratorParams mpmtpar;
+  mpmtpar.nsamples = 1024;
+  mpmtpar.sample_ns = 1000. / mPMT_DIGITIZER_SAMPLE_RATE;
+  mpmtpar.full_scale = mPMT_DIGITIZER_FULL_SCALE_RANGE;
+  mpmtpar.resolution = mPMT_DIGITIZER_RESOLUTION;
+  mpmtpar.shape = EMGPulse;
+  mpmtpar.pulse_time = 2200.;
+  mpmtpar.pulse_sigma = 9.6;
+  mpmtpar.mu = 5.0;
+  mpmtpar.Load( config, "bench_mpmt_gen_" );
+  double mpmtscale = mpmtpar.full_scale / pow( 2.0, mpmtpar.resolution );
+  WaveformGenerator mpmtgen( mpmtpar, seed + 1 );
+  vector< WaveformTruth > truths( nw );
+  vector< vector< double > > mpmtwaves( nw, vector< double >( mpmtpar.nsamples ) );
+  for ( unsigned long long i = 0; i < nw; ++i ) mpmtgen.generate( &mpmtwaves[i][0], truths[i] );
+
+  string settings_file = prefix + "_settings.root";
+  write_settings( settings_file );
+  TFile * fsettings = new TFile( settings_file.c_str(), "READ" );
+  BrbSettingsTree::Get()->LoadSettingsTree( fsettings );
+
+  TH1D * hptf = bench.hwaveform();
+  TH1D * hmpmt = new TH1D( "hbench_mpmt", "mPMT waveform; Time (ns); Voltage (V)",
+                           mpmtpar.nsamples, 0., mpmtpar.nsamples * mpmtpar.sample_ns );
+  bench.hwaveform() = hmpmt;
+  WaveformConditioner * ptfcond = bench.conditioner();
+  WaveformConditioner * mpmtcond = new WaveformConditioner( ConditioningParams(), mpmtpar.nsamples, mpmtpar.sample_ns, mpmtscale );
+  bench.conditioner() = mpmtcond;
+  PTF::PMT EMGPMT = { 1, 16, PTF::mPMT_REV0_PMT };
+  PTF::PMT BESPMT = { 1, 0, PTF::mPMT_REV0_PMT };
+  bench.reset_fitfunc();
+  results.push_back( time_stage( "fit_funcEMG", "waveform", nw, [&]( unsigned long long i ) {
+        bench.fill( &mpmtwaves[i][0], 0.001 );
+        bench.fit( EMGPMT );
+      } ) );
+  bench.reset_fitfunc();
+  results.push_back( time_stage( "fit_bessel", "waveform", nw, [&]( unsigned long long i ) {
+        bench.fill( &mpmtwaves[i][0], 0.001 );
+        bench.fit( BESPMT );
+      } ) );
+  // the same on the region of interest of the mPMT pulses only
+  ConditioningParams roi_params;
+  roi_params.roi_tmin = 1560.;
+  roi_params.roi_tmax = 2640.;
+  config.Get( "bench_mpmt_roi_tmin", roi_params.roi_tmin );
+  config.Get( "bench_mpmt_roi_tmax", roi_params.roi_tmax );
+  WaveformConditioner roicond( roi_params, mpmtpar.nsamples, mpmtpar.sample_ns, mpmtscale );
+  TH1D * hmpmt_roi = new TH1D( "hbench_mpmt_roi", "mPMT waveform; Time (ns); Voltage (V)",
+                               roicond.nsamples(), roicond.tmin(), roicond.tmax() );
+  bench.hwaveform() = hmpmt_roi;
+  bench.conditioner() = &roicond;
+  bench.reset_fitfunc();
+  results.push_back( time_stage( "fit_funcEMG_roi", "waveform", nw, [&]( unsigned long long i ) {
+        bench.fill( &mpmtwaves[i][0], 0.001 );
+        bench.fit( EMGPMT );
+      } ) );
+  bench.reset_fitfunc();
+  results.push_back( time_stage( "fit_bessel_roi", "waveform", nw, [&]( unsigned long long i ) {
+        bench.fill( &mpmtwaves[i][0], 0.001 );
+        bench.fit( BESPMT );
+      } ) );
+  bench.reset_fitfunc();
+  bench.hwaveform() = hptf;
+  bench.conditioner() = ptfcond;
+
+  // Each pulse finder on the mPMT waveforms, all in one batch
+  cout << "Pulse finder benchmarks:" << endl;
+  vector< double > mpmtvolts;
+  for ( auto& w : mpmtwaves ) {
+    mpmtcond->Process( &w[0], conditioned );
+    mpmtvolts.insert( mpmtvolts.end(), conditioned.volts.begin(), conditioned.volts.end() );
+  }
+  delete mpmtcond;
+  WaveformBatch batch;
+  batch.volts = &mpmtvolts[0];
+  batch.nwaves = nw;
+  batch.nsamples = mpmtpar.nsamples;
+  batch.sample_ns = mpmtpar.sample_ns;
+  batch.baseline = mpmtpar.baseline;
+  PulseFinderParams finder_params;
+  finder_params.Load( config, "bench_pulse_finder_" );
+  for ( const string& name : PulseFinderRegistry::Get()->Names() ) {
+    finder_params.algorithm = name;
+    PulseFinder * finder = PulseFinderRegistry::Get()->Create( finder_params );
+    vector< PulseList > found;
+    results.push_back( time_stage( "find_pulses_" + name, "waveform", 1, [&]( unsigned long long ) {
+          finder->Find( batch, found );
+        }, nw ) );
+    // efficiency for the laser pulse, and pulses that are not near any true pulse
+    double window = 3. * mpmtpar.pulse_sigma + mpmtpar.pulse_tau;
+    int nlaser = 0, nfound = 0, nfake = 0;
+    for ( unsigned long long i = 0; i < nw; ++i ) {
+      if ( truths[i].npe > 0 ) {
+        ++nlaser;
+        for ( const PulseInfo& p : found[i] ) {
+          if ( fabs( p.time - truths[i].time ) < window ) { ++nfound; break; }
+        }
+      }
+      for ( const PulseInfo& p : found[i] ) {
+        bool near = false;
+        for ( double t : truths[i].pulse_times ) near = near || fabs( p.time - t ) < window;
+        if ( !near ) ++nfake;
+      }
+    }
+    cout << "  " << name << " efficiency " << ( nlaser > 0 ? double( nfound ) / nlaser : 0. )
+         << ", fake pulses per waveform " << double( nfake ) / nw << endl;
+    delete finder;
+  }
+
+  // Model function evaluations
+  cout << "Model evaluation benchmarks:" << endl;
+  double sum = 0.;
+  double x[1];
+  double pgaus[7] = { 5e-3, 70.0, 5.2, 1.0, 1e-3, 0.25, 0.0 };
+  results.push_back( time_stage( "eval_pmt0_gaussian", "eval", neval, [&]( unsigned long long i ) {
+        x[0] = 140. * ( i % 1000 ) / 1000.;
+        sum += PTFAnalysisBench::pmt0_gaussian( x, pgaus );
+      } ) );
+  double pemg[5] = { -0.05, 2200., 9.6, 15.8, 1.0 };
+  results.push_back( time_stage( "eval_funcEMG", "eval", neval, [&]( unsigned long long i ) {
+        x[0] = 2000. + 400. * ( i % 1000 ) / 1000.;
+        sum += PTFAnalysisBench::funcEMG( x, pemg );
+      } ) );
+  results.push_back( time_stage( "eval_funcEMG_libm", "eval", neval, [&]( unsigned long long i ) {
+        x[0] = 2000. + 400. * ( i % 1000 ) / 1000.;
+        sum += funcEMG_libm( x, pemg );
+      } ) );
+  cout << "  funcEMG deviation from libm: "
+       << max_deviation( PTFAnalysisBench::funcEMG, funcEMG_libm, pemg, 4, 2000., 2400. ) << endl;
+  double pbes[5] = { 0.113, 2170., -0.05, 1.0, -0.3 };
+  results.push_back( time_stage( "eval_bessel", "eval", neval, [&]( unsigned long long i ) {
+        x[0] = 2000. + 400. * ( i % 1000 ) / 1000.;
+        sum += PTFAnalysisBench::bessel( x, pbes );
+      } ) );
+  results.push_back( time_stage( "eval_bessel_libm", "eval", neval, [&]( unsigned long long i ) {
+        x[0] = 2000. + 400. * ( i % 1000 ) / 1000.;
+        sum += bessel_libm( x, pbes );
+      } ) );
+  cout << "  bessel deviation from libm: "
+       << max_deviation( PTFAnalysisBench::bessel, bessel_libm, pbes, 3, 2175., 2400. ) << endl;
+  double presp[6] = { 1000., 100., 40., 0.3, 0.1, 0.05 };
+  results.push_back( time_stage( "eval_pmtresponse", "eval", neval, [&]( unsigned long long i ) {
+        x[0] = 500. * ( i % 1000 ) / 1000.;
+        sum += pmtresponse( x, presp );
+      } ) );
+  PMTResponsePed::set_binwid( 5.0 );
+  results.push_back( time_stage( "eval_model1", "eval", neval, [&]( unsigned long long i ) {
+        x[0] = 500. * ( i % 1000 ) / 1000.;
+        sum += model1( x, presp );
+      } ) );
+
+  // Circle finding on a ring of points with background
+  cout << "Hough benchmark:" << endl;
+  TRandom3 rand( seed + 2 );
+  vector< xypoint > ring;
+  for ( int k = 0; k < 60; ++k ) {
+    double phi = rand.Uniform( 0., 2 * TMath::Pi() );
+    double r = 30. + rand.Gaus( 0., 1.0 );
+    ring.push_back( xypoint( 20. + r * cos( phi ), -10. + r * sin( phi ) ) );
+  }
+  for ( int k = 0; k < 20; ++k ) {
+    ring.push_back( xypoint( rand.Uniform( -200., 200. ), rand.Uniform( -200., 200. ) ) );
+  }
+  outFile->cd();
+  CircleHough hough;
+  results.push_back( time_stage( "hough_find_circles", "call", nhough, [&]( unsigned long long ) {
+        sum += hough.find_circles( ring ).size();
+      } ) );
+
+  // Output tree policies, on the ptfanalysis tree of the macro benchmark
+  string policies = "default lz4:4 zstd:5 zlib:1 lzma:7 lz4:4:scanpoint zstd:5:scanpoint";
+  config.Get( "bench_output_policies", policies );
+  cout << "Output policy benchmarks on " << bench.tree()->GetEntries() << " entries:" << endl;
+  TTree * src = bench.tree();
+  unsigned long long nsrc = src->GetEntries();
+  WaveformFitResult * wf = new WaveformFitResult();
+  wf->SetBranchAddresses( src );
+  results.push_back( time_stage( "output_source_read", "waveform", nsrc, [&]( unsigned long long i ) {
+        src->GetEntry( i );
+      } ) );
+  delete wf;
+  src->ResetBranchAddresses();
+  stringstream ss( policies );
+  string spec;
+  while ( ss >> spec ) {
+    bench_output_policy( prefix + "_output.root", src, analysis->get_scanpoints(), TreeOutputPolicy( spec ), results );
+    cout << "    " << results.back().bytes << " bytes" << endl;
+  }
+  outFile->cd();
+
+  write_results( prefix, label, results );
+  cout << "Wrote " << prefix << ".json and " << prefix << ".csv (checksum " << sum << ")" << endl;
+
+  outFile->Close();
+  return 0;
+}
@@ -15,6 +15,8 @@
 
 #include "WaveformFitResult.hpp"
 #include "ScanPoint.hpp"
+#include "ScanPointSummary.hpp"
+#include "ScanPointIndex.hpp"
 #include "Utilities.hpp"
 #include "TFile.h"
 #include "TH2D.h"
@@ -41,13 +43,27 @@ double calculate_charge( const WaveformFitResult& wf ){
   return sqrt2pi * fabs( wf.amp * wf.sigma );
 } 
 
+// median of values, 0 if there are none
+double median( std::vector< double > values ){
+  if ( values.empty() ) return 0.;
+  std::nth_element( values.begin(), values.begin() + values.size()/2, values.end() );
+  return values[ values.size()/2 ];
+}
+
 int main( int argc, char* argv[] ) {
 
-  if ( argc != 3 && argc != 4){
-    std::cerr<<"Usage: ptf_charge_analysis.app ptf_analysis.root run_number [T/F/I]"<<std::endl;
-    std::cerr<<"Where the T/F/I is for True to do/not do circle fit to find PMT, I to cut inside circle (default T)\n"<<std::endl;
+  if ( argc < 3 || argc > 5 ){
+    std::cerr<<"Usage: ptf_charge_analysis.app ptf_analysis.root run_number [T/F/I] [-s]"<<std::endl;
+    std::cerr<<"Where the T/F/I is for True to do/not do circle fit to find PMT, I to cut inside circle (default T)"<<std::endl;
+    std::cerr<<"and -s fills the histograms from the scan point summaries instead of the waveform fits\n"<<std::endl;
     exit(0);
   }
+  string circle_option = "T";
+  bool use_summaries = false;
+  for ( int iarg = 3; iarg < argc; ++iarg ){
+    if ( string( argv[iarg] ) == "-s" ) use_summaries = true;
+    else circle_option = argv[iarg];
+  }
 
   // Get utilities
   Utilities utils;
@@ -66,6 +82,15 @@ int main( int argc, char* argv[] ) {
   // get the scanpoints information
   std::vector< ScanPoint > scanpoints = ReadScanPoints( fin );
 
+  // In preview mode or with the early stop (only some waveforms analysed) each
+  // entry is filled with the weight of its scan point, so that the counts
+  // estimate those of the whole scan
+  bool preview = utils.sampled_fraction( scanpoints ) < 1.;
+  if ( preview ) {
+    std::cout<<"Sampled scan: "<<100.*utils.sampled_fraction( scanpoints )<<"% of the waveforms were analysed"<<std::endl;
+    TH1::SetDefaultSumw2( true );
+  }
+
   vector< double > xbins = utils.get_bins( scanpoints, 'x' );
   vector< double > ybins = utils.get_bins( scanpoints, 'y' );
 
@@ -198,35 +223,54 @@ int main( int argc, char* argv[] ) {
   std::cout<<"Finished booking histograms"<<std::endl;
 
   // get the waveform fit TTree for PMT1 (The signal pmt)
-  TTree * tt1 = (TTree*)fin->Get("ptfanalysis0");
-  if ( !tt1 ){
-    std::cerr<<"Failed to read TTree called ptfanalysis0, exiting"<<std::endl;
-    return 0;
-  }
+  // or with -s its scan point summaries, with the charge histograms in the
+  // binning of ScanPointSummaryParams (see ScanPointSummary.hpp)
+  TTree * tt1 = nullptr;
   WaveformFitResult * wf = new WaveformFitResult;
-  wf->SetBranchAddresses( tt1 );
+  std::vector< ScanPointSummary > summaries;
+  if ( use_summaries ){
+    summaries = ReadScanPointSummaries( fin, 0 );
+    if ( summaries.size() != scanpoints.size() ){
+      std::cerr<<"No scan point summaries of PMT0 for the "<<scanpoints.size()<<" scan points, run without -s"<<std::endl;
+      return 0;
+    }
+  } else {
+    tt1 = (TTree*)fin->Get("ptfanalysis0");
+    if ( !tt1 ){
+      std::cerr<<"Failed to read TTree called ptfanalysis0, exiting"<<std::endl;
+      return 0;
+    }
+    wf->SetBranchAddresses( tt1 );
+  }
   
   // First loop through scanpoints to fill a few histograms
   for(unsigned int iscan=0; iscan<scanpoints.size(); iscan++){
     if (iscan%100==0) std::cout<<"pass 1: Filling histograms for iscan = "<<iscan<<" / "<<scanpoints.size()<<std::endl;
     ScanPoint scanpoint = scanpoints[ iscan ];
+    if ( use_summaries ){
+      summaries[ iscan ].hq.AddTo( hqallscanpt[ iscan ], scanpoint.weight() );
+      continue;
+    }
     //Loop over scanpoint
     for ( unsigned iev = 0; iev < scanpoint.nentries(); ++iev ){
       
       tt1->GetEvent( scanpoint.get_entry() + iev );
       double charge = calculate_charge( *wf );
-      hqallscanpt[ iscan ]->Fill( charge );
+      hqallscanpt[ iscan ]->Fill( charge, scanpoint.weight() );
     }
   }
 
   // Build 2d average charge plot from hqallscanpt histograms
+  std::vector< double > qavg_err;
   for ( unsigned iscan=0; iscan<scanpoints.size(); ++iscan){ 
     ScanPoint scanpoint = scanpoints[iscan];
     hscanpt->Fill( scanpoint.x(), scanpoint.y(), float(iscan) );
     if ( hqallscanpt[iscan]->Integral(2,50) > 200 ){
       hqavg->Fill( scanpoint.x(), scanpoint.y(), hqallscanpt[iscan]->GetMean() );
+      qavg_err.push_back( hqallscanpt[iscan]->GetMeanError() );
     }
   }
+  utils.label_preview( hqavg, scanpoints, median( qavg_err ) );
   
   // Find PMT location from hqavg histogram
   hqavg->Write();
@@ -234,7 +278,7 @@ int main( int argc, char* argv[] ) {
   Circle_st circ;
 
   bool docirclefit = true;
-  if ( argc == 4 && argv[3][0] == 'F' ) docirclefit = false;
+  if ( circle_option[0] == 'F' ) docirclefit = false;
   if ( docirclefit ){
     circ = find_circle_max_grad( hqavg, hgrad, 0.25 );
   } else {
@@ -249,6 +293,10 @@ int main( int argc, char* argv[] ) {
   std::cout<<"\t R       =   "<<circ.r<<std::endl;
   std::cout<<"==================================="<<std::endl;
 
+  // Which scan points are cut by the circle, found once from the grid of scan points
+  ScanPointIndex scanindex( scanpoints );
+  std::vector< bool > incircle = scanindex.InsideCircle( circ.xc, circ.yc, circ.r );
+
 
   //Second pass through scanpoints to fill histograms inside circle of PMT
   for(unsigned int iscan=0; iscan<scanpoints.size(); iscan++){
@@ -256,35 +304,51 @@ int main( int argc, char* argv[] ) {
 
     ScanPoint scanpoint = scanpoints[ iscan ];
 
-    if ( argc == 4 && argv[3][0] == 'I' ) {// cut inside instead of outside
-      if ( circ.is_inside( scanpoint.x(), scanpoint.y() ) ) {
+    if ( circle_option[0] == 'I' ) {// cut inside instead of outside
+      if ( incircle[ iscan ] ) {
 	std::cout<<"Skip scan point "<<iscan<<" inside circle " <<std::endl;
 	continue;
       }
     } else {
-      if ( !circ.is_inside( scanpoint.x(), scanpoint.y() ) ) {
+      if ( !incircle[ iscan ] ) {
 	std::cout<<"Skip scan point "<<iscan<<" outside circle " <<std::endl;
 	continue;
       }
     }
+
+    if ( use_summaries ){
+      // the pedestal is everything that is not signal
+      const ScanPointSummary& summary = summaries[ iscan ];
+      double w = scanpoint.weight();
+      summary.hqsig.AddTo( hqscanpt[ iscan ], w );
+      summary.hqsig.AddTo( hqsum, w );
+      summary.hq.AddTo( hqped, w, 0., &summary.hqsig );
+      summary.hq.AddTo( hpedscanpt[ iscan ], w, 0., &summary.hqsig );
+      summary.hamp.AddTo( hphall, w );
+      summary.hq.AddTo( hqall, w );
+      summary.hqfine.AddTo( hqallfine, w );
+      summary.hqfine.AddTo( hqallfinescanpt[ iscan ], w );
+      continue;
+    }
     
     //Loop over scanpoint
     for ( unsigned iev = 0; iev < scanpoint.nentries(); ++iev ){
       
       tt1->GetEvent( scanpoint.get_entry() + iev );
       double charge = calculate_charge( *wf );
+      double w = scanpoint.weight();
       if ( wf->haswf ) {
-	hqscanpt[ iscan ]->Fill( charge );
-	hqsum->Fill( charge );
+	hqscanpt[ iscan ]->Fill( charge, w );
+	hqsum->Fill( charge, w );
       } else {
-	hqped->Fill( charge );
-	hpedscanpt[ iscan ]->Fill( charge );
+	hqped->Fill( charge, w );
+	hpedscanpt[ iscan ]->Fill( charge, w );
       }
 
-      hphall->Fill( wf->amp );
-      hqall->Fill( charge );
-      hqallfine->Fill( charge );
-      hqallfinescanpt [ iscan ]->Fill(charge);
+      hphall->Fill( wf->amp, w );
+      hqall->Fill( charge, w );
+      hqallfine->Fill( charge, w );
+      hqallfinescanpt [ iscan ]->Fill( charge, w );
 
     }
   }
@@ -412,14 +476,14 @@ int main( int argc, char* argv[] ) {
 
     ScanPoint scanpoint = scanpoints[ iscan ];
 
-    if ( argc == 4 && argv[3][0] == 'I' ) {// cut inside instead of outside
-      if ( circ.is_inside( scanpoint.x(), scanpoint.y() ) ) {
+    if ( circle_option[0] == 'I' ) {// cut inside instead of outside
+      if ( incircle[ iscan ] ) {
 	vecpmtresponse.push_back( nullptr ); 
 	std::cout<<"Skip scan point "<<iscan<<" inside circle " <<std::endl;
 	continue;
       }
     } else {
-      if ( !circ.is_inside( scanpoint.x(), scanpoint.y() ) ) {
+      if ( !incircle[ iscan ] ) {
 	vecpmtresponse.push_back( nullptr ); 
 	std::cout<<"Skip scan point "<<iscan<<" outside circle " <<std::endl;
 	continue;
@@ -458,18 +522,34 @@ int main( int argc, char* argv[] ) {
 
 
   //Now fill 2d plots
+  std::vector< double > q1pe_err, q1sig_err, mu_err, nsignal_err;
   for ( unsigned iscan=0; iscan<scanpoints.size(); ++iscan){ 
     ScanPoint scanpoint = scanpoints[iscan];
-    hngoodfits->Fill( scanpoint.x(), scanpoint.y(), hqscanpt[iscan]->GetEntries() );
+    // weighted number of signals, the entries if all waveforms were analysed
+    int nbins = hqscanpt[iscan]->GetNbinsX();
+    double nsignal_error = 0.;
+    double nsignal = hqscanpt[iscan]->IntegralAndError( 0, nbins+1, nsignal_error );
+    hngoodfits->Fill( scanpoint.x(), scanpoint.y(), nsignal );
+    if ( nsignal > 0 ) nsignal_err.push_back( nsignal_error );
     if ( vecpmtresponse[ iscan ] != nullptr ){
       TF1* ftmp = vecpmtresponse[ iscan ];
       hq1pe->Fill( scanpoint.x(), scanpoint.y(), ftmp->GetParameter(1) );
       hq2pe->Fill( scanpoint.x(), scanpoint.y(), ftmp->GetParameter(2) );
       hq21pe->Fill( scanpoint.x(), scanpoint.y(), ftmp->GetParameter(3) );
       hq1pemu->Fill( scanpoint.x(), scanpoint.y(), ftmp->GetParameter(1)*ftmp->GetParameter(3) );
+      q1pe_err.push_back( ftmp->GetParError(1) );
+      q1sig_err.push_back( ftmp->GetParError(2) );
+      mu_err.push_back( ftmp->GetParError(3) );
     }
   }
 
+  // In preview mode label the maps with the median error of a scan point
+  utils.label_preview( hngoodfits, scanpoints, median( nsignal_err ) );
+  utils.label_preview( hq1pe, scanpoints, median( q1pe_err ) );
+  utils.label_preview( hq2pe, scanpoints, median( q1sig_err ) );
+  utils.label_preview( hq21pe, scanpoints, median( mu_err ) );
+  utils.label_preview( hq1pemu, scanpoints );
+
   //Write and close output file
   //PMTResponsePed::set_pedestal( "nofftcut_pedestal_4554.root", "hqall_nofftcut" );
   fout->Write();
@@ -1,5 +1,6 @@
 #include "wrapper.hpp"
 #include "Utilities.hpp"
+#include "SlowControlIndex.hpp"
 
 #include "TFile.h"
 #include "TGraph.h"
@@ -11,7 +12,7 @@
 #include <iostream>
 #include <ostream>
 #include <fstream>
-#include <unordered_set>
+#include <algorithm>
 #include <math.h>
 
 using namespace std;
@@ -40,58 +41,46 @@ int main(int argc, char** argv) {
   TGraph *gr_by = new TGraph();
   TGraph *gr_bz = new TGraph();
 
-  // Set up PTF Wrapper
-  vector<int> phidgets = {4};
-  vector<PTF::PMT> activePMTs = {}; //Not looking at PMT data
-  vector<PTF::Gantry> gantries = {PTF::Gantry0, PTF::Gantry1};
-  Wrapper wrapper = Wrapper(6000, 70, activePMTs, phidgets, gantries, PTF_CAEN_V1730);
-  wrapper.openFile( string(argv[1])+"/out_run0"+argv[2]+".root", "scan_tree");
-  cerr << "Num entries: " << wrapper.getNumEntries() << endl << endl;
-
-  unordered_set<int> skipLines = {};// {962,1923,2884,5240,6201,9611,10572,11533,12494,13455,15811,16771};
-
-  uint32_t lines = 0;
-  const uint32_t freq = 100;
+  // Field readings of the phidget in time order, without reading the waveforms
+  int phidget = 4;
+  SlowControlIndex sc;
+  string rawname = string(argv[1])+"/out_run0"+argv[2]+".root";
+  if ( !sc.Build( rawname, {phidget} ) ) exit( EXIT_FAILURE );
+  char bname[3][64];
+  snprintf(bname[0], 64, PHIDGET_FORMAT_X, phidget);
+  snprintf(bname[1], 64, PHIDGET_FORMAT_Y, phidget);
+  snprintf(bname[2], 64, PHIDGET_FORMAT_Z, phidget);
+  if ( !sc.Has(bname[0]) || !sc.Has(bname[1]) || !sc.Has(bname[2]) ) {
+    cerr << "No field readings of phidget " << phidget << " in " << rawname << endl;
+    exit( EXIT_FAILURE );
+  }
+  const TimeSeries& bx = sc[bname[0]];
+  const TimeSeries& by = sc[bname[1]];
+  const TimeSeries& bz = sc[bname[2]];
+  cerr << "Num readings: " << bx.size() << endl << endl;
+
+  // About 1000 points of each component against the time since the first
+  // reading, the y and z components interpolated to the times of the x one
+  uint32_t lines = bx.size();
   uint32_t gr_point = 0;
   uint32_t gr_freq = 0;
-  gr_freq = ceil( (float)wrapper.getNumEntries() / 1000.0 );
-
-  for (unsigned int i = 0; i < wrapper.getNumEntries(); i++) {
-    // cerr << "Entry " << i;
-    if (i % freq == 0 || i == wrapper.getNumEntries() - 1) {
-      cerr << "Entry " << i << "/" << wrapper.getNumEntries() << "\u001b[34;1m (" << (((double)i)/wrapper.getNumEntries()*100) << "%)\u001b[0m\033[K";
-      if (skipLines.find(i) != skipLines.end()) {
-        cerr << "\u001b[31;1m Skipping...\u001b[0m\r";
-        continue;
-      } else {
-        cerr << "\r";
-      }
-    }
-
-    if (skipLines.find(i) != skipLines.end()) continue;
-    lines++;
-
-    wrapper.setCurrentEntry(i);
-
-    //auto location = wrapper.getDataForCurrentEntry(PTF::Gantry1);
-
-    if (i % gr_freq == 0){
-      for (int phidget : phidgets) {
-        auto reading  = wrapper.getReadingForPhidget(phidget);
-        gr_bx->SetPoint(gr_point, gr_point, reading.Bx[0]);
-        gr_by->SetPoint(gr_point, gr_point, reading.By[0]);
-        gr_bz->SetPoint(gr_point, gr_point, reading.Bz[0]);
-      }
-      gr_point++;
-    }
-
+  gr_freq = max( 1u, (uint32_t)ceil( bx.size() / 1000.0 ) );
+  double t0 = sc.tmin();
+  TimeSeries::Cursor cy = by.cursor(), cz = bz.cursor();
+  for (unsigned int i = 0; i < bx.size(); i += gr_freq) {
+    double t = bx.time(i);
+    double minutes = ( t - t0 ) / 60.;
+    gr_bx->SetPoint(gr_point, minutes, bx.value(i));
+    gr_by->SetPoint(gr_point, minutes, cy.At(t));
+    gr_bz->SetPoint(gr_point, minutes, cz.At(t));
+    gr_point++;
   }
 
   mg->Add(gr_bx); gr_bx->SetTitle("Bx"); gr_bx->SetLineWidth(3);
   mg->Add(gr_by); gr_by->SetTitle("By"); gr_by->SetLineWidth(3);
   mg->Add(gr_bz); gr_bz->SetTitle("Bz"); gr_bz->SetLineWidth(3);
 
-  mg->SetTitle("Magnetic field strength; Data point; Field strength [G]");
+  mg->SetTitle("Magnetic field strength; Time since the first reading [min]; Field strength [G]");
 
   //Set directories
   //gr_bx->SetDirectory( fout );
@@ -1,5 +1,6 @@
 #include "WaveformFitResult.hpp"
 #include "ScanPoint.hpp"
+#include "ScanPointSummary.hpp"
 #include "Utilities.hpp"
 #include "FindCircle.hpp"
 #include "TDirectory.h"
@@ -132,10 +133,12 @@ void Ifit(TVirtualFitter*& gMinuit)
 //_______________________________________________________________________
 int main( int argc, char* argv[] ) {
 
-  if ( argc != 3 ){
-    std::cerr<<"Usage: ptf_qe_analysis.app ptf_analysis.root run_number\n";
+  if ( argc != 3 && !( argc == 4 && string( argv[3] ) == "-s" ) ){
+    std::cerr<<"Usage: ptf_qe_analysis.app ptf_analysis.root run_number [-s]\n";
+    std::cerr<<"Where -s takes the efficiencies from the scan point summaries instead of the waveform fits\n";
     exit(0);
   }
+  bool use_summaries = ( argc == 4 );
 
   // Get utilities
   Utilities utils;
@@ -173,9 +176,21 @@ int main( int argc, char* argv[] ) {
   model_h->SetTitle("Modelization of the temperature fluctuation");
   //______________________________________________________________________________________________________________
   // get the waveform fit TTree for PMT0
-  TTree * tt0 = (TTree*)fin->Get("ptfanalysis0");// how to create tree for the wave form
+  // or with -s the summaries of the scan points, see ScanPointSummary.hpp
+  TTree * tt0 = nullptr;
   WaveformFitResult * wf = new WaveformFitResult;
-  wf->SetBranchAddresses( tt0 );
+  vector< ScanPointSummary > summaries0, summaries1;
+  if ( use_summaries ){
+    summaries0 = ReadScanPointSummaries( fin, 0 );
+    summaries1 = ReadScanPointSummaries( fin, 1 );
+    if ( summaries0.size() != scanpoints.size() || summaries1.size() != scanpoints.size() ){
+      std::cerr<<"No scan point summaries of PMT0 and PMT1 for the "<<scanpoints.size()<<" scan points, run without -s"<<std::endl;
+      exit( EXIT_FAILURE );
+    }
+  } else {
+    tt0 = (TTree*)fin->Get("ptfanalysis0");// how to create tree for the wave form
+    wf->SetBranchAddresses( tt0 );
+  }
 
   // Vector to store the efficiencies
   // Used to calculate the correction below
@@ -186,6 +201,12 @@ int main( int argc, char* argv[] ) {
     if (iscan%1000==0) std::cout<<"Filling PMT0 histograms for iscan = "<<iscan<<" / "<<scanpoints.size()<<std::endl;
     ScanPoint scanpoint = scanpoints[ iscan ];
     v_pmt0_qe.push_back( 0.0 ); // store the data of the efficiency
+    if ( use_summaries ){
+      const ScanPointSummary& summary = summaries0[ iscan ];
+      pmt0_qe->Fill( summary.x, summary.y, summary.efficiency() );
+      v_pmt0_qe[iscan] = summary.efficiency();
+      continue;
+    }
     //Loop over scanpoint
     for ( unsigned iev = 0; iev < scanpoint.nentries(); ++iev ){
       tt0->GetEvent( scanpoint.get_entry() + iev );
@@ -197,8 +218,11 @@ int main( int argc, char* argv[] ) {
 
   //________________________________________________________________________________________________________________
   // Get the waveform fit TTree for PMT1
-  TTree * tt1 = (TTree*)fin->Get("ptfanalysis1");
-  wf->SetBranchAddresses( tt1 );
+  TTree * tt1 = nullptr;
+  if ( !use_summaries ){
+    tt1 = (TTree*)fin->Get("ptfanalysis1");
+    wf->SetBranchAddresses( tt1 );
+  }
 
   // Vector to store the efficiencies
   // Used to calculate the correction below
@@ -208,6 +232,12 @@ int main( int argc, char* argv[] ) {
     if (iscan%1000==0) std::cout<<"Filling PMT1 histograms for iscan = "<<iscan<<" / "<<scanpoints.size()<<std::endl;
     ScanPoint scanpoint = scanpoints[ iscan ];
     v_pmt1_qe.push_back( 0.0 );// what is exactly push back function ?
+    if ( use_summaries ){
+      const ScanPointSummary& summary = summaries1[ iscan ];
+      pmt1_qe->Fill( summary.x, summary.y, summary.efficiency() );
+      v_pmt1_qe[iscan] = summary.efficiency();
+      continue;
+    }
     //Loop over scanpoint
     for ( unsigned iev = 0; iev < scanpoint.nentries(); ++iev ){ // unsigned just means positif value only
       tt1->GetEvent( scanpoint.get_entry() + iev );
@@ -217,6 +247,21 @@ int main( int argc, char* argv[] ) {
 
     }
   }
+  //__________________________________________________________________________________________________________________
+  //In preview mode or with the early stop (only some waveforms analysed) the efficiencies are still the
+  //fraction of analysed waveforms with a pulse; label the maps with the binomial
+  //error of one scan point at the average efficiency
+  double nentries_av = utils.mean_entries( scanpoints );
+  auto binomial_error = [&]( const vector< double >& qe ){
+    double sum = 0.; int n = 0;
+    for ( double e : qe ) if ( e > 1e-10 ){ sum += e; ++n; }
+    double p = n > 0 ? sum / n : 0.;
+    return nentries_av > 0. ? sqrt( p * ( 1. - p ) / nentries_av ) : 0.;
+  };
+  utils.label_preview( pmt0_qe, scanpoints, binomial_error( v_pmt0_qe ) );
+  utils.label_preview( pmt0_qe_corr, scanpoints, binomial_error( v_pmt0_qe ) );
+  utils.label_preview( pmt1_qe, scanpoints, binomial_error( v_pmt1_qe ) );
+
   //__________________________________________________________________________________________________________________
   //Calculate temperature correction
 
@@ -0,0 +1,253 @@
+/// Generator of synthetic PTF scan files
+///
+/// Writes a scan_tree with the branch layout that Wrapper::setDataPointers expects,
+/// so the output can be run through ptf_analysis / mpmt_analysis like real data:
+///   num_points                      number of waveforms in this scan point
+///   V1730_wave<ch>[num_points][len] waveform samples (ADC counts) for each channel
+///   gantry<g>_x/y/z/rot/tilt        gantry positions
+///   phidg<p>_Bx/By/Bz/Ax/Ay/Az      phidget field and acceleration readings
+///   evt_timestamp[num_points]       unix time of each waveform
+///   ext2_temp, timestamp            temperature and time of the scan point
+/// Optionally also writes the BRB settings_tree (baselines and HV), and a
+/// truth_tree with one entry per simulated waveform.
+///
+/// The scan is a nx by ny grid of points for gantry1.  The waveform model
+/// and scan are set from a configuration file (see scan_generator.config.dat).
+///
+/// Usage: ptf_scan_generator.app output.root config_file
+
+#include "wrapper.hpp"
+#include "Configuration.hpp"
+#include "WaveformGenerator.hpp"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TRandom3.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+using namespace std;
+
+int main( int argc, char** argv ) {
+  if ( argc != 3 ) {
+    cerr << "usage: ptf_scan_generator.app output.root config_file" << endl;
+    return 0;
+  }
+
+  // Load config file
+  Configuration config;
+  if ( !config.Load( argv[2] ) ) exit( EXIT_FAILURE );
+
+  string digitizer = "ptf";
+  vector<int> channels;
+  vector<int> phidgets;
+  int    nx = 10, ny = 10;
+  double x0 = 0.35, y0 = 0.30, xstep = 0.01, ystep = 0.01, zpos = 0.40;
+  int    waveforms_per_point = 1000;
+  int    seed = 4357;
+  int    phidget_readings = 10;
+  double start_time = 1.6e9;
+  double point_duration = 10.; // s per scan point
+  double temperature = 20.0, temperature_drift = 0.0; // C, C per scan point
+  bool   write_truth = true;
+  bool   write_settings = false;
+  int    settings_baseline = 2048; // ADC counts written to settings_tree
+
+  config.Get( "digitizer", digitizer );
+  if ( !config.Get( "channels", channels ) ) channels = { 0, 5, 1 };
+  if ( !config.Get( "phidgets", phidgets ) ) phidgets = { 0, 1, 3 };
+  config.Get( "nx", nx );
+  config.Get( "ny", ny );
+  config.Get( "x0", x0 );
+  config.Get( "y0", y0 );
+  config.Get( "xstep", xstep );
+  config.Get( "ystep", ystep );
+  config.Get( "z", zpos );
+  config.Get( "waveforms_per_point", waveforms_per_point );
+  config.Get( "seed", seed );
+  config.Get( "phidget_readings", phidget_readings );
+  config.Get( "start_time", start_time );
+  config.Get( "point_duration", point_duration );
+  config.Get( "temperature", temperature );
+  config.Get( "temperature_drift", temperature_drift );
+  config.Get( "write_truth", write_truth );
+  config.Get( "write_settings_tree", write_settings );
+  config.Get( "settings_baseline", settings_baseline );
+
+  // Waveform model, with digitizer defaults
+  WaveformGeneratorParams par;
+  if ( digitizer == "mpmt" ) {
+    par.nsamples = 1024;
+    par.sample_ns = 1000. / mPMT_DIGITIZER_SAMPLE_RATE;
+    par.full_scale = mPMT_DIGITIZER_FULL_SCALE_RANGE;
+    par.resolution = mPMT_DIGITIZER_RESOLUTION;
+    par.shape = EMGPulse;
+    par.pulse_time = 2200.;
+    par.pulse_sigma = 9.6;
+  } else {
+    par.sample_ns = 1000. / PTF_CAEN_V1730_SAMPLE_RATE;
+    par.full_scale = PTF_CAEN_V1730_FULL_SCALE_RANGE;
+    par.resolution = PTF_CAEN_V1730_RESOLUTION;
+  }
+  par.Load( config );
+
+  if ( phidget_readings < 1 || phidget_readings > 150 ) {
+    cout << "phidget_readings must be between 1 and 150 (size of PhidgetReading arrays)." << endl;
+    exit( EXIT_FAILURE );
+  }
+  if ( waveforms_per_point < 1 ) {
+    cout << "waveforms_per_point must be at least 1." << endl;
+    exit( EXIT_FAILURE );
+  }
+
+  cout << "Generating " << nx*ny << " scan points x " << waveforms_per_point << " waveforms x "
+       << channels.size() << " channels of " << par.nsamples << " samples" << endl;
+
+  TFile * outFile = new TFile( argv[1], "NEW" );
+  if ( !outFile->IsOpen() ) {
+    cout << "Could not create output file " << argv[1] << endl;
+    exit( EXIT_FAILURE );
+  }
+
+  // set up the scan_tree branches
+  TTree * scan_tree = new TTree( "scan_tree", "scan_tree" );
+  char branchName[64], leafList[128];
+
+  unsigned long long num_points = waveforms_per_point;
+  scan_tree->Branch( "num_points", &num_points, "num_points/l" );
+
+  vector< vector< double > > wavedata( channels.size(), vector< double >( (size_t)waveforms_per_point * par.nsamples ) );
+  for ( unsigned ich = 0; ich < channels.size(); ++ich ) {
+    snprintf( branchName, 64, PMT_CHANNEL_FORMAT, channels[ich] );
+    snprintf( leafList, 128, "%s[num_points][%d]/D", branchName, par.nsamples );
+    scan_tree->Branch( branchName, &wavedata[ich][0], leafList );
+  }
+
+  GantryData gantry[2];
+  for ( int g = 0; g < 2; ++g ) {
+    snprintf( branchName, 64, GANTRY_FORMAT_X, g );     scan_tree->Branch( branchName, &gantry[g].x,     (string(branchName)+"/D").c_str() );
+    snprintf( branchName, 64, GANTRY_FORMAT_Y, g );     scan_tree->Branch( branchName, &gantry[g].y,     (string(branchName)+"/D").c_str() );
+    snprintf( branchName, 64, GANTRY_FORMAT_Z, g );     scan_tree->Branch( branchName, &gantry[g].z,     (string(branchName)+"/D").c_str() );
+    snprintf( branchName, 64, GANTRY_FORMAT_THETA, g ); scan_tree->Branch( branchName, &gantry[g].theta, (string(branchName)+"/D").c_str() );
+    snprintf( branchName, 64, GANTRY_FORMAT_PHI, g );   scan_tree->Branch( branchName, &gantry[g].phi,   (string(branchName)+"/D").c_str() );
+  }
+
+  vector< PTF::PhidgetReading > phidgetData( phidgets.size() );
+  const char* phidgetFormats[6] = { PHIDGET_FORMAT_X, PHIDGET_FORMAT_Y, PHIDGET_FORMAT_Z,
+                                    PHIDGET_FORMAT_ACCX, PHIDGET_FORMAT_ACCY, PHIDGET_FORMAT_ACCZ };
+  for ( unsigned ip = 0; ip < phidgets.size(); ++ip ) {
+    double* arrays[6] = { phidgetData[ip].Bx, phidgetData[ip].By, phidgetData[ip].Bz,
+                          phidgetData[ip].Ax, phidgetData[ip].Ay, phidgetData[ip].Az };
+    for ( int k = 0; k < 6; ++k ) {
+      snprintf( branchName, 64, phidgetFormats[k], phidgets[ip] );
+      snprintf( leafList, 128, "%s[%d]/D", branchName, phidget_readings );
+      scan_tree->Branch( branchName, arrays[k], leafList );
+    }
+  }
+
+  vector< double > evt_timestamp( waveforms_per_point );
+  scan_tree->Branch( "evt_timestamp", &evt_timestamp[0], "evt_timestamp[num_points]/D" );
+  double ext2_temp, timestamp;
+  scan_tree->Branch( "ext2_temp", &ext2_temp, "ext2_temp/D" );
+  scan_tree->Branch( "timestamp", &timestamp, "timestamp/D" );
+
+  // truth for every waveform
+  TTree * truth_tree = nullptr;
+  WaveformTruth truth;
+  int t_entry, t_wavenum, t_channel;
+  if ( write_truth ) {
+    truth_tree = new TTree( "truth_tree", "truth of each generated waveform" );
+    truth_tree->Branch( "entry",        &t_entry,            "entry/I" );
+    truth_tree->Branch( "wavenum",      &t_wavenum,          "wavenum/I" );
+    truth_tree->Branch( "channel",      &t_channel,          "channel/I" );
+    truth_tree->Branch( "npe",          &truth.npe,          "npe/I" );
+    truth_tree->Branch( "nafterpulses", &truth.nafterpulses, "nafterpulses/I" );
+    truth_tree->Branch( "ndark",        &truth.ndark,        "ndark/I" );
+    truth_tree->Branch( "time",         &truth.time,         "time/D" );
+    truth_tree->Branch( "amp",          &truth.amp,          "amp/D" );
+    truth_tree->Branch( "charge",       &truth.charge,       "charge/D" );
+    truth_tree->Branch( "ring_amp",     &truth.ring_amp,     "ring_amp/D" );
+    truth_tree->Branch( "ring_phase",   &truth.ring_phase,   "ring_phase/D" );
+  }
+
+  // one generator per channel, each with its own random sequence
+  vector< WaveformGenerator* > generators;
+  for ( unsigned ich = 0; ich < channels.size(); ++ich ) {
+    generators.push_back( new WaveformGenerator( par, seed + 7919*ich ) );
+  }
+  TRandom3 rand( seed + 1 );
+
+  // Loop over scan points.  Like real scans, the first two entries are at
+  // the home position; PTFAnalysis starts from entry 2.
+  unsigned long long nscanpts = (unsigned long long)nx * ny + 2;
+  unsigned long long nwaveforms = 0;
+  for ( unsigned long long i = 0; i < nscanpts; ++i ) {
+    if ( i % 10 == 0 ) {
+      cout << "Scan point " << i << " / " << nscanpts << endl;
+    }
+    timestamp = start_time + i * point_duration;
+    ext2_temp = temperature + i * temperature_drift;
+
+    gantry[0].x = 0.; gantry[0].y = 0.; gantry[0].z = 0.; gantry[0].theta = 0.; gantry[0].phi = 0.;
+    gantry[1] = gantry[0];
+    if ( i >= 2 ) {
+      unsigned long long ipt = i - 2;
+      int ix = ipt % nx;
+      int iy = ipt / nx;
+      if ( iy % 2 == 1 ) ix = nx - 1 - ix; // serpentine scan, like the gantry
+      gantry[1].x = x0 + ix * xstep;
+      gantry[1].y = y0 + iy * ystep;
+      gantry[1].z = zpos;
+    }
+
+    for ( unsigned ip = 0; ip < phidgets.size(); ++ip ) {
+      for ( int k = 0; k < phidget_readings; ++k ) {
+        phidgetData[ip].Bx[k] = rand.Gaus( 0.0, 0.002 );
+        phidgetData[ip].By[k] = rand.Gaus( 0.0, 0.002 );
+        phidgetData[ip].Bz[k] = rand.Gaus( 0.5, 0.002 );
+        phidgetData[ip].Ax[k] = rand.Gaus( 0.0, 0.001 );
+        phidgetData[ip].Ay[k] = rand.Gaus( 0.0, 0.001 );
+        phidgetData[ip].Az[k] = rand.Gaus( 1.0, 0.001 );
+      }
+    }
+
+    for ( int j = 0; j < waveforms_per_point; ++j ) {
+      evt_timestamp[j] = timestamp + point_duration * j / waveforms_per_point;
+      for ( unsigned ich = 0; ich < channels.size(); ++ich ) {
+        generators[ich]->generate( &wavedata[ich][(size_t)j * par.nsamples], truth );
+        if ( truth_tree ) {
+          t_entry = i; t_wavenum = j; t_channel = channels[ich];
+          truth_tree->Fill();
+        }
+      }
+    }
+    nwaveforms += (unsigned long long)waveforms_per_point * channels.size();
+    scan_tree->Fill();
+  }
+
+  // BRB settings tree read by BrbSettingsTree::LoadSettingsTree
+  if ( write_settings ) {
+    double baselines[20], hv[20];
+    TTree * settings_tree = new TTree( "settings_tree", "settings_tree" );
+    settings_tree->Branch( "CalcBaseline", baselines, "CalcBaseline[20]/D" );
+    settings_tree->Branch( "HVsetpoints", hv, "HVsetpoints[20]/D" );
+    for ( int k = 0; k < 20; ++k ) {
+      baselines[k] = settings_baseline;
+      hv[k] = 0.;
+    }
+    settings_tree->Fill();
+  }
+
+  outFile->Write();
+  outFile->Close();
+
+  for ( WaveformGenerator* gen : generators ) delete gen;
+
+  cout << "Wrote " << nscanpts << " scan points, " << nwaveforms << " waveforms to " << argv[1] << endl;
+  cout << "Done" << endl;
+
+  return 0;
+}
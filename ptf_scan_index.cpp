@@ -0,0 +1,72 @@
+/// Sidecar metadata index of raw runs, see ScanIndex.hpp
+///
+/// Builds the index of a raw run once (gantry positions, timestamps,
+/// temperature and num_points of every scan_tree entry, and where the
+/// baskets of each branch are in the file), next to the run as
+/// <run>.index.root unless another name is given.  The query modes print
+/// the entries of a region of gantry 1 or of a time window from the index,
+/// without opening the raw run.
+///
+/// Usage: ptf_scan_index.app raw.root [index.root]
+///    or: ptf_scan_index.app -r index.root x y radius
+///    or: ptf_scan_index.app -t index.root t0 t1
+
+#include "ScanIndex.hpp"
+
+#include "TStopwatch.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+// One line per entry, with its gantry 1 position, time and temperature
+void print_entries( const ScanIndex& index, const vector< unsigned long long >& entries ){
+  for ( unsigned long long e : entries ){
+    const ScanIndexEntry& s = index[ e ];
+    cout << e << "  x=" << s.gantry1.x << " y=" << s.gantry1.y << " z=" << s.gantry1.z
+         << "  t=" << s.timestamp << "  T=" << s.ext2_temp << "  num_points=" << s.num_points << endl;
+  }
+  cout << entries.size() << " of " << index.size() << " entries" << endl;
+}
+
+int main( int argc, char** argv ) {
+  string mode = argc > 1 ? argv[1] : "";
+  if ( argc < 2 || argc > 6 || ( mode == "-r" && argc != 6 ) || ( mode == "-t" && argc != 5 ) ||
+       ( mode != "-r" && mode != "-t" && argc > 3 ) ) {
+    cerr << "usage: ptf_scan_index.app raw.root [index.root]" << endl;
+    cerr << "   or: ptf_scan_index.app -r index.root x y radius" << endl;
+    cerr << "   or: ptf_scan_index.app -t index.root t0 t1" << endl;
+    return 0;
+  }
+
+  ScanIndex index;
+  if ( mode == "-r" || mode == "-t" ) {
+    if ( !index.Read( argv[2] ) ) exit( EXIT_FAILURE );
+    if ( mode == "-r" ) print_entries( index, index.InCircle( PTF::Gantry1, atof( argv[3] ), atof( argv[4] ), atof( argv[5] ) ) );
+    else print_entries( index, index.InTimeWindow( atof( argv[3] ), atof( argv[4] ) ) );
+    return 0;
+  }
+
+  string rawfile = argv[1];
+  string indexfile = argc > 2 ? argv[2] : ScanIndex::FileName( rawfile );
+  TStopwatch timer;
+  if ( !index.Build( rawfile ) ) exit( EXIT_FAILURE );
+  if ( !index.Write( indexfile ) ) exit( EXIT_FAILURE );
+  timer.Stop();
+
+  double tmin = INFINITY, tmax = -INFINITY, Tmin = INFINITY, Tmax = -INFINITY;
+  for ( const ScanIndexEntry& e : index.entries() ) {
+    if ( std::isfinite( e.timestamp ) ) { tmin = min( tmin, e.timestamp ); tmax = max( tmax, e.timestamp ); }
+    if ( std::isfinite( e.ext2_temp ) ) { Tmin = min( Tmin, e.ext2_temp ); Tmax = max( Tmax, e.ext2_temp ); }
+  }
+  cout << "Indexed " << index.size() << " entries with " << index.total_points() << " waveforms and "
+       << index.BasketBranches().size() << " branches of " << rawfile << " in " << timer.RealTime() << " s" << endl;
+  cout << "timestamps " << tmin << " to " << tmax << ", ext2_temp " << Tmin << " to " << Tmax << endl;
+  cout << "Wrote " << indexfile << endl;
+
+  return 0;
+}
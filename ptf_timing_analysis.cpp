@@ -11,6 +11,7 @@
 
 #include "WaveformFitResult.hpp"
 #include "ScanPoint.hpp"
+#include "ScanPointSummary.hpp"
 #include "Utilities.hpp"
 #include "FindCircle.hpp"
 #include "TFile.h"
@@ -33,10 +34,12 @@ using namespace std;
 
 int main( int argc, char* argv[] ) {
 
-  if ( argc != 3 ){
-    std::cerr<<"Usage: ptf_timing_analysis.app ptf_analysis.root run_number\n";
+  if ( argc != 3 && !( argc == 4 && string( argv[3] ) == "-s" ) ){
+    std::cerr<<"Usage: ptf_timing_analysis.app ptf_analysis.root run_number [-s]\n";
+    std::cerr<<"Where -s fills the time histograms from the scan point summaries instead of the waveform fits\n";
     exit(0);
   }
+  bool use_summaries = ( argc == 4 );
 
   // Get utilities
   Utilities utils;
@@ -118,37 +121,61 @@ int main( int argc, char* argv[] ) {
 
   std::cout<<"Finished booking histograms"<<std::endl;
 
-  // get the waveform fit TTree for PMT0 (The signal pmt)
-  TTree * tt0 = (TTree*)fin->Get("ptfanalysis0");
-  if ( !tt0 ){
-    std::cerr<<"Failed to read TTree called ptfanalysis0, exiting"<<std::endl;
-    return 0;
-  }
+  TTree * tt0 = nullptr, * tt1 = nullptr, * tt2 = nullptr;
   WaveformFitResult * wf0 = new WaveformFitResult;
-  wf0->SetBranchAddresses( tt0 );
-
-  // get the waveform fit TTree for PMT1 (The reference pmt)
-  TTree * tt1 = (TTree*)fin->Get("ptfanalysis1");
-  if ( !tt1 ){
-    std::cerr<<"Failed to read TTree called ptfanalysis1, exiting"<<std::endl;
-    return 0;
-  }
   WaveformFitResult * wf1 = new WaveformFitResult;
-  wf1->SetBranchAddresses( tt1 );
+  WaveformFitResult * wf2 = new WaveformFitResult;
+  // with -s the scan point summaries of the three, see ScanPointSummary.hpp
+  std::vector< ScanPointSummary > summaries0, summaries1, summaries2;
+  if ( use_summaries ){
+    summaries0 = ReadScanPointSummaries( fin, 0 );
+    summaries1 = ReadScanPointSummaries( fin, 1 );
+    summaries2 = ReadScanPointSummaries( fin, 2 );
+    if ( summaries0.size() != scanpoints.size() || summaries1.size() != scanpoints.size() ||
+         summaries2.size() != scanpoints.size() ){
+      std::cerr<<"No scan point summaries of PMT0, 1 and 2 for the "<<scanpoints.size()<<" scan points, run without -s"<<std::endl;
+      return 0;
+    }
+  } else {
+    // get the waveform fit TTree for PMT0 (The signal pmt)
+    tt0 = (TTree*)fin->Get("ptfanalysis0");
+    if ( !tt0 ){
+      std::cerr<<"Failed to read TTree called ptfanalysis0, exiting"<<std::endl;
+      return 0;
+    }
+    wf0->SetBranchAddresses( tt0 );
 
-  // get the waveform fit TTree for PMT2 (The reference wave)
-  TTree * tt2 = (TTree*)fin->Get("ptfanalysis2");
-  if ( !tt2 ){
-    std::cerr<<"Failed to read TTree called ptfanalysis2, exiting"<<std::endl;
-    return 0;
+    // get the waveform fit TTree for PMT1 (The reference pmt)
+    tt1 = (TTree*)fin->Get("ptfanalysis1");
+    if ( !tt1 ){
+      std::cerr<<"Failed to read TTree called ptfanalysis1, exiting"<<std::endl;
+      return 0;
+    }
+    wf1->SetBranchAddresses( tt1 );
+
+    // get the waveform fit TTree for PMT2 (The reference wave)
+    tt2 = (TTree*)fin->Get("ptfanalysis2");
+    if ( !tt2 ){
+      std::cerr<<"Failed to read TTree called ptfanalysis2, exiting"<<std::endl;
+      return 0;
+    }
+    wf2->SetBranchAddresses( tt2 );
   }
-  WaveformFitResult * wf2 = new WaveformFitResult;
-  wf2->SetBranchAddresses( tt2 );
   
   //Loop through scanpoints to fill histograms
   for(unsigned int iscan=0; iscan<scanpoints.size(); iscan++){
     if (iscan%1000==0) std::cout<<"Filling histograms for iscan = "<<iscan<<" / "<<scanpoints.size()<<std::endl;
     ScanPoint scanpoint = scanpoints[ iscan ];
+    if ( use_summaries ){
+      // Relative to the mean time of the reference wave at the scan point rather
+      // than waveform by waveform, so the spread includes the (small) spread of
+      // the reference time
+      double tref = summaries2[ iscan ].mean_time_all();
+      summaries0[ iscan ].ht.AddTo( h_pmt0_tscanpt[ iscan ], 1., -tref );
+      summaries1[ iscan ].ht.AddTo( h_pmt1_tscanpt[ iscan ], 1., -tref );
+      summaries2[ iscan ].htall.AddTo( h_pmt2_tscanpt[ iscan ] );
+      continue;
+    }
     //Loop over scanpoint
     for ( unsigned iev = 0; iev < scanpoint.nentries(); ++iev ){
       
@@ -0,0 +1,102 @@
+/// Slow control readings at the time of each analysed waveform
+///
+/// Reads every slow control reading of a raw run (ext2_temp, and the field
+/// and acceleration of the phidgets) into a SlowControlIndex, then writes
+/// for each ptfanalysis<pmt> tree of an analysed file a slowcontrol<pmt>
+/// tree with the same entries: the readings interpolated to the
+/// evt_timestamp of each waveform, NaN for waveforms without one.  The
+/// trees are read alongside the ptfanalysis ones as friends:
+///
+///   TTree * tt = (TTree*)fin->Get( "ptfanalysis0" );
+///   tt->AddFriend( "slowcontrol0", "slowcontrol.root" );
+///   tt->Draw( "slowcontrol0.ext2_temp:evt_timestamp" );
+///
+/// Usage: slow_control_join.app raw.root ptf_analysis.root out.root [phidget ...]
+
+#include "SlowControlIndex.hpp"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TKey.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+
+using namespace std;
+
+int main( int argc, char** argv ) {
+  if ( argc < 4 ) {
+    cerr << "usage: slow_control_join.app raw.root ptf_analysis.root out.root [phidget ...]" << endl;
+    return 0;
+  }
+
+  vector< int > phidgets = { 0, 1, 3, 4 };
+  if ( argc > 4 ) {
+    phidgets.clear();
+    for ( int i = 4; i < argc; ++i ) phidgets.push_back( atoi( argv[i] ) );
+  }
+
+  SlowControlIndex sc;
+  if ( !sc.Build( argv[1], phidgets ) ) exit( EXIT_FAILURE );
+  vector< string > names = sc.Names();
+  if ( names.empty() ) {
+    cout << "No slow control readings in " << argv[1] << endl;
+    exit( EXIT_FAILURE );
+  }
+  cout << "Read " << sc[ names[0] ].size() << " readings of " << names.size() << " quantities from "
+       << fixed << sc.tmin() << " to " << sc.tmax() << endl;
+
+  TFile * fin = new TFile( argv[2], "READ" );
+  if ( !fin->IsOpen() ) {
+    cout << "Could not open " << argv[2] << endl;
+    exit( EXIT_FAILURE );
+  }
+  TFile * fout = new TFile( argv[3], "RECREATE" );
+
+  const string prefix = "ptfanalysis";
+  TIter next( fin->GetListOfKeys() );
+  while ( TKey * key = (TKey*)next() ) {
+    string treename = key->GetName();
+    if ( string( key->GetClassName() ) != "TTree" || treename.compare( 0, prefix.size(), prefix ) != 0 ) continue;
+    if ( fin->GetKey( treename.c_str() ) != key ) continue; // an older cycle
+    TTree * tt = (TTree*)fin->Get( treename.c_str() );
+    if ( tt == nullptr || tt->GetBranch( "evt_timestamp" ) == nullptr ) continue;
+
+    // only the timestamps of the waveforms are read
+    double evt_timestamp;
+    tt->SetBranchStatus( "*", 0 );
+    tt->SetBranchStatus( "evt_timestamp", 1 );
+    tt->SetBranchAddress( "evt_timestamp", &evt_timestamp );
+
+    string pmt = treename.substr( prefix.size() );
+    fout->cd();
+    TTree * out = new TTree( ( "slowcontrol" + pmt ).c_str(), ( "slow control readings at the waveforms of " + treename ).c_str() );
+    vector< double > values( names.size() );
+    vector< TimeSeries::Cursor > cursors;
+    for ( unsigned k = 0; k < names.size(); ++k ) {
+      out->Branch( names[k].c_str(), &values[k], ( names[k] + "/D" ).c_str() );
+      cursors.push_back( sc[ names[k] ].cursor() );
+    }
+
+    // the entries are in time order within a run, so the cursors only
+    // move forward
+    unsigned long long n = tt->GetEntries(), outside = 0;
+    for ( unsigned long long i = 0; i < n; ++i ) {
+      tt->GetEntry( i );
+      double t = evt_timestamp > 0. ? evt_timestamp : NAN; // -1 when the run had none
+      if ( !( t >= sc.tmin() && t <= sc.tmax() ) ) ++outside;
+      for ( unsigned k = 0; k < names.size(); ++k ) values[k] = cursors[k].At( t );
+      out->Fill();
+    }
+    out->Write();
+    cout << "Wrote slowcontrol" << pmt << " for " << n << " waveforms of " << treename << ", "
+         << outside << " without a timestamp or outside of the readings" << endl;
+  }
+
+  fout->Close();
+  fin->Close();
+  return 0;
+}
@@ -0,0 +1,52 @@
+#include "BaselineTracker.hpp"
+#include "Configuration.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+void BaselineTrackerParams::Load( const Configuration& config, const std::string& prefix ){
+  config.Get( prefix+"tracking",      use );
+  config.Get( prefix+"median_window", median_window );
+  config.Get( prefix+"alpha",         alpha );
+  config.Get( prefix+"pulse_cut",     pulse_cut );
+  if ( median_window < 1 ) median_window = 1;
+  if ( alpha <= 0. || alpha > 1. ) alpha = 1.;
+}
+
+
+BaselineTracker::BaselineTracker( const BaselineTrackerParams& par ) : fPar( par ) {
+  fRecent.reserve( fPar.median_window );
+}
+
+bool BaselineTracker::Update( const ConditionedWaveform& wf ){
+  if ( wf.raw_baseline - wf.raw_baseline_min > fPar.pulse_cut ){
+    ++fRejected;
+    return false;
+  }
+  if ( (int)fRecent.size() < fPar.median_window ) fRecent.push_back( wf.raw_baseline );
+  else fRecent[ fNext ] = wf.raw_baseline;
+  fNext = ( fNext + 1 ) % fPar.median_window;
+
+  double median = Median();
+  if ( fAccepted == 0 ) fBaseline = median;
+  else fBaseline += fPar.alpha * ( median - fBaseline );
+  ++fAccepted;
+  return true;
+}
+
+double BaselineTracker::Spread() const {
+  // 1.4826 x median absolute deviation is the rms for gaussian noise
+  return fRecent.empty() ? 0. : 1.4826 * Median( Median(), true );
+}
+
+// Median of the recent means, or of their absolute deviations from shift
+double BaselineTracker::Median( double shift, bool absolute ) const {
+  fSorted = fRecent;
+  if ( absolute ) for ( double& v : fSorted ) v = std::fabs( v - shift );
+  size_t n = fSorted.size(), half = n / 2;
+  std::nth_element( fSorted.begin(), fSorted.begin() + half, fSorted.end() );
+  double m = fSorted[ half ];
+  if ( n % 2 == 0 ) m = 0.5 * ( m + *std::max_element( fSorted.begin(), fSorted.begin() + half ) );
+  return m;
+}
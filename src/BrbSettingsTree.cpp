@@ -54,7 +54,9 @@ int BrbSettingsTree::LoadSettingsTree(TFile *file){
   // Get the single event in tree
   settings_tree->GetEvent(0);
 
-  // Store values 
+  // Store values (replacing those of a previous run)
+  fBaselines.clear();
+  fHV_setpoints.clear();
   for(int i = 0; i < 20 ; i++){
 
     // convert baseline from counts to voltage
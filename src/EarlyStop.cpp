@@ -0,0 +1,51 @@
+#include "EarlyStop.hpp"
+#include "Configuration.hpp"
+
+#include <cmath>
+#include <limits>
+
+
+void EarlyStopParams::Load( const Configuration& config, const std::string& prefix ){
+  config.Get( "early_stop",                use );
+  config.Get( prefix+"min_waveforms",      min_waveforms );
+  config.Get( prefix+"z",                  z );
+  config.Get( prefix+"efficiency_width",   efficiency_width );
+  config.Get( prefix+"charge_width",       charge_width );
+  if ( min_waveforms < 2 ) min_waveforms = 2;
+}
+
+
+void EarlyStop::BeginScanPoint(){
+  fN = fHasWf = fNCharge = 0;
+  fMean = fM2 = 0.;
+}
+
+void EarlyStop::Update( bool haswf, double charge ){
+  ++fN;
+  if ( haswf ) ++fHasWf;
+  if ( std::isfinite( charge ) ){
+    ++fNCharge;
+    double delta = charge - fMean;
+    fMean += delta / fNCharge;
+    fM2 += delta * ( charge - fMean );
+  }
+}
+
+double EarlyStop::EfficiencyWidth() const {
+  if ( fN == 0 ) return 1.;
+  double n = fN, p = fHasWf / n, z2 = fPar.z * fPar.z;
+  return 2. * fPar.z / ( 1. + z2 / n ) * std::sqrt( p * ( 1. - p ) / n + z2 / ( 4. * n * n ) );
+}
+
+double EarlyStop::ChargeWidth() const {
+  if ( fNCharge < 2 ) return std::numeric_limits< double >::infinity();
+  double variance = fM2 / ( fNCharge - 1 );
+  return 2. * fPar.z * std::sqrt( variance / fNCharge );
+}
+
+bool EarlyStop::Converged() const {
+  if ( !fPar.use || fN < (unsigned long long)fPar.min_waveforms ) return false;
+  if ( EfficiencyWidth() > fPar.efficiency_width ) return false;
+  if ( fPar.charge_width > 0. && ChargeWidth() > fPar.charge_width ) return false;
+  return true;
+}
@@ -0,0 +1,23 @@
+#include "FastMath.hpp"
+
+namespace FastMath {
+  namespace detail {
+
+    double erfcx_value[ kErfcxSize ];
+    double erfcx_deriv[ kErfcxSize ];
+
+    // Fill the tables when the program starts
+    struct ErfcxTable {
+      ErfcxTable(){
+        for ( int i = 0; i < kErfcxSize; ++i ){
+          double z = double( i ) / kErfcxScale;
+          erfcx_value[i] = std::exp( z*z ) * std::erfc( z );
+          // d/dz erfcx = 2 z erfcx - 2/sqrt(pi)
+          erfcx_deriv[i] = 2. * z * erfcx_value[i] - 1.12837916709551257390;
+        }
+      }
+    };
+    static ErfcxTable erfcx_table;
+
+  }
+}
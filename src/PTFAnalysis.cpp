@@ -6,27 +6,60 @@
 #include "PulseFinding.hpp"
 #include "TH2D.h"
 #include "BrbSettingsTree.hxx"
+#include "PerfStats.hpp"
+#include "TreeOutputPolicy.hpp"
+#include "WaveformSnapshot.hpp"
+#include "PulseTemplate.hpp"
+#include "FastMath.hpp"
+#include "RingingFilter.hpp"
+#include "WaveformConditioner.hpp"
+#include "BaselineTracker.hpp"
+#include "ScanPointIndex.hpp"
 
 #include <iostream>
 #include <ostream>
 #include <fstream>
 #include <math.h>
+#include <cmath>
+
+// Condition one waveform in digitizer counts into volts, and fill
+// hwaveform with it.  errorbar is the error of one count.
+void PTFAnalysis::FillWaveform( const double* sample, double errorbar ){
+  PERF_SCOPE( PerfFill );
+  conditioner->Process( sample, conditioned );
+  hwaveform->Reset();
+  int numTimeBins = hwaveform->GetNbinsX();
+  double err = errorbar * conditioner->error_scale();
+  for ( int ibin=1; ibin <= numTimeBins; ++ibin ){
+    hwaveform->SetBinContent( ibin, conditioned.volts[ibin-1] );
+    hwaveform->SetBinError( ibin, err );
+  }
+}
 
 // Pulse charge calculation (integrated pulse height over bin range {bin_low,bin_high})
 // Optionally arguments: bin_low and bin_high (otherwise checks entire range from 0-8192ns)
 // Note that time in waveform = bin number * 8 ns
-void PTFAnalysis::ChargeSum( float ped, int bin_low, int bin_high ){
+void PTFAnalysis::ChargeSum( int bin_low, int bin_high ){
+    PERF_SCOPE( PerfChargeSum );
     if (bin_high==0) bin_high=hwaveform->GetNbinsX();
-    fitresult->qped = ped;
+    float ped;
     float sum = 0.;
     
-    // Recalculate pedestal per waveform
-    if (bin_high!=0) {
+    if (track_baselines && baseline_tracker->Ready()) {
+        // Tracked pedestal of the channel
+        ped = baseline_tracker->Get();
+        fitresult->qped = ped;
+    } else if (conditioner->has_roi()) {
+        // Only a region of interest is kept, pedestal from the pre-trigger samples
+        ped = conditioned.pedestal;
+        fitresult->qped = ped;
+    } else {
+        // Recalculate pedestal per waveform
         ped=0;
         int ped_range = bin_low-50;
         if (ped_range<10) ped_range=10;
         for (int i=1; i<=ped_range; i++) ped+= hwaveform->GetBinContent(i);
-        ped = ped/(bin_low-50);
+        ped = ped/ped_range;
         fitresult->qped = ped;
     }
     
@@ -39,18 +72,14 @@ void PTFAnalysis::ChargeSum( float ped, int bin_low, int bin_high ){
 }
 
 bool PTFAnalysis::MonitorCut( float cut ){
-  float ped = 0.0;
-  int nbins = 20;
-  for( int ibin = 1; ibin<=nbins; ibin++ ){
-      ped += hwaveform->GetBinContent( ibin )/(float)nbins;
-  }
+  float ped = conditioned.pedestal;
   fitresult->ped = ped;
   float amp = 0.0;
   float mean = 0.0;
-  for( int ibin = 1; ibin<=hwaveform->GetNbinsX(); ibin++ ){
-      if( ped - hwaveform->GetBinContent( ibin ) > amp ){
-          amp = ped - hwaveform->GetBinContent( ibin );
-          mean = (float)ibin - 1.;
+  for( int k = 0; k < conditioned.nsamples; k++ ){
+      if( ped - conditioned.volts[k] > amp ){
+          amp = ped - conditioned.volts[k];
+          mean = (float)k;
       }
   }
   fitresult->amp = amp;
@@ -64,6 +93,7 @@ bool PTFAnalysis::MonitorCut( float cut ){
 }
 
 bool PTFAnalysis::FFTCut(){
+  PERF_SCOPE( PerfFFTCut );
   // Compute the transform
   TVirtualFFT::SetTransform(0);
   //cout << "bin contents: ";
@@ -86,15 +116,18 @@ bool PTFAnalysis::FFTCut(){
     return true;
   }
   else{
+    PERF_COUNT( PerfFFTCutRejects, 1 );
     return false;
   }
 }
 
 bool PTFAnalysis::PulseLocationCut( int cut ){
+  PERF_SCOPE( PerfLocationCut );
   // Cut if min bin in first or last bins
   int nbins = hwaveform->GetNbinsX();
   int minBin = hwaveform->GetMinimumBin();
   if( (minBin >= 1 && minBin <= cut) || (minBin >= nbins-cut+1 && minBin <= nbins) ){
+    PERF_COUNT( PerfLocationCutRejects, 1 );
     return false;
   }
   else{
@@ -151,8 +184,10 @@ double PTFAnalysis::funcEMG(double *x, double *p){
   // p[3]: exponential decay constant
   // p[4]: baseline
   
- double y = p[4] + (p[0]/0.3)*(p[3]/2.)*exp((p[1]+p[2]*p[2]/p[3]/2.-x[0])/(p[3]))*
-    TMath::Erfc((p[1]+p[2]*p[2]/p[3] -x[0])/sqrt(2.)/p[2]);
+  // (p[3]/2.)*exp((p[1]+p[2]*p[2]/p[3]/2.-x[0])/(p[3]))*
+  //   TMath::Erfc((p[1]+p[2]*p[2]/p[3] -x[0])/sqrt(2.)/p[2])
+  static thread_local FastMath::EMG emg;
+  double y = p[4] + (p[0]/0.3)*emg( x[0], p[1], p[2], p[3] );
 
   return y;
 }
@@ -187,14 +222,30 @@ double PTFAnalysis::bessel(double *x, double *p){
     y = p[3];
   }else{
     //y = p[3] + p[2] * (TMath::Sin(xx) / (xx * xx) - TMath::Cos(xx)/xx);
-    y = p[3] + p[2] / pow(xx,p[4]) *
-      ((15/(xx*xx*xx) - 6/xx) * TMath::Sin(xx) / (xx) - ((15/(xx*xx) -1) *TMath::Cos(xx)/xx) );
+    //y = p[3] + p[2] / pow(xx,p[4]) *
+    //  ((15/(xx*xx*xx) - 6/xx) * TMath::Sin(xx) / (xx) - ((15/(xx*xx) -1) *TMath::Cos(xx)/xx) );
+    double inv = 1./xx, inv2 = inv*inv;
+    double s, c;
+    FastMath::SinCos( xx, s, c );
+    y = p[3] + p[2] * FastMath::Pow( xx, -p[4] ) * inv *
+      ( (15*inv2 - 6)*inv*s - (15*inv2 - 1)*c );
   }
   
   return y ;
 }
   
 
+std::map< std::string, TF1* > PTFAnalysis::fitfunctions;
+
+TF1* PTFAnalysis::get_fit_function( const std::string& model, double (*func)(double*, double*),
+                                    double xmin, double xmax, int npar ){
+  auto it = fitfunctions.find( model );
+  if ( it != fitfunctions.end() ) return it->second;
+  TF1* f = new TF1( "mygauss", func, xmin, xmax, npar );
+  fitfunctions[ model ] = f;
+  return f;
+}
+
 void PTFAnalysis::InitializeFitResult( int wavenum, int nwaves, double evt_timestamp) {
   fitresult->Init();
   ScanPoint & scanpoint = scanpoints[ scanpoints.size()-1 ];
@@ -206,334 +257,469 @@ void PTFAnalysis::InitializeFitResult( int wavenum, int nwaves, double evt_times
   fitresult->y         = scanpoint.y();
   fitresult->z         = scanpoint.z();
 }
-double p2_top = 0;
-double p2_bottom = 0;
-double p3_top = 0;
-double p3_bottom = 0;
 
-void PTFAnalysis::FitWaveform( int wavenum, int nwaves, PTF::PMT pmt) {
-  // assumes hwaveform already defined and filled
-  // assumes fit result structure already setup
-  // Fit waveform for main PMT
-  if( pmt.type == PTF::Hamamatsu_R3600_PMT ){
-    // check if we need to build the function to fit
-    if( ffitfunc == nullptr ) ffitfunc = new TF1("mygauss",pmt0_gaussian,0,140,7);
-    ffitfunc->SetParameters( 1.0e-4, 70.0, 5.2, 1.0, 1.0e-3, 0.25, 0.0 );
-    ffitfunc->SetParNames( "Amplitude", "Mean", "Sigma", "Offset",
-      		 "Sine-Amp",  "Sin-Freq", "Sin-Phase" );
-
-    ffitfunc->SetParLimits(0, 0.0, 1.0);
-    ffitfunc->SetParLimits(1, 2.0, 138.0 );
-    ffitfunc->SetParLimits(2, 0.5, 20.0 );
-    ffitfunc->SetParLimits(3, 0.9, 1.1 );
-    ffitfunc->SetParLimits(4, 0.0, 1.1);
-    ffitfunc->SetParLimits(5, 0.2, 0.35);
-    ffitfunc->SetParLimits(6, -TMath::Pi(), TMath::Pi() );
+// Fit waveform for main PTF PMT
+// assumes hwaveform already defined and filled
+// assumes fit result structure already setup
+void PTFAnalysis::FitR3600() {
+  PERF_SCOPE( PerfFit );
+  if( ringing_filter ){
+    FitR3600Filtered();
+    return;
+  }
+  // check if we need to build the function to fit
+  if( ffitfunc == nullptr ) ffitfunc = get_fit_function( "pmt0_gaussian", pmt0_gaussian, 0, 140, 7 );
+  ffitfunc->SetParameters( 1.0e-4, 70.0, 5.2, 1.0, 1.0e-3, 0.25, 0.0 );
+  ffitfunc->SetParNames( "Amplitude", "Mean", "Sigma", "Offset",
+    		 "Sine-Amp",  "Sin-Freq", "Sin-Phase" );
+
+  ffitfunc->SetParLimits(0, 0.0, 1.0);
+  ffitfunc->SetParLimits(1, 2.0, 138.0 );
+  ffitfunc->SetParLimits(2, 0.5, 20.0 );
+  ffitfunc->SetParLimits(3, 0.9, 1.1 );
+  ffitfunc->SetParLimits(4, 0.0, 1.1);
+  ffitfunc->SetParLimits(5, 0.2, 0.35);
+  ffitfunc->SetParLimits(6, -TMath::Pi(), TMath::Pi() );
  
-    // first fit for sine wave:
-    ffitfunc->FixParameter(0,1.0e-4);
-    ffitfunc->FixParameter(1,70.0);
-    ffitfunc->FixParameter(2,5.2);
-    hwaveform->Fit( ffitfunc, "Q", "", 0,60.0);
+  // first fit for sine wave:
+  ffitfunc->FixParameter(0,1.0e-4);
+  ffitfunc->FixParameter(1,70.0);
+  ffitfunc->FixParameter(2,5.2);
+  hwaveform->Fit( ffitfunc, "Q", "", 0,60.0);
+
+  // then fit gaussian
+  ffitfunc->ReleaseParameter(0);
+  ffitfunc->ReleaseParameter(1);
+  ffitfunc->ReleaseParameter(2);
+  ffitfunc->SetParLimits(0, 0.0, 1.1);
+  ffitfunc->SetParLimits(1, 2.0, 138.0 );
+  ffitfunc->SetParLimits(2, 0.5, 20.0 );
+  ffitfunc->FixParameter(3, ffitfunc->GetParameter(3) );
+  ffitfunc->FixParameter(4, ffitfunc->GetParameter(4));
+  ffitfunc->FixParameter(5, ffitfunc->GetParameter(5));
+  ffitfunc->FixParameter(6, ffitfunc->GetParameter(6));
+  hwaveform->Fit( ffitfunc, "Q", "", 40.0, 100.0);
+
+  // then fit sine and gaussian together
+  ffitfunc->ReleaseParameter(3);
+  ffitfunc->ReleaseParameter(4);
+  ffitfunc->ReleaseParameter(5);
+  ffitfunc->ReleaseParameter(6);
+  ffitfunc->SetParLimits(0, 0.0, 1.1);
+  ffitfunc->SetParLimits(1, 2.0, 138.0 );
+  ffitfunc->SetParLimits(2, 0.5, 20.0 );
+  ffitfunc->SetParLimits(3, 0.9, 1.1 );
+  ffitfunc->SetParLimits(4, 0.0, 1.1);
+  ffitfunc->SetParLimits(5, 0.2, 0.35);
+  ffitfunc->SetParLimits(6, -TMath::Pi(), TMath::Pi() );
+  int fitstat = hwaveform->Fit( ffitfunc, "Q", "", 0, 140);
+  PERF_FIT_STATUS( fitstat );
+  // collect fit results
+  fitresult->ped       = ffitfunc->GetParameter(3);
+  fitresult->mean      = ffitfunc->GetParameter(1);
+  fitresult->sigma     = ffitfunc->GetParameter(2);
+  fitresult->amp       = ffitfunc->GetParameter(0);
+  fitresult->sinamp    = ffitfunc->GetParameter(4);
+  fitresult->sinw      = ffitfunc->GetParameter(5);
+  fitresult->sinphi    = ffitfunc->GetParameter(6);
+  fitresult->ped_err   = ffitfunc->GetParError(3);
+  fitresult->mean_err  = ffitfunc->GetParError(1);
+  fitresult->sigma_err = ffitfunc->GetParError(2);
+  fitresult->amp_err   = ffitfunc->GetParError(0);
+  fitresult->sinamp_err= ffitfunc->GetParError(4);
+  fitresult->sinw_err  = ffitfunc->GetParError(5);
+  fitresult->sinphi_err= ffitfunc->GetParError(6);
+  fitresult->chi2      = ffitfunc->GetChisquare();
+  fitresult->ndof      = 30-4;
+  fitresult->prob      = TMath::Prob( ffitfunc->GetChisquare(), 30-4 );
+  fitresult->fitstat   = fitstat;
+}
 
-    // then fit gaussian
-    ffitfunc->ReleaseParameter(0);
-    ffitfunc->ReleaseParameter(1);
-    ffitfunc->ReleaseParameter(2);
-    ffitfunc->SetParLimits(0, 0.0, 1.1);
-    ffitfunc->SetParLimits(1, 2.0, 138.0 );
-    ffitfunc->SetParLimits(2, 0.5, 20.0 );
-    ffitfunc->FixParameter(3, ffitfunc->GetParameter(3) );
-    ffitfunc->FixParameter(4, ffitfunc->GetParameter(4));
-    ffitfunc->FixParameter(5, ffitfunc->GetParameter(5));
-    ffitfunc->FixParameter(6, ffitfunc->GetParameter(6));
-    hwaveform->Fit( ffitfunc, "Q", "", 40.0, 100.0);
-
-    // then fit sine and gaussian together
-    ffitfunc->ReleaseParameter(3);
-    ffitfunc->ReleaseParameter(4);
-    ffitfunc->ReleaseParameter(5);
-    ffitfunc->ReleaseParameter(6);
-    ffitfunc->SetParLimits(0, 0.0, 1.1);
-    ffitfunc->SetParLimits(1, 2.0, 138.0 );
-    ffitfunc->SetParLimits(2, 0.5, 20.0 );
-    ffitfunc->SetParLimits(3, 0.9, 1.1 );
-    ffitfunc->SetParLimits(4, 0.0, 1.1);
-    ffitfunc->SetParLimits(5, 0.2, 0.35);
-    ffitfunc->SetParLimits(6, -TMath::Pi(), TMath::Pi() );
-    int fitstat = hwaveform->Fit( ffitfunc, "Q", "", 0, 140);
-    // collect fit results
-    fitresult->ped       = ffitfunc->GetParameter(3);
-    fitresult->mean      = ffitfunc->GetParameter(1);
-    fitresult->sigma     = ffitfunc->GetParameter(2);
-    fitresult->amp       = ffitfunc->GetParameter(0);
-    fitresult->sinamp    = ffitfunc->GetParameter(4);
-    fitresult->sinw      = ffitfunc->GetParameter(5);
-    fitresult->sinphi    = ffitfunc->GetParameter(6);
-    fitresult->ped_err   = ffitfunc->GetParError(3);
-    fitresult->mean_err  = ffitfunc->GetParError(1);
-    fitresult->sigma_err = ffitfunc->GetParError(2);
-    fitresult->amp_err   = ffitfunc->GetParError(0);
-    fitresult->sinamp_err= ffitfunc->GetParError(4);
-    fitresult->sinw_err  = ffitfunc->GetParError(5);
-    fitresult->sinphi_err= ffitfunc->GetParError(6);
-    fitresult->chi2      = ffitfunc->GetChisquare();
-    fitresult->ndof      = 30-4;
-    fitresult->prob      = TMath::Prob( ffitfunc->GetChisquare(), 30-4 );
-    fitresult->fitstat   = fitstat;
-  }
-  // Simpler analysis for monitor PMT
-  // Fit with simple gaussian
-  // OR find bin furthest from pedestal
-  //else if( pmt == 1 ){
-  //  if( ffitfunc == nullptr ) ffitfunc = new TF1("mygauss",pmt1_gaussian,0,70,4);
-  //  ffitfunc->SetParameters( fitresult->amp, fitresult->mean, 1.0, fitresult->ped );
-  //  ffitfunc->SetParNames( "Amplitude", "Mean", "Sigma", "Offset" );
-
-  //  ffitfunc->SetParLimits(0, 0.0, 8500.0);
-  //  ffitfunc->SetParLimits(1, 0.0, 70.0 );
-  //  ffitfunc->SetParLimits(2, 0.01, 3.0 );
-  //  ffitfunc->SetParLimits(3, 7500.0, 9000.0 );
-
-  //  // then fit gaussian
-  //  int fitstat = hwaveform->Fit( ffitfunc, "Q", "", 30.0, 50.0);
-
-  //  // collect fit results
-  //  fitresult->ped       = ffitfunc->GetParameter(3);
-  //  fitresult->mean      = ffitfunc->GetParameter(1);
-  //  fitresult->sigma     = ffitfunc->GetParameter(2);
-  //  fitresult->amp       = ffitfunc->GetParameter(0);
-  //  fitresult->chi2      = ffitfunc->GetChisquare();
-  //  fitresult->ndof      = 30-4;
-  //  fitresult->prob      = TMath::Prob( ffitfunc->GetChisquare(), 30-4 );
-  //  fitresult->fitstat   = fitstat;
-  //}
-  else if( pmt.type == PTF::PTF_Monitor_PMT ){
-    float ped = 0.0;
-    int nbins = 20;
-    for( int ibin = 1; ibin<=nbins; ibin++ ){
-      ped += hwaveform->GetBinContent( ibin )/(float)nbins;
-    }
-    fitresult->ped = ped;
-    float amp = 0.0;
-    float mean = 0.0;
-    for( int ibin = 1; ibin<=hwaveform->GetNbinsX(); ibin++ ){
-      if( ped - hwaveform->GetBinContent( ibin ) > amp ){
-        amp = ped - hwaveform->GetBinContent( ibin );
-        mean = hwaveform->GetXaxis()->GetBinCenter(ibin);
-      }
+// Fit of the main PTF PMT with the ringing removed first (ringing_filter in
+// the config file), so that only the gaussian and offset are fitted.  The
+// removed ringing is reported in sinamp, sinw and sinphi.
+// Note that hwaveform is left with the ringing subtracted.
+void PTFAnalysis::FitR3600Filtered() {
+  ringing_filter->Apply( hwaveform );
+  const RingingFilter::Ringing & ring = ringing_filter->ringing();
+
+  if( ffitfunc == nullptr ) ffitfunc = get_fit_function( "pmt0_gaussian_filtered", pmt1_gaussian, 0, 140, 4 );
+  double offset = ring.offset;
+  if( offset < 0.9 || offset > 1.1 ) offset = 1.0;
+  ffitfunc->SetParameters( 1.0e-4, 70.0, 5.2, offset );
+  ffitfunc->SetParNames( "Amplitude", "Mean", "Sigma", "Offset" );
+  ffitfunc->SetParLimits(0, 0.0, 1.1);
+  ffitfunc->SetParLimits(1, 2.0, 138.0 );
+  ffitfunc->SetParLimits(2, 0.5, 20.0 );
+  ffitfunc->SetParLimits(3, 0.9, 1.1 );
+  int fitstat = hwaveform->Fit( ffitfunc, "Q", "", 0, 140);
+  PERF_FIT_STATUS( fitstat );
+  // collect fit results
+  fitresult->ped       = ffitfunc->GetParameter(3);
+  fitresult->mean      = ffitfunc->GetParameter(1);
+  fitresult->sigma     = ffitfunc->GetParameter(2);
+  fitresult->amp       = ffitfunc->GetParameter(0);
+  fitresult->sinamp    = ring.amp;
+  fitresult->sinw      = ring.w;
+  fitresult->sinphi    = ring.phi;
+  fitresult->ped_err   = ffitfunc->GetParError(3);
+  fitresult->mean_err  = ffitfunc->GetParError(1);
+  fitresult->sigma_err = ffitfunc->GetParError(2);
+  fitresult->amp_err   = ffitfunc->GetParError(0);
+  fitresult->sinamp_err= ring.amp_err;
+  fitresult->sinw_err  = ring.w_err;
+  fitresult->sinphi_err= ring.phi_err;
+  fitresult->chi2      = ffitfunc->GetChisquare();
+  fitresult->ndof      = 30-4;
+  fitresult->prob      = TMath::Prob( ffitfunc->GetChisquare(), 30-4 );
+  fitresult->fitstat   = fitstat;
+}
+
+// Simpler analysis for monitor PMT
+// Fit with simple gaussian
+// OR find bin furthest from pedestal
+//else if( pmt == 1 ){
+//  if( ffitfunc == nullptr ) ffitfunc = new TF1("mygauss",pmt1_gaussian,0,70,4);
+//  ffitfunc->SetParameters( fitresult->amp, fitresult->mean, 1.0, fitresult->ped );
+//  ffitfunc->SetParNames( "Amplitude", "Mean", "Sigma", "Offset" );
+
+//  ffitfunc->SetParLimits(0, 0.0, 8500.0);
+//  ffitfunc->SetParLimits(1, 0.0, 70.0 );
+//  ffitfunc->SetParLimits(2, 0.01, 3.0 );
+//  ffitfunc->SetParLimits(3, 7500.0, 9000.0 );
+
+//  // then fit gaussian
+//  int fitstat = hwaveform->Fit( ffitfunc, "Q", "", 30.0, 50.0);
+
+//  // collect fit results
+//  fitresult->ped       = ffitfunc->GetParameter(3);
+//  fitresult->mean      = ffitfunc->GetParameter(1);
+//  fitresult->sigma     = ffitfunc->GetParameter(2);
+//  fitresult->amp       = ffitfunc->GetParameter(0);
+//  fitresult->chi2      = ffitfunc->GetChisquare();
+//  fitresult->ndof      = 30-4;
+//  fitresult->prob      = TMath::Prob( ffitfunc->GetChisquare(), 30-4 );
+//  fitresult->fitstat   = fitstat;
+//}
+void PTFAnalysis::FitMonitor() {
+  PERF_SCOPE( PerfFit );
+  float ped = conditioned.pedestal;
+  fitresult->ped = ped;
+  float amp = 0.0;
+  float mean = 0.0;
+  for( int k = 0; k < conditioned.nsamples; k++ ){
+    if( ped - conditioned.volts[k] > amp ){
+      amp = ped - conditioned.volts[k];
+      mean = conditioned.time( k );
     }
-    fitresult->amp = amp;
-    fitresult->mean = mean;
-  }
-  else if( pmt.type == PTF::Reference ){
-    float mean = 0.0;
-    for( int ibin = 1; ibin<=hwaveform->GetNbinsX(); ibin++ ){
-      if( hwaveform->GetBinContent( ibin ) < 0.5 ){
-        mean = hwaveform->GetXaxis()->GetBinCenter(ibin);
-        break;
-      }
+  }
+  fitresult->amp = amp;
+  fitresult->mean = mean;
+}
+
+// Reference PMT: time where the signal goes below 0.5
+void PTFAnalysis::FitReference() {
+  PERF_SCOPE( PerfFit );
+  float mean = 0.0;
+  for( int k = 0; k < conditioned.nsamples; k++ ){
+    if( conditioned.volts[k] < 0.5 ){
+      mean = conditioned.time( k );
+      break;
     }
-    fitresult->mean = mean;
-  }
-  //else if( pmt == PTF::Reference ){
-  //  if( ffitfunc == nullptr ) ffitfunc = new TF1("mygauss",pmt2_piecewise,0,140,4);
-  //  ffitfunc->SetParameters( 30.0, 40., 1.0, 0.1 );
-  //  ffitfunc->SetParNames( "range1", "range2", "amplitude1", "amplitude2" );
-  //  ffitfunc->SetParLimits(0, 10., 60. );
-  //  ffitfunc->SetParLimits(1, 10., 60. );
-  //  ffitfunc->SetParLimits(2, 0.9, 1.1 );
-  //  ffitfunc->SetParLimits(3, 0.0, 0.2 );
-
-  //  // then fit gaussian
-  //  int fitstat = hwaveform->Fit( ffitfunc, "Q", "", 0.0, 140.0);
-
-  //  // collect fit results
-  //  // Set mean to value at 0.5
-  //  double slope = (ffitfunc->GetParameter(2) - ffitfunc->GetParameter(3)) / (ffitfunc->GetParameter(0) - ffitfunc->GetParameter(1));
-  //  double intercept = ffitfunc->GetParameter(2) - slope * ffitfunc->GetParameter(0);
-  //  if( fabs(slope) > 1e-8 )
-  //    fitresult->mean      = (0.5 - intercept) / slope;
-  //  fitresult->chi2      = ffitfunc->GetChisquare();
-  //  fitresult->ndof      = 30-5;
-  //  fitresult->prob      = TMath::Prob( ffitfunc->GetChisquare(), 30-5 );
-  //  fitresult->fitstat   = fitstat;
-  //}
-  else if( pmt.type == PTF::mPMT_REV0_PMT ){ /// Add a new PMT type for the mPMT analysis.
-
-    // Find the mininum bin between 2040.0ns (bin 255) and  2320.0ns (bin 290)
-    double min_bin = 2400;
-    double min_bini = 0;
-    double min_value = 1999.0;
-    //    for(int i = 280; i < 320; i++){
-    for(int i = 250; i < 320; i++){
-      double value = hwaveform->GetBinContent(i);
-      if(value < min_value){
-        min_value = value;
-        min_bin = hwaveform->GetBinCenter(i);
+  }
+  fitresult->mean = mean;
+}
+
+//else if( pmt == PTF::Reference ){
+//  if( ffitfunc == nullptr ) ffitfunc = new TF1("mygauss",pmt2_piecewise,0,140,4);
+//  ffitfunc->SetParameters( 30.0, 40., 1.0, 0.1 );
+//  ffitfunc->SetParNames( "range1", "range2", "amplitude1", "amplitude2" );
+//  ffitfunc->SetParLimits(0, 10., 60. );
+//  ffitfunc->SetParLimits(1, 10., 60. );
+//  ffitfunc->SetParLimits(2, 0.9, 1.1 );
+//  ffitfunc->SetParLimits(3, 0.0, 0.2 );
+
+//  // then fit gaussian
+//  int fitstat = hwaveform->Fit( ffitfunc, "Q", "", 0.0, 140.0);
+
+//  // collect fit results
+//  // Set mean to value at 0.5
+//  double slope = (ffitfunc->GetParameter(2) - ffitfunc->GetParameter(3)) / (ffitfunc->GetParameter(0) - ffitfunc->GetParameter(1));
+//  double intercept = ffitfunc->GetParameter(2) - slope * ffitfunc->GetParameter(0);
+//  if( fabs(slope) > 1e-8 )
+//    fitresult->mean      = (0.5 - intercept) / slope;
+//  fitresult->chi2      = ffitfunc->GetChisquare();
+//  fitresult->ndof      = 30-5;
+//  fitresult->prob      = TMath::Prob( ffitfunc->GetChisquare(), 30-5 );
+//  fitresult->fitstat   = fitstat;
+//}
+
+// mPMT pulse: exponentially modified gaussian fit (EMG true, channels >= 16)
+// or bessel fit (channels < 16).  cfd_baseline (the tracked baseline)
+// replaces the fitted baseline in the CFD time if it is not NaN.
+template< bool EMG >
+void PTFAnalysis::FitMPMT( int channel, double cfd_baseline ) {
+  PERF_SCOPE( PerfFit );
+  // Find the mininum bin between 1992 ns and 2552 ns (bins 250 to 319 of the
+  // full waveform), by time so that it works on a region of interest
+  double min_bin = 2400;
+  double min_bini = 0;
+  double min_value = 1999.0;
+  //    for(int i = 280; i < 320; i++){
+  int search_hi = TimeBin( 2548.0 );
+  for(int i = TimeBin( 1996.0 ); i <= search_hi; i++){
+    double value = hwaveform->GetBinContent(i);
+    if(value < min_value){
+      min_value = value;
+      min_bin = hwaveform->GetBinCenter(i);
 	min_bini = i;
-      }
     }
+  }
 
-    double fit_minx = min_bin - 40.0;
-    double fit_maxx = min_bin + 8.0*2.5;
+  // Baseline from the samples just before the pulse
+  double basebase = 0;
+  int strt = std::max( 1, int(min_bini) - 16 );
+  int stp = std::max( strt + 1, int(min_bini) - 6 );
 
-    int fitstat;
-    double amplitude;
+  for(int ii = strt; ii < stp; ii++){
+    basebase += hwaveform->GetBinContent(ii);
+  }
+  basebase /= double( stp - strt );
+
+  // Try the pulse template first, and only do the full fit if it does not match
+  if( pulse_template && pulse_template->Ready() ){
+    PulseTemplate::Match match = pulse_template->Find( hwaveform, basebase, min_bin );
+    if( match.ndf > 0 && match.chi2 / match.ndf <= pulse_template->params().max_chi2ndf ){
+      fitresult->ped       = pulse_template->Calibrated( 4, match.amp );
+      fitresult->mean      = match.time;
+      fitresult->sigma     = pulse_template->Calibrated( 2, match.amp );
+      fitresult->amp       = pulse_template->Calibrated( 0, match.amp );
+      fitresult->chi2      = match.chi2;
+      fitresult->ndof      = pulse_template->Calibrated( 3, match.amp );
+      fitresult->prob      = TMath::Prob( match.chi2, match.ndf );
+      fitresult->fitstat   = 0;
+      PERF_FIT_STATUS( fitresult->fitstat );
+      fitresult->sinw      = CFDTime( min_bini, std::isnan( cfd_baseline ) ? fitresult->ped : cfd_baseline, min_value );
+      ++template_matched;
+      return;
+    }
+    ++template_fallback;
+  }
 
-    // Get baseline from the settings tree
-    double sbaseline = BrbSettingsTree::Get()->GetBaseline(pmt.channel);
-    
-    // ellipitcall modified gaussian
-    if(pmt.channel >= 16){
-      if( ffitfunc == nullptr ) ffitfunc = new TF1("mygauss",funcEMG,fit_minx-30,fit_maxx+30,5);
-      ffitfunc->SetParameters( fitresult->amp, fitresult->mean, 8.0, 1.0, fitresult->ped );
-      ffitfunc->SetParNames( "Amplitude", "Mean", "Sigma", "exp decay", "Offset" );
-      
-      
-      ffitfunc->SetParameter(1, min_bin );
-      //ffitfunc->SetParameter(2, 13 );
-      //ffitfunc->SetParameter(3, 1 );    
-      //ffitfunc->FixParameter(2, 13 );
-      //ffitfunc->FixParameter(3, 1 );
-      
-      
-      ffitfunc->FixParameter(2, 9.6 );
-      	ffitfunc->SetParameter(3, 15.8 );
-      //ffitfunc->FixParameter(3, 6.0 );
-      
-      
-      amplitude = sbaseline - min_value;
-      ffitfunc->SetParameter(0, amplitude*-10.0);
-      if(pmt.channel >= 0){
-	ffitfunc->SetParameter(0, amplitude*-0.63);
-      }
-      ffitfunc->FixParameter(4, sbaseline);
-      ffitfunc->SetParLimits(0, -1000, 100);
-      ffitfunc->SetParLimits(1, 1800.0, 2600.0 );
-      //ffitfunc->SetParLimits(2, 10.56, 10.58 );
-      //ffitfunc->SetParLimits(3, 0.1, 0.9 );
-      //    ffitfunc->SetParLimits(4, 0.99, 1.01 );
-      
-      // then fit gaussian
-      fitstat = hwaveform->Fit( ffitfunc, "Q", "", fit_minx, fit_maxx);
+  double fit_minx = min_bin - 40.0;
+  double fit_maxx = min_bin + 8.0*2.5;
 
+  int fitstat;
+  double amplitude;
 
-      
+  // Get baseline from the tracker, or the settings tree
+  double sbaseline = TrackedBaseline( BrbSettingsTree::Get()->GetBaseline(channel) );
+  
+  // ellipitcall modified gaussian
+  if( EMG ){
+    if( ffitfunc == nullptr ) ffitfunc = get_fit_function( "funcEMG", funcEMG, fit_minx-30, fit_maxx+30, 5 );
+    ffitfunc->SetParameters( fitresult->amp, fitresult->mean, 8.0, 1.0, fitresult->ped );
+    ffitfunc->SetParNames( "Amplitude", "Mean", "Sigma", "exp decay", "Offset" );
+    
+    
+    ffitfunc->SetParameter(1, min_bin );
+    //ffitfunc->SetParameter(2, 13 );
+    //ffitfunc->SetParameter(3, 1 );    
+    //ffitfunc->FixParameter(2, 13 );
+    //ffitfunc->FixParameter(3, 1 );
+    
+    
+    ffitfunc->FixParameter(2, 9.6 );
+    	ffitfunc->SetParameter(3, 15.8 );
+    //ffitfunc->FixParameter(3, 6.0 );
+    
+    
+    amplitude = sbaseline - min_value;
+    ffitfunc->SetParameter(0, amplitude*-10.0);
+    if(channel >= 0){
+	ffitfunc->SetParameter(0, amplitude*-0.63);
     }
+    ffitfunc->FixParameter(4, sbaseline);
+    ffitfunc->SetParLimits(0, -1000, 100);
+    ffitfunc->SetParLimits(1, 1800.0, 2600.0 );
+    //ffitfunc->SetParLimits(2, 10.56, 10.58 );
+    //ffitfunc->SetParLimits(3, 0.1, 0.9 );
+    //    ffitfunc->SetParLimits(4, 0.99, 1.01 );
+    
+    // then fit gaussian
+    fitstat = hwaveform->Fit( ffitfunc, "Q", "", fit_minx, fit_maxx);
+    PERF_FIT_STATUS( fitstat );
 
-    // Bessel fit
-    if(pmt.channel < 16){
 
-      fit_minx = min_bin - 8*6.5;
-      //fit_maxx = min_bin + 8.0*3.5;
-      fit_maxx = min_bin + 8.0*0.5;
-      
+    
+  }
 
-      if( ffitfunc == nullptr ) ffitfunc = new TF1("mygauss",bessel,fit_minx-32,fit_maxx+36,5);
-      ffitfunc->SetParameters( fitresult->amp, fitresult->mean, 8.0, fitresult->ped );
-      //      ffitfunc->SetParNames( "Amplitude", "Mean", "Sigma", "exp decay", "Offset" );
-      
-      
-      ffitfunc->SetParameter(1, min_bin - 28.0 );
-      //ffitfunc->SetParameter(2, 13 );
-      //ffitfunc->SetParameter(3, 1 );    
-      //ffitfunc->FixParameter(0, 0.113 );
-      //ffitfunc->FixParameter(4, 0.5 );
-      //      ffitfunc->SetParameter(0, 0.113 ); // 1PE
-      //ffitfunc->SetParameter(4, 0.5 ); // 1PE
-      ffitfunc->FixParameter(0, 0.113 ); // 32PE
-      ffitfunc->FixParameter(4, -0.3 ); // 32PE
-            
-      double basebase = 0;
-      int strt = min_bini - 16;
-      int stp = min_bini - 6;
-
-      for(int ii = strt; ii < stp; ii++){
-	basebase += hwaveform->GetBinContent(ii);
-      }
-      basebase /= 10.0;
-      sbaseline = basebase;
-
-      double amplitude = sbaseline - min_value;
-      //      ffitfunc->SetParameter(0, amplitude*-10.0);
-            ffitfunc->SetParameter(2, -5.6* amplitude );
-      //ffitfunc->SetParameter(2, -1.6* amplitude );
-
-      ffitfunc->FixParameter(3, sbaseline);
-      //      ffitfunc->SetParLimits(0, -100, 100);
-      ffitfunc->SetParLimits(1, 1900.0, 2600.0 );
-      //ffitfunc->SetParLimits(2, 10.56, 10.58 );
-      //ffitfunc->SetParLimits(3, 0.1, 0.9 );
-      //    ffitfunc->SetParLimits(4, 0.99, 1.01 );
-      
-      // then fit gaussian
-      int fitstat = hwaveform->Fit( ffitfunc, "Q", "", fit_minx, fit_maxx);
-      
-      if(pmt.channel == 1 && 0) std::cout  << "FF " << ffitfunc->GetParameter(0)<< " "
-				     << ffitfunc->GetParameter(1)<< " "
-				     << ffitfunc->GetParameter(2)<< " "
-				     << amplitude << " " 
-				     << ffitfunc->GetParameter(2)/amplitude << " " 
-				     << ffitfunc->GetParameter(3)<< " "
-				     << ffitfunc->GetParameter(4)<< "   |||||"
-				     << std::endl;
+  // Bessel fit
+  if( !EMG ){
 
-    }
+    fit_minx = min_bin - 8*6.5;
+    //fit_maxx = min_bin + 8.0*3.5;
+    fit_maxx = min_bin + 8.0*0.5;
     
-    if(pmt.channel == 17 && 0)std::cout << "FF " << ffitfunc->GetParameter(0)<< " " 
-					<< ffitfunc->GetParameter(1)<< " " 
-					<< ffitfunc->GetParameter(2)<< " " 
-					<< ffitfunc->GetParameter(3)<< "   |||||" 
-					<< std::endl;
+
+    if( ffitfunc == nullptr ) ffitfunc = get_fit_function( "bessel", bessel, fit_minx-32, fit_maxx+36, 5 );
+    ffitfunc->SetParameters( fitresult->amp, fitresult->mean, 8.0, fitresult->ped );
+    //      ffitfunc->SetParNames( "Amplitude", "Mean", "Sigma", "exp decay", "Offset" );
     
-    if(pmt.channel == 16 && 0){
-      p2_top += ffitfunc->GetParameter(2);
-      p2_bottom += 1.0;
-      p3_top += ffitfunc->GetParameter(3);
-      p3_bottom += 1.0;
-      
-      std::cout << "Amp " << amplitude << " " << ffitfunc->GetParameter(0) 
-		<< " " << ffitfunc->GetParameter(0)/amplitude
-		<< " " << ffitfunc->GetParameter(2) 
-		<< " " << p2_top/p2_bottom 
-		  << " " << ffitfunc->GetParameter(3)
-		<< " " << p3_top/p3_bottom << " "
-		<< std::endl;
-    }
-  
-  
+    
+    ffitfunc->SetParameter(1, min_bin - 28.0 );
+    //ffitfunc->SetParameter(2, 13 );
+    //ffitfunc->SetParameter(3, 1 );    
+    //ffitfunc->FixParameter(0, 0.113 );
+    //ffitfunc->FixParameter(4, 0.5 );
+    //      ffitfunc->SetParameter(0, 0.113 ); // 1PE
+    //ffitfunc->SetParameter(4, 0.5 ); // 1PE
+    ffitfunc->FixParameter(0, 0.113 ); // 32PE
+    ffitfunc->FixParameter(4, -0.3 ); // 32PE
+          
+    sbaseline = basebase;
+
+    double amplitude = sbaseline - min_value;
+    //      ffitfunc->SetParameter(0, amplitude*-10.0);
+          ffitfunc->SetParameter(2, -5.6* amplitude );
+    //ffitfunc->SetParameter(2, -1.6* amplitude );
+
+    ffitfunc->FixParameter(3, sbaseline);
+    //      ffitfunc->SetParLimits(0, -100, 100);
+    ffitfunc->SetParLimits(1, 1900.0, 2600.0 );
+    //ffitfunc->SetParLimits(2, 10.56, 10.58 );
+    //ffitfunc->SetParLimits(3, 0.1, 0.9 );
+    //    ffitfunc->SetParLimits(4, 0.99, 1.01 );
+    
+    // then fit gaussian
+    fitstat = hwaveform->Fit( ffitfunc, "Q", "", fit_minx, fit_maxx);
+    PERF_FIT_STATUS( fitstat );
+  }
+
+  // collect fit results
+  fitresult->ped       = ffitfunc->GetParameter(4);
+  fitresult->mean      = ffitfunc->GetParameter(1);
+  fitresult->sigma     = ffitfunc->GetParameter(2);
+  fitresult->amp       = ffitfunc->GetParameter(0);
+  fitresult->chi2      = ffitfunc->GetChisquare();
+  fitresult->ndof      = ffitfunc->GetParameter(3);
+  fitresult->prob      = TMath::Prob( ffitfunc->GetChisquare(), 30-4 );
+
+  fitresult->fitstat   = fitstat;
+
+
+  // Good fits train the pulse template
+  if( pulse_template && !pulse_template->Ready() && fitstat == 0 &&
+      ffitfunc->GetNDF() > 0 &&
+      ffitfunc->GetChisquare() / ffitfunc->GetNDF() < pulse_template->params().train_chi2ndf &&
+      basebase - min_value >= pulse_template->params().min_height ){
+    pulse_template->Add( hwaveform, basebase, basebase - min_value, ffitfunc->GetParameter(1), min_bin,
+                         ffitfunc->GetParameters(), 5 );
+  }
 
-    // collect fit results
-    fitresult->ped       = ffitfunc->GetParameter(4);
-    fitresult->mean      = ffitfunc->GetParameter(1);
-    fitresult->sigma     = ffitfunc->GetParameter(2);
-    fitresult->amp       = ffitfunc->GetParameter(0);
-    fitresult->chi2      = ffitfunc->GetChisquare();
-    fitresult->ndof      = ffitfunc->GetParameter(3);
-    fitresult->prob      = TMath::Prob( ffitfunc->GetChisquare(), 30-4 );
+  // Do CFD analysis on the fitted pulse
+  fitresult->sinw = CFDTime( min_bini, std::isnan( cfd_baseline ) ? ffitfunc->GetParameter(4) : cfd_baseline, min_value );
+}
 
-    fitresult->fitstat   = fitstat;
+/// Per PMT type parts of the waveform loop in AnalyzeScanPoints.  A policy
+/// has, for one PMT of its type,
+///   void Charge( PTFAnalysis& ana ) const   charge sum of the waveform
+///   bool Select( PTFAnalysis& ana ) const   cuts before the fit, true to fit
+///   void Fit( PTFAnalysis& ana ) const      fit, filling the fit result
+/// Everything that depends on the PMT or the configuration is decided in
+/// the constructor, and the loop is compiled once for each policy, so that
+/// nothing is looked up by type per waveform.  A new type of PMT needs a
+/// policy here and a case in the PTFAnalysis constructor and FitWaveform.
+
+// Charge sum over the whole waveform, pulse location and FFT cuts, for the
+// main PMT (position 0 of the active PMTs)
+struct PTFAnalysis::PolicyBase {
+  PolicyBase( const PTF::PMT & pmt, bool location_cut, bool fft_cut ) :
+    do_charge( pmt.pmt == 0 ),
+    location_cut( location_cut && pmt.pmt == 0 ), fft_cut( fft_cut && pmt.pmt == 0 ) { }
+
+  void Charge( PTFAnalysis & ana ) const { if( do_charge ) ana.ChargeSum( bin_low, bin_high ); }
+  bool Select( PTFAnalysis & ana ) const {
+    if( location_cut && !ana.PulseLocationCut(10) ) return false;
+    if( fft_cut && !ana.FFTCut() ) return false;
+    //if( pmt.pmt == 1 && !ana.MonitorCut( 25. ) ) return false;
+    return true;
+  }
+
+  bool  do_charge;     // do the charge sum
+  int   bin_low{1};    // charge sum bins, bin_high 0 for the whole waveform
+  int   bin_high{0};
+  bool  location_cut;
+  bool  fft_cut;
+};
+
+struct PTFAnalysis::R3600Policy : PolicyBase {
+  R3600Policy( const PTF::PMT & pmt, bool location_cut=false, bool fft_cut=false ) :
+    PolicyBase( pmt, location_cut, fft_cut ) { }
+  void Fit( PTFAnalysis & ana ) const { ana.FitR3600(); }
+};
+
+struct PTFAnalysis::MonitorPolicy : PolicyBase {
+  MonitorPolicy( const PTF::PMT & pmt, bool location_cut=false, bool fft_cut=false ) :
+    PolicyBase( pmt, location_cut, fft_cut ) { }
+  void Fit( PTFAnalysis & ana ) const { ana.FitMonitor(); }
+};
+
+struct PTFAnalysis::ReferencePolicy : PolicyBase {
+  ReferencePolicy( const PTF::PMT & pmt, bool location_cut=false, bool fft_cut=false ) :
+    PolicyBase( pmt, location_cut, fft_cut ) { }
+  void Fit( PTFAnalysis & ana ) const { ana.FitReference(); }
+};
+
+// mPMT channel, fitted with the EMG (EMG true) or the bessel model
+template< bool EMG >
+struct PTFAnalysis::mPMTPolicy : PolicyBase {
+  mPMTPolicy( const PTF::PMT & pmt, bool location_cut=false, bool fft_cut=false ) :
+    PolicyBase( pmt, location_cut, fft_cut ), channel( pmt.channel ) {
+    // Added by Yuka June 2021 for PMT pulse charge calculation
+    // Times of the first and last samples, bins 260-271 and 272-287 of the full waveform
+    if( pmt.pmt == 1 ){ do_charge = true; charge_tmin = 2076.; charge_tmax = 2164.; } //2080 to 2170 ns
+    if( pmt.pmt == 2 ){ do_charge = true; charge_tmin = 2172.; charge_tmax = 2292.; } //2180 to 2300 ns
+  }
+  void Charge( PTFAnalysis & ana ) const {
+    if( charge_tmax <= charge_tmin ) PolicyBase::Charge( ana );
+    else if( do_charge ) ana.ChargeSum( ana.TimeBin( charge_tmin ), ana.TimeBin( charge_tmax ) );
+  }
+  // CFD time from the tracked baseline, or the fitted one without tracking
+  void Fit( PTFAnalysis & ana ) const { ana.FitMPMT< EMG >( channel, ana.TrackedBaseline( NAN ) ); }
 
+  int    channel;
+  double charge_tmin{0.};   // charge sum window (ns), by time so that it works
+  double charge_tmax{0.};   // on a region of interest, whole waveform if not set
+};
+
+// Fit with the model for the PMT type of pmt, outside of the scan loop
+void PTFAnalysis::FitWaveform( int wavenum, int nwaves, PTF::PMT pmt) {
+  switch( pmt.type ){
+  case PTF::Hamamatsu_R3600_PMT: R3600Policy( pmt ).Fit( *this ); break;
+  case PTF::PTF_Monitor_PMT:     MonitorPolicy( pmt ).Fit( *this ); break;
+  case PTF::Reference:           ReferencePolicy( pmt ).Fit( *this ); break;
+  case PTF::mPMT_REV0_PMT:
+    if( pmt.channel >= 16 ) mPMTPolicy< true >( pmt ).Fit( *this );
+    else mPMTPolicy< false >( pmt ).Fit( *this );
+    break;
+  default:
+    cout << "PTFAnalysis::FitWaveForm Error: No fit function for PMT type!" << endl;
+    exit( EXIT_FAILURE );
+  }
+}
 
-    // Do CFD analysis on the fitted pulse
-    double baseline = ffitfunc->GetParameter(4);
-    if(pmt.channel == 0) baseline = 0.991;
-    if(pmt.channel == 1) baseline = 0.9966;
-    double pulse_amplitude = ffitfunc->GetParameter(0) / 3.3;   
-    pulse_amplitude = min_value-baseline;
+// Time where the mPMT pulse crosses half its height above baseline, stepping
+// back from its minimum in bin min_bini.  Returns 0 if there is no crossing.
+double PTFAnalysis::CFDTime( int min_bini, double baseline, double min_value ){
+    double pulse_amplitude = min_value-baseline;
 
     double cfd_threshold = baseline + pulse_amplitude/2.0;
-    if(0)std::cout << "amp " << pulse_amplitude << " " << baseline-min_value
-		   << " " << (baseline-min_value)/0.008 << " "
-		   << (baseline-min_value) / pulse_amplitude << " "
-		   << ffitfunc->GetParameter(2) << " " << ffitfunc->GetParameter(3)
-		   << " " << cfd_threshold 
-		   << " " << std::endl;
-    double crossing_time;
+    double crossing_time = 0;
     // Step back from min_bin
     bool found_cfd = false;
     int ii = min_bini;
+    int last_bin = std::max( 2, TimeBin( 1596.0 ) ); // bin 200 of the full waveform
     double x1=0,x2=0,y1=0,y2=0;
     double m=0, b=0;
     while(!found_cfd){
@@ -556,33 +742,131 @@ void PTFAnalysis::FitWaveform( int wavenum, int nwaves, PTF::PMT pmt) {
       }
 
       ii--;
-      if (ii < 200) found_cfd = true;
+      if (ii < last_bin) found_cfd = true;
 
     }
+    return crossing_time;
+}
+
+// Bin of hwaveform at time t (ns), within the waveform
+int PTFAnalysis::TimeBin( double t ) const {
+  return std::min( std::max( hwaveform->FindBin( t ), 1 ), hwaveform->GetNbinsX() );
+}
 
-    fitresult->sinw = crossing_time;    
-    if(0)std::cout << "CFD: " << pulse_amplitude << " " << baseline << " " 
-	      << cfd_threshold << " " << ii << " " 
-	      << " X1/Y1: " << x1<<":"<<y1 
-	      << " X2/Y2: " << x2<<":"<<y2 
-	      << " crossing : " << m << " " << b << " " << crossing_time 
-	      << std::endl;
+// Baseline of the current waveform from the tracker, when baseline_tracking
+// is on and it has seen a pulse-free waveform, otherwise fallback
+double PTFAnalysis::TrackedBaseline( double fallback ) const {
+  if( track_baselines && baseline_tracker->Ready() ) return baseline_tracker->Get();
+  return fallback;
+}
+
+// Loop over scan points, processing each waveform of pmt with the Policy
+// of its type (see the policies above)
+template< class Policy >
+void PTFAnalysis::AnalyzeScanPoints( Wrapper & wrapper, const PTF::PMT & pmt, const Policy & policy,
+                                     const ScanSettings & settings, TreeOutputPolicy & output_policy ){
+  // Get utilities
+  Utilities utils;
+
+  // Loop over scan points (index i)
+  unsigned long long nfilled = 0;// number of TTree entries so far
+
+  for (unsigned i = 2; i < wrapper.getNumEntries(); i++) {
+    //if ( i>2000 ) continue;
+    if( settings.terminal_output ){
+      cerr << "PTFAnalysis scan point " << i << " / " << wrapper.getNumEntries() << "\u001b[34;1m (" << (((double)i)/wrapper.getNumEntries()*100) << "%)\u001b[0m\033[K";
+      cerr << "\r";
+    }
+    else{
+      if ( i % 10 == 0 ){
+        std::cout << "PTFAnalysis scan point " << i << " / " << wrapper.getNumEntries() << std::endl;
+      }
+    }
+    PERF_BEGIN_SCANPOINT( pmt.pmt, scanpoints.size() );
+    wrapper.setCurrentEntry(i);
     
+    auto location = wrapper.getDataForCurrentEntry(PTF::Gantry1);
+    auto T=wrapper.getReadingTemperature();
+    auto time_F=wrapper.getReadingTime();
+    scanpoints.push_back( ScanPoint( location.x, location.y, location.z,time_F.time_c, T.ext_2, nfilled ) );
     
+    ScanPoint& curscanpoint = scanpoints[ scanpoints.size()-1 ];
+    // loop over the number of waveforms at this ScanPoint (index j)
+    int numWaveforms = wrapper.getNumSamples();
+    curscanpoint.set_nwaveforms( numWaveforms );
+    preview->BeginScanPoint( numWaveforms );
+    early_stop->BeginScanPoint();
+    if ( summary ) summary->BeginScanPoint( scanpoints.size()-1, location.x, location.y, location.z, numWaveforms );
+    for ( int j=0; j<numWaveforms; j++) {
+      //if( j>20 ) continue;
+      if ( !preview->Take( j ) ) continue; // preview mode: only some of the waveforms
+      double* pmtsample=wrapper.getPmtSample( pmt.pmt, j );
+      // set the contents of the histogram
+      FillWaveform( pmtsample, settings.errorbar );
+      baseline_tracker->Update( conditioned );
 
+      double evt_timestamp = wrapper.getEventTimestamp(j);
 
+      InitializeFitResult( j, numWaveforms, evt_timestamp);
+      
+      // Do pulse finding (if requested)
+      if(settings.do_pulse_finding){
+        find_pulses(*pulse_finder, conditioned, fitresult, pmt, TrackedBaseline( NAN ));
+      }else{
+        fitresult->ClearPulses();
+      }
 
-  }
+      // Do simple charge sum calculation
+      policy.Charge( *this );
 
-  
+      // Cuts on the waveform (FFT and pulse location for the main PMT)
+      // If a waveform present then fit it
+      if( settings.dofit && policy.Select( *this ) ){
+        policy.Fit( *this ); // Fit waveform and copy fit results into TTree
+      }
+      fitresult->haswf = utils.HasWaveform( fitresult, pmt.pmt );
+      {
+        PERF_SCOPE( PerfTreeFill );
+        ptf_tree->Fill();
+      }
+      if ( summary ) summary->Fill( *fitresult );
+      PERF_COUNT( PerfWaveforms, 1 );
+      // check if we should save the waveform
+      if ( save_waveforms && snapshot_select->Select( *fitresult ) ){
+        PERF_SCOPE( PerfSaveWaveform );
+        snapshot->Set( nfilled, pmt.channel, *fitresult, hwaveform,
+                       snapshot_select->selection().fft ? hfftm : nullptr );
+        snapshot_tree->Fill();
+      }
+      ++curscanpoint;  // increment counters
+      ++nfilled;
 
-  else{
-    cout << "PTFAnalysis::FitWaveForm Error: No fit function for PMT type!" << endl;
-    exit( EXIT_FAILURE );
+      // the rest of the scan point adds nothing once its estimates converged;
+      // they are left out of ptf_tree, ScanPoint::weight() accounts for them.
+      // A leader has already decided, so that every PMT has the same entries
+      bool stop;
+      if ( early_stop_leader && scanpoints.size() <= early_stop_leader->get_nscanpoints() ){
+        stop = curscanpoint.nentries() >= early_stop_leader->get_nentries( scanpoints.size()-1 );
+      } else {
+        early_stop->Update( fitresult->haswf, fitresult->qsum > -999. ? fitresult->qsum : NAN );
+        stop = early_stop->Converged();
+      }
+      if ( stop ){
+        unsigned long long left = 0;
+        for ( int k = j+1; k < numWaveforms; ++k ) if ( preview->Take( k ) ) ++left;
+        if ( left > 0 ) ++early_stopped;
+        early_skipped += left;
+        break;
+      }
+    }
+    curscanpoint.set_baseline( baseline_tracker->Get(), baseline_tracker->Spread() );
+    output_policy.EndScanPoint( ptf_tree );
+    if ( summary ) summary_tree->Fill();
   }
 }
 
-PTFAnalysis::PTFAnalysis( TFile* outfile, Wrapper & wrapper, double errorbar, PTF::PMT & pmt, string config_file, bool savewf ){
+PTFAnalysis::PTFAnalysis( TFile* outfile, Wrapper & wrapper, double errorbar, PTF::PMT & pmt, string config_file, bool savewf,
+                          const PTFAnalysis * leader ) : early_stop_leader( leader ) {
 
   // Load config file
   Configuration config;
@@ -620,15 +904,22 @@ PTFAnalysis::PTFAnalysis( TFile* outfile, Wrapper & wrapper, double errorbar, PT
     }
   }
 
+  // Pulse finding algorithm and its settings
+  if( do_pulse_finding ){
+    PulseFinderParams finder_params;
+    finder_params.Load( config );
+    pulse_finder = PulseFinderRegistry::Get()->Create( finder_params );
+    std::cout << "Pulse finding with " << pulse_finder->name() << std::endl;
+  }
+
+  // Compression, clustering and basket size of ptf_tree
+  TreeOutputPolicy output_policy;
+  output_policy.Load( config );
+
   static int instance_count =0;
-  int savewf_count =0;
-  int savenowf_count = 0;
   ++instance_count;
   save_waveforms = savewf;
   
-  // Get utilities
-  Utilities utils;
-
   // Get digitizer settings
   Digitizer digi = wrapper.getDigitizerSettings();
   double digiCounts = pow(2.0, digi.resolution);
@@ -637,145 +928,142 @@ PTFAnalysis::PTFAnalysis( TFile* outfile, Wrapper & wrapper, double errorbar, PT
   wrapper.setCurrentEntry(0);
   int  numTimeBins= wrapper.getSampleLength();
   
+  // conditioning of the raw samples, for this channel
+  ConditioningParams conditioning;
+  conditioning.Load( config, pmt.channel );
+  if( conditioning.invert ){
+    cout << "PTFAnalysis Error: condition_invert is set, but the fits and pulse finders need negative pulses!" << endl;
+    exit( EXIT_FAILURE );
+  }
+  conditioner = new WaveformConditioner( conditioning, numTimeBins, 1000./digi.samplingRate, digi.fullScaleRange/digiCounts );
+  std::cout << "Waveform conditioning: " << conditioner->Describe() << std::endl;
+
   // build the waveform histogram
   std::string hname = "hwaveform" + std::to_string(instance_count);
   std::string hname_fft = "hfftm" + std::to_string(instance_count);
   outfile->cd();
-  hwaveform = new TH1D( hname.c_str(), "Pulse waveform; Time (ns); Voltage (V)", numTimeBins, 0., float(numTimeBins)*1000/digi.samplingRate );
-  hfftm = new TH1D( hname_fft.c_str(), "Fast Fourier Transform; Frequency; Coefficient", numTimeBins, -5.0e8, 5.0e8 );
+  // both are booked with the conditioned length, which FFT() keeps
+  hwaveform = new TH1D( hname.c_str(), "Pulse waveform; Time (ns); Voltage (V)",
+                        conditioner->nsamples(), conditioner->tmin(), conditioner->tmax() );
+  hfftm = new TH1D( hname_fft.c_str(), "Fast Fourier Transform; Frequency; Coefficient", conditioner->nsamples(), -5.0e8, 5.0e8 );
   
   // set up the output TTree
   string ptf_tree_name = "ptfanalysis" + std::to_string(pmt.pmt);
+  output_policy.Apply( outfile );
   ptf_tree = new TTree(ptf_tree_name.c_str(), ptf_tree_name.c_str());
   fitresult = new WaveformFitResult();
   fitresult->MakeTTreeBranches( ptf_tree );
+  output_policy.Apply( ptf_tree );
   
-  // Create output directories
-  // Directories for waveforms
-  string wfdir_name = "PMT" + std::to_string(pmt.pmt) + "_Waveforms";
-  string nowfdir_name = "PMT" + std::to_string(pmt.pmt) + "_NoWaveforms";
-  if ( save_waveforms && wfdir==nullptr ) wfdir = outfile->mkdir(wfdir_name.c_str());
-  if ( save_waveforms && nowfdir==nullptr ) nowfdir = outfile->mkdir(nowfdir_name.c_str());
-  // Directories for FFTs
-  string wfdir_fft_name = "FFT" + std::to_string(pmt.pmt) + "_Waveforms";
-  string nowfdir_fft_name = "FFT" + std::to_string(pmt.pmt) + "_NoWaveforms";
-  if ( save_waveforms && wfdir_fft==nullptr ) wfdir_fft = outfile->mkdir(wfdir_fft_name.c_str());
-  if ( save_waveforms && nowfdir_fft==nullptr ) nowfdir_fft = outfile->mkdir(nowfdir_fft_name.c_str());
-  outfile->cd();
-    
-  // Loop over scan points (index i)
-  unsigned long long nfilled = 0;// number of TTree entries so far
+  // per scan point summaries, for making the maps without the ptfanalysis tree
+  ScanPointSummaryParams summary_params;
+  summary_params.Load( config );
+  if ( summary_params.use ){
+    string summary_tree_name = ScanPointSummaryTreeName( pmt.pmt );
+    summary_tree = new TTree( summary_tree_name.c_str(), "summaries of the scan points" );
+    summary = new ScanPointSummary();
+    summary->Book( summary_params );
+    summary->MakeTTreeBranches( summary_tree );
+  }
 
-  for (unsigned i = 2; i < wrapper.getNumEntries(); i++) {
-    //if ( i>2000 ) continue;
-    if( terminal_output ){
-      cerr << "PTFAnalysis scan point " << i << " / " << wrapper.getNumEntries() << "\u001b[34;1m (" << (((double)i)/wrapper.getNumEntries()*100) << "%)\u001b[0m\033[K";
-      cerr << "\r";
-    }
-    else{
-      if ( i % 10 == 0 ){
-        std::cout << "PTFAnalysis scan point " << i << " / " << wrapper.getNumEntries() << std::endl;
-      }
-    }
-    wrapper.setCurrentEntry(i);
-    
-    auto location = wrapper.getDataForCurrentEntry(PTF::Gantry1);
-    auto T=wrapper.getReadingTemperature();
-    auto time_F=wrapper.getReadingTime();
-    scanpoints.push_back( ScanPoint( location.x, location.y, location.z,time_F.time_c, T.ext_2, nfilled ) );
-    
-    ScanPoint& curscanpoint = scanpoints[ scanpoints.size()-1 ];
-    // loop over the number of waveforms at this ScanPoint (index j)
-    int numWaveforms = wrapper.getNumSamples();
-    for ( int j=0; j<numWaveforms; j++) {
-      //if( j>20 ) continue;
-      double* pmtsample=wrapper.getPmtSample( pmt.pmt, j );
-      // set the contents of the histogram
-      hwaveform->Reset();
-      for ( int ibin=1; ibin <= numTimeBins; ++ibin ){
-        hwaveform->SetBinContent( ibin, pmtsample[ibin-1] );
-	    hwaveform->SetBinError( ibin, errorbar );
-      }
-      hwaveform->Scale(digi.fullScaleRange/digiCounts);
+  // baseline of the channel, followed over the scan
+  BaselineTrackerParams baseline_params;
+  baseline_params.Load( config );
+  baseline_tracker = new BaselineTracker( baseline_params );
+  track_baselines = baseline_params.use;
+  if ( track_baselines && conditioning.subtract_baseline ){
+    cout << "PTFAnalysis: condition_subtract_baseline is set, so the tracked baseline is only recorded" << endl;
+    track_baselines = false;
+  }
 
-      double evt_timestamp = (int) wrapper.getEventTimestamp(j);
+  // preview mode, only a subset of the waveforms of each scan point
+  PreviewParams preview_params;
+  preview_params.Load( config );
+  preview = new PreviewSampler( preview_params );
+  if ( preview_params.enabled() ){
+    std::cout << "PTFAnalysis preview: " << preview_params.mode << " subset of " << 100. * preview_params.fraction
+              << "% of the waveforms of each scan point, at least " << preview_params.min_waveforms << std::endl;
+  }
 
-      InitializeFitResult( j, numWaveforms, evt_timestamp);
-      
-      // Do pulse finding (if requested)
-      if(do_pulse_finding){
-        find_pulses(0, hwaveform, fitresult, pmt);
-      }else{
-        fitresult->numPulses = 0;
-      }
+  // sequential early stop of each scan point
+  EarlyStopParams early_stop_params;
+  early_stop_params.Load( config );
+  early_stop = new EarlyStop( early_stop_params );
+  if ( early_stop_params.use ){
+    std::cout << "PTFAnalysis early stop once the efficiency is known to " << early_stop_params.efficiency_width;
+    if ( early_stop_params.charge_width > 0. ) std::cout << " and the mean charge to " << early_stop_params.charge_width;
+    std::cout << " (" << early_stop_params.z << " sigma), after at least " << early_stop_params.min_waveforms << " waveforms" << std::endl;
+  }
 
-//       Do simple charge sum calculation
-        if( pmt.pmt == 0 ) {
-            ChargeSum(0.9931); //original PTF function call here
-        }
-        
-        // Added by Yuka June 2021 for PMT pulse charge calculation
-        if (pmt.type == PTF::mPMT_REV0_PMT) {
-            if (pmt.pmt==1) ChargeSum(1.0034,260,271);    //2080 to 2170 ns
-            if (pmt.pmt==2) ChargeSum(1.00146,272,287);   //2180 to 2300 ns
-        }
-        
-        
-        
-      // For main PMT do FFT and check if there is a waveform
-      // If a waveform present then fit it
-      if( dofit && pulse_location_cut && pmt.pmt == 0 ) dofit = PulseLocationCut(10);
-      if( dofit && fft_cut && pmt.pmt == 0 ) dofit = FFTCut();
-      //if( dofit && pmt.pmt == 1 ) dofit = MonitorCut( 25. );
-      if( dofit ){
-        FitWaveform( j, numWaveforms, pmt ); // Fit waveform and copy fit results into TTree
-      }
-      fitresult->haswf = utils.HasWaveform( fitresult, pmt.pmt );
-      ptf_tree->Fill();
-      if(0)std::cout << "Check save waveform: " << save_waveforms << " " << savewf_count
-<< " " << savenowf_count << " " << curscanpoint.x() << std::endl; 
-      // check if we should clone waveform histograms
-      if ( save_waveforms && savewf_count<500 && savenowf_count<500 ){
-	    if  ( fabs( curscanpoint.x() - 0.46 ) < 0.0005 && 
-	      fabs( curscanpoint.y() - 0.38 ) < 0.0005 ) {
-           //   std::cout << "Success:" << std::endl;
-          std::string hwfname = "hwf_" + std::to_string( nfilled );
-          std::string hfftmname = "hfftm_" + std::to_string( nfilled );
-          if ( fitresult->haswf && savewf_count<1000 ) {
-            wfdir->cd();
-            TH1D* hwf = (TH1D*) hwaveform->Clone( hwfname.c_str() );
-            hwf->SetName( hwfname.c_str() );
-            hwf->SetTitle("HAS a pulse; Time (ns); Voltage (V)");
-            hwf->SetDirectory( wfdir );
-            wfdir_fft->cd();
-            TH1D* hfftm_tmp = (TH1D*) hfftm->Clone( hfftmname.c_str() );
-            hfftm_tmp->SetName( hfftmname.c_str() );
-            hfftm_tmp->SetTitle("HAS a pulse; Frequency; Coefficient");
-            hfftm_tmp->SetDirectory( wfdir_fft );
-            ++savewf_count;	  
-          } else if ( !fitresult->haswf && savenowf_count<1000 ){
-            nowfdir->cd();
-            TH1D* hwf = (TH1D*) hwaveform->Clone( hwfname.c_str() );
-            hwf->SetName( hwfname.c_str() );
-            hwf->SetTitle("Noise pulse; Time (ns); Voltage (V)");
-            hwf->SetDirectory( nowfdir );
-            nowfdir_fft->cd();
-            TH1D* hfftm_tmp = (TH1D*) hfftm->Clone( hfftmname.c_str() );
-            hfftm_tmp->SetName( hfftmname.c_str() );
-            hfftm_tmp->SetTitle("Noise pulse; Frequency; Coefficient");
-            hfftm_tmp->SetDirectory( nowfdir_fft );
-            ++savenowf_count;	  
-          }
-
-	    outfile->cd();
-
-
-        }
+  // ringing suppression ahead of the main PTF PMT fit
+  if ( pmt.type == PTF::Hamamatsu_R3600_PMT ){
+    RingingFilterParams ringing_params;
+    ringing_params.Load( config );
+    if ( ringing_params.use ){
+      ringing_filter = new RingingFilter( ringing_params );
+      std::cout << "Removing ringing before the fit, estimated in " << ringing_params.tmin
+                << " to " << ringing_params.tmax << " ns" << std::endl;
+    }
+  }
 
-      }
-      ++curscanpoint;  // increment counters
-      ++nfilled;
+  // pulse template for the mPMT pulses, built from the first good fits
+  if ( pmt.type == PTF::mPMT_REV0_PMT ){
+    PulseTemplateParams template_params;
+    template_params.Load( config );
+    if ( template_params.use ) pulse_template = new PulseTemplate( template_params, hwaveform->GetBinWidth(1) );
+  }
+
+  // set up the TTree of saved waveforms
+  if ( save_waveforms ){
+    SnapshotSelection selection;
+    selection.Load( config );
+    snapshot_select = new SnapshotSelector( selection );
+    string snapshot_tree_name = "snapshots" + std::to_string(pmt.pmt);
+    snapshot_tree = new TTree(snapshot_tree_name.c_str(), "saved waveforms of ptfanalysis entries");
+    snapshot = new WaveformSnapshot();
+    snapshot->MakeTTreeBranches( snapshot_tree );
+  }
+    
+  // Loop over the scan points with the processing for the type of PMT
+  ScanSettings settings;
+  settings.terminal_output = terminal_output;
+  settings.do_pulse_finding = do_pulse_finding;
+  settings.dofit = dofit;
+  settings.errorbar = errorbar;
+  switch( pmt.type ){
+  case PTF::Hamamatsu_R3600_PMT:
+    AnalyzeScanPoints( wrapper, pmt, R3600Policy( pmt, pulse_location_cut, fft_cut ), settings, output_policy );
+    break;
+  case PTF::PTF_Monitor_PMT:
+    AnalyzeScanPoints( wrapper, pmt, MonitorPolicy( pmt, pulse_location_cut, fft_cut ), settings, output_policy );
+    break;
+  case PTF::Reference:
+    AnalyzeScanPoints( wrapper, pmt, ReferencePolicy( pmt, pulse_location_cut, fft_cut ), settings, output_policy );
+    break;
+  case PTF::mPMT_REV0_PMT:
+    if( pmt.channel >= 16 ){
+      AnalyzeScanPoints( wrapper, pmt, mPMTPolicy< true >( pmt, pulse_location_cut, fft_cut ), settings, output_policy );
+    } else {
+      AnalyzeScanPoints( wrapper, pmt, mPMTPolicy< false >( pmt, pulse_location_cut, fft_cut ), settings, output_policy );
     }
+    break;
+  default:
+    cout << "PTFAnalysis Error: No waveform processing for PMT type " << pmt.type << "!" << endl;
+    exit( EXIT_FAILURE );
+  }
+  if ( track_baselines ){
+    std::cout << "PTFAnalysis tracked baseline " << baseline_tracker->Get() << " V from "
+              << baseline_tracker->accepted() << " waveforms, " << baseline_tracker->rejected()
+              << " skipped with a pre-trigger pulse" << std::endl;
+  }
+  if ( early_stop_params.use ){
+    std::cout << "PTFAnalysis early stop: " << early_stopped << " of " << scanpoints.size()
+              << " scan points stopped early, " << early_skipped << " waveforms skipped" << std::endl;
+  }
+  if ( pulse_template ){
+    std::cout << "PTFAnalysis pulse template " << ( pulse_template->Ready() ? "built" : "not built" )
+              << ": " << template_matched << " waveforms matched, "
+              << template_fallback << " fell back to the fit" << std::endl;
   }
   //cout << endl;
   // Done.
@@ -802,8 +1090,7 @@ const std::vector< double > PTFAnalysis::get_bins( char dim ){
     }
   }
 
-  sort( positions.begin(), positions.end() );
-  positions.erase( unique( positions.begin(), positions.end(), comparison ), positions.end() ); // comparison function may not be necessary but was concerned about the comparison of doubles
+  positions = ScanAxis::Infer( positions ).positions; // sorted, the same within 1e-5
 
   //std::cout << "positions contains:";
   //vector<double>::iterator it;
@@ -40,7 +40,7 @@ PTFQEAnalysis::PTFQEAnalysis( TFile *fout, PTFAnalysis *ptfanalysis ){
     //Loop through fit results
     for(unsigned long long iwavfm=0; iwavfm<scanpoint.nentries(); iwavfm++){
       entry += iwavfm;
-      const WaveformFitResult fit_result = ptfanalysis->get_fitresult(iscan, iwavfm);
+      const WaveformFitResult& fit_result = ptfanalysis->get_fitresult(iscan, iwavfm);
       //if( iwavfm>9 ) continue;
       //cout << fitresult->x << "," << fitresult->y << "," << fitresult->z << " haswf: " << fitresult->haswf << " nwaves: " << fitresult->nwaves << " scan_entries: " << scanpoint.nentries() << endl;
       pmt0_qe->Fill(fit_result.x, fit_result.y, (double)fit_result.haswf/(double)scanpoint.nentries());
@@ -83,7 +83,7 @@ PTFQEAnalysis::PTFQEAnalysis( TFile *fout, PTFAnalysis *ptfanalysis0, PTFAnalysi
     long long entry = scanpoint.get_entry();
     for ( unsigned long long iwavfm = 0; iwavfm < scanpoint.nentries(); ++iwavfm ){
       entry += iwavfm;
-      const WaveformFitResult wf = ptfanalysis0->get_fitresult( iscan, iwavfm);
+      const WaveformFitResult& wf = ptfanalysis0->get_fitresult( iscan, iwavfm);
       pmt0_qe->Fill(wf.x, wf.y, (double)wf.haswf/(double)scanpoint.nentries());
       v_pmt0_qe[iscan] += (double)wf.haswf/(double)scanpoint.nentries();
     }
@@ -101,7 +101,7 @@ PTFQEAnalysis::PTFQEAnalysis( TFile *fout, PTFAnalysis *ptfanalysis0, PTFAnalysi
     long long entry = scanpoint.get_entry();
     for ( unsigned iwavfm = 0; iwavfm < scanpoint.nentries(); ++iwavfm ){
       entry += iwavfm;
-      const WaveformFitResult wf = ptfanalysis1->get_fitresult( iscan, iwavfm);
+      const WaveformFitResult& wf = ptfanalysis1->get_fitresult( iscan, iwavfm);
       pmt1_qe->Fill(wf.x, wf.y, (double)wf.haswf/(double)scanpoint.nentries());
       v_pmt1_qe[iscan] += (double)wf.haswf/(double)scanpoint.nentries();
     }
@@ -0,0 +1,125 @@
+#include "PerfStats.hpp"
+
+#ifdef PTF_PERF
+
+#include "TTree.h"
+
+#include <iostream>
+#include <iomanip>
+
+PerfStats* PerfStats::fInstance = nullptr;
+
+PerfStats* PerfStats::Get(){
+  if ( fInstance == nullptr ) fInstance = new PerfStats();
+  return fInstance;
+}
+
+const char* PerfStats::stage_name( PerfStage s ){
+  static const char* names[ NPerfStages ] = {
+    "read", "fill", "pulsefinding", "chargesum", "locationcut",
+    "fftcut", "fit", "treefill", "savewaveform" };
+  return names[ s ];
+}
+
+const char* PerfStats::counter_name( PerfCounter c ){
+  static const char* names[ NPerfCounters ] = {
+    "waveforms", "fitcalls", "fitfailures", "locationcut_rejects",
+    "fftcut_rejects", "bytesread" };
+  return names[ c ];
+}
+
+void PerfStats::begin_scanpoint( int pmt, int scanpt ){
+  fRecords.push_back( PerfRecord() );
+  fRecords.back().pmt = pmt;
+  fRecords.back().scanpt = scanpt;
+}
+
+void PerfStats::fit_status( int fitstat ){
+  PerfRecord& r = current();
+  ++r.counts[ PerfFitCalls ];
+  if ( fitstat != 0 ) ++r.counts[ PerfFitFailures ];
+  ++fFitStat[ std::make_pair( r.pmt, fitstat ) ];
+}
+
+void PerfStats::print( std::ostream& os ) const {
+  // sum the records for each PMT
+  std::map< int, PerfRecord > totals;
+  for ( const PerfRecord& r : fRecords ){
+    PerfRecord& t = totals[ r.pmt ];
+    t.pmt = r.pmt;
+    for ( int s = 0; s < NPerfStages; ++s ){
+      t.seconds[ s ] += r.seconds[ s ];
+      t.calls[ s ]   += r.calls[ s ];
+    }
+    for ( int c = 0; c < NPerfCounters; ++c ) t.counts[ c ] += r.counts[ c ];
+  }
+
+  os << "==================== PerfStats summary ====================" << std::endl;
+  for ( const auto& it : totals ){
+    const PerfRecord& t = it.second;
+    double total = 0.;
+    for ( int s = 0; s < NPerfStages; ++s ) total += t.seconds[ s ];
+    os << "PMT " << t.pmt << "  (" << total << " s in timed stages)" << std::endl;
+    os << std::setw( 16 ) << "stage" << std::setw( 12 ) << "seconds" << std::setw( 12 ) << "calls"
+       << std::setw( 12 ) << "us/call" << std::setw( 8 ) << "%" << std::endl;
+    for ( int s = 0; s < NPerfStages; ++s ){
+      if ( t.calls[ s ] == 0 ) continue;
+      os << std::setw( 16 ) << stage_name( PerfStage( s ) )
+         << std::setw( 12 ) << t.seconds[ s ]
+         << std::setw( 12 ) << t.calls[ s ]
+         << std::setw( 12 ) << 1.e6 * t.seconds[ s ] / t.calls[ s ]
+         << std::setw( 8 )  << ( total > 0. ? 100. * t.seconds[ s ] / total : 0. ) << std::endl;
+    }
+    for ( int c = 0; c < NPerfCounters; ++c ){
+      os << std::setw( 22 ) << counter_name( PerfCounter( c ) ) << " " << t.counts[ c ] << std::endl;
+    }
+    for ( const auto& fs : fFitStat ){
+      if ( fs.first.first != t.pmt ) continue;
+      os << std::setw( 22 ) << "fitstat" << " " << fs.first.second << ": " << fs.second << std::endl;
+    }
+  }
+  os << "===========================================================" << std::endl;
+}
+
+void PerfStats::write( const std::string& treename ) const {
+  PerfRecord r;
+  TTree * tt = new TTree( treename.c_str(), "per PMT and scan point timings (s) and counts" );
+  tt->Branch( "pmt",    &r.pmt,    "pmt/I" );
+  tt->Branch( "scanpt", &r.scanpt, "scanpt/I" );
+  for ( int s = 0; s < NPerfStages; ++s ){
+    std::string name = std::string( "t_" ) + stage_name( PerfStage( s ) );
+    tt->Branch( name.c_str(), &r.seconds[ s ], ( name + "/D" ).c_str() );
+    name = std::string( "n_" ) + stage_name( PerfStage( s ) );
+    tt->Branch( name.c_str(), &r.calls[ s ], ( name + "/l" ).c_str() );
+  }
+  for ( int c = 0; c < NPerfCounters; ++c ){
+    std::string name = counter_name( PerfCounter( c ) );
+    tt->Branch( name.c_str(), &r.counts[ c ], ( name + "/l" ).c_str() );
+  }
+  for ( const PerfRecord& rec : fRecords ){
+    r = rec;
+    tt->Fill();
+  }
+  tt->Write();
+
+  int pmt, fitstat;
+  unsigned long long n;
+  TTree * tfs = new TTree( ( treename + "_fitstat" ).c_str(), "fit calls per PMT and fitstat" );
+  tfs->Branch( "pmt",     &pmt,     "pmt/I" );
+  tfs->Branch( "fitstat", &fitstat, "fitstat/I" );
+  tfs->Branch( "n",       &n,       "n/l" );
+  for ( const auto& fs : fFitStat ){
+    pmt = fs.first.first;
+    fitstat = fs.first.second;
+    n = fs.second;
+    tfs->Fill();
+  }
+  tfs->Write();
+}
+
+void PerfStats::clear(){
+  fRecords.clear();
+  fFitStat.clear();
+}
+
+#endif // PTF_PERF
@@ -0,0 +1,48 @@
+#include "PreviewSampler.hpp"
+#include "Configuration.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <cstdlib>
+
+
+void PreviewParams::Load( const Configuration& config, const std::string& prefix ){
+  config.Get( prefix+"fraction",      fraction );
+  config.Get( prefix+"mode",          mode );
+  config.Get( prefix+"seed",          seed );
+  config.Get( prefix+"min_waveforms", min_waveforms );
+  if ( fraction <= 0. || fraction > 1. ) fraction = 1.;
+  if ( min_waveforms < 1 ) min_waveforms = 1;
+}
+
+
+PreviewSampler::PreviewSampler( const PreviewParams& par ) : fPar( par ), fRand( par.seed ) {
+  if ( fPar.mode == "random" ) fRandom = true;
+  else if ( fPar.mode != "stride" ){
+    std::cout << "PreviewSampler: unknown preview_mode " << fPar.mode << ", use stride or random" << std::endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
+void PreviewSampler::BeginScanPoint( int nwaveforms ){
+  fN = nwaveforms;
+  fK = fPar.enabled() ? std::max( fPar.min_waveforms, (int)std::ceil( fPar.fraction * fN ) ) : fN;
+  if ( fK > fN ) fK = fN;
+  fTake.assign( fN, 0 );
+  if ( fK == fN ){
+    std::fill( fTake.begin(), fTake.end(), 1 );
+  } else if ( fRandom ){
+    // selection sampling: waveform j is taken with the chance that the
+    // remaining picks fall on it, giving exactly fK
+    int left = fK;
+    for ( int j = 0; j < fN && left > 0; ++j ){
+      if ( fRand.Rndm() * ( fN - j ) < left ){
+        fTake[ j ] = 1;
+        --left;
+      }
+    }
+  } else {
+    for ( int i = 0; i < fK; ++i ) fTake[ (long long)i * fN / fK ] = 1;
+  }
+}
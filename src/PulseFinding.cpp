@@ -1,101 +1,330 @@
+
 #include "PulseFinding.hpp"
 #include <iostream>
 
 #include "BrbSettingsTree.hxx"
+#include "Configuration.hpp"
+#include "PerfStats.hpp"
 
 #include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
 
 
+void PulseFinderParams::Load( const Configuration& config, const std::string& prefix ){
+  config.Get( prefix+"algorithm",        algorithm );
+  config.Get( prefix+"threshold",        threshold );
+  config.Get( prefix+"slope",            slope );
+  config.Get( prefix+"cfd_fraction",     cfd_fraction );
+  config.Get( prefix+"cfd_delay",        cfd_delay );
+  config.Get( prefix+"filter_sigma",     filter_sigma );
+  config.Get( prefix+"filter_threshold", filter_threshold );
+  if ( cfd_delay < 1 ) cfd_delay = 1;
+}
 
-void find_pulses(int algo_type, TH1D *hwaveform, WaveformFitResult *fitresult, PTF::PMT pmt){
-
-  // Reset the number of pulses
-  fitresult->numPulses = 0;
 
-  if(algo_type == 0){
-    simple_threshold_technique(hwaveform, fitresult, pmt);
-  }else{
-    std::cerr << "Invalid pulse finding algorithm = " << algo_type
-              << ". Exiting"<< std::endl;
-    exit(0);
+void PulseFinder::Find( const WaveformBatch& batch, std::vector< PulseList >& pulses ) const {
+  pulses.resize( batch.nwaves );
+  for ( int i = 0; i < batch.nwaves; ++i ){
+    pulses[i].clear();
+    FindOne( batch.wave( i ), batch, pulses[i] );
   }
-  
-  
 }
 
+void PulseFinder::Find( const TH1D* h, double baseline, WaveformFitResult* fitresult ){
+  int nsamples = h->GetNbinsX();
+  fSamples.resize( nsamples );
+  for ( int ib = 1; ib <= nsamples; ++ib ) fSamples[ib-1] = h->GetBinContent( ib );
 
+  WaveformBatch batch;
+  batch.volts = &fSamples[0];
+  batch.nwaves = 1;
+  batch.nsamples = nsamples;
+  batch.sample_ns = h->GetBinWidth( 1 );
+  batch.t0 = h->GetBinLowEdge( 1 );
+  batch.baseline = baseline;
+  Find( batch, fitresult );
+}
 
-void simple_threshold_technique(TH1D *hwaveform, WaveformFitResult *fitresult, PTF::PMT pmt){
-  
-  // Loop over waveform; look for every case of waveform going below fixed threshold
-  
-  double baseline = 1.0;
+void PulseFinder::Find( const WaveformBatch& batch, WaveformFitResult* fitresult ){
+  Find( batch, fPulses );
 
-  // If it is an mPMT channel, the use the baseline from BRB settings tree.
-  if(pmt.type == PTF::mPMT_REV0_PMT){
-    baseline = BrbSettingsTree::Get()->GetBaseline(pmt.channel);
+  fitresult->ClearPulses();
+  for ( const PulseInfo& p : fPulses[0] ){
+    fitresult->AddPulse( p.time, p.timeCFD, p.charge, p.timeErr, p.chargeErr );
   }
+}
+
+void PulseFinder::AddPulse( const double* v, const WaveformBatch& batch, int istart, int imin,
+                            PulseList& pulses, double fraction, double charge ) const {
+  double height = batch.baseline - v[imin];
+  double level = batch.baseline - fraction * height;
+
+  // interpolate where the leading edge crosses the level, from the sample
+  // before the pulse started
+  double cross = istart;
+  for ( int k = std::max( istart-1, 0 ); k < imin; ++k ){
+    if ( v[k] >= level && v[k+1] <= level ){
+      cross = k + ( v[k] - level ) / ( v[k] - v[k+1] );
+      break;
+    }
+  }
+
+  PulseInfo p;
+  p.time      = batch.t0 + ( imin + 1 ) * batch.sample_ns;
+  p.timeCFD   = batch.t0 + ( cross + 1 ) * batch.sample_ns;
+  p.timeErr   = 0.;
+  p.charge    = charge < 0. ? height : charge;
+  p.chargeErr = 0.;
+  pulses.push_back( p );
+}
 
-  double threshold = baseline - 0.004;
-    
-  //if (pmt.channel == 1) threshold = baseline - 0.2;
 
-  int nsamples = hwaveform->GetNbinsX();
+namespace {
 
-  double min_bin = 9999, min_value = 9999; // Find the minimum bin and value for each pulse.
-  bool in_pulse = false; // are we currently in a pulse?
-  int start_bin;
-  int end_bin;
-  for(int ib = 1; ib < nsamples+1; ib++){
-    double sample = hwaveform->GetBinContent(ib);
+  // Pulse from when the waveform goes below baseline - threshold until it
+  // comes back above it
+  class ThresholdPulseFinder : public PulseFinder {
+  public:
+    ThresholdPulseFinder( const PulseFinderParams& par ) : PulseFinder( par ) { }
+    std::string name() const { return "threshold"; }
+  protected:
+    void FindOne( const double* v, const WaveformBatch& batch, PulseList& pulses ) const {
+      double threshold = batch.baseline - fPar.threshold;
+      bool in_pulse = false; // are we currently in a pulse?
+      int start = 0, imin = 0;
+      for ( int k = 0; k < batch.nsamples; ++k ){
+        if ( v[k] < threshold && !in_pulse ){ // found a pulse
+          in_pulse = true;
+          start = k;
+          imin = k;
+        }
+        if ( !in_pulse ) continue;
+        if ( v[k] < v[imin] ) imin = k;
+        if ( v[k] >= threshold ){ // finished this pulse
+          in_pulse = false;
+          AddPulse( v, batch, start, imin, pulses );
+        }
+      }
+    }
+  };
 
-    if(sample < min_value){
-      min_value = sample;
-      min_bin = ib;
+  // Pulse starts on a drop of at least slope over one sample, and is kept if
+  // it reaches threshold before it rises back.  Slow baseline changes do not
+  // make pulses.
+  class SlopePulseFinder : public PulseFinder {
+  public:
+    SlopePulseFinder( const PulseFinderParams& par ) : PulseFinder( par ) { }
+    std::string name() const { return "slope"; }
+  protected:
+    void FindOne( const double* v, const WaveformBatch& batch, PulseList& pulses ) const {
+      double threshold = batch.baseline - fPar.threshold;
+      bool in_pulse = false;
+      int start = 0, imin = 0;
+      for ( int k = 1; k < batch.nsamples; ++k ){
+        if ( !in_pulse ){
+          if ( v[k-1] - v[k] >= fPar.slope ){
+            in_pulse = true;
+            start = k;
+            imin = k;
+          }
+          continue;
+        }
+        if ( v[k] < v[imin] ) imin = k;
+        if ( v[k] > v[k-1] && v[k] >= threshold ){ // rising back above threshold
+          in_pulse = false;
+          if ( v[imin] < threshold ) AddPulse( v, batch, start, imin, pulses );
+        }
+      }
+    }
+  };
+
+  // Threshold pulses, timed with a constant fraction discriminator: the
+  // pulse scaled by cfd_fraction minus the pulse delayed by cfd_delay
+  // samples crosses zero at the same point of the leading edge for any
+  // pulse height.
+  class CFDPulseFinder : public PulseFinder {
+  public:
+    CFDPulseFinder( const PulseFinderParams& par ) : PulseFinder( par ) { }
+    std::string name() const { return "cfd"; }
+  protected:
+    void FindOne( const double* v, const WaveformBatch& batch, PulseList& pulses ) const {
+      double threshold = batch.baseline - fPar.threshold;
+      int delay = fPar.cfd_delay;
+      double f = fPar.cfd_fraction;
+      double base = batch.baseline;
+      // bipolar signal, positive on the leading edge of the pulse
+      auto cfd = [&]( int k ){
+        double d = base - v[k];
+        double dd = k >= delay ? base - v[k-delay] : 0.;
+        return f * d - dd;
+      };
+      bool in_pulse = false;
+      int start = 0, imin = 0;
+      for ( int k = 0; k < batch.nsamples; ++k ){
+        if ( v[k] < threshold && !in_pulse ){
+          in_pulse = true;
+          start = k;
+          imin = k;
+        }
+        if ( !in_pulse ) continue;
+        if ( v[k] < v[imin] ) imin = k;
+        if ( v[k] >= threshold ){
+          in_pulse = false;
+          size_t n = pulses.size();
+          AddPulse( v, batch, start, imin, pulses, f );
+          // zero crossing of the bipolar signal from positive to negative
+          int last = std::min( imin + delay, batch.nsamples - 1 );
+          for ( int j = std::max( start, 1 ); j <= last; ++j ){
+            double s0 = cfd( j-1 ), s1 = cfd( j );
+            if ( s0 > 0. && s1 <= 0. ){
+              pulses[n].timeCFD = batch.t0 + ( j + s0 / ( s0 - s1 ) ) * batch.sample_ns;
+              break;
+            }
+          }
+        }
+      }
     }
-    
-    if(sample < threshold && !in_pulse){ // found a pulse
-      in_pulse = true;
-      start_bin = ib;
+  };
+
+  // Waveform filtered with a gaussian of filter_sigma, normalised so that
+  // it gives the height of a gaussian pulse of that width.  Pulses are
+  // where the filtered waveform is above filter_threshold, with the
+  // filtered height as charge, which is less noisy than the single lowest
+  // sample for small pulses.
+  class MatchedPulseFinder : public PulseFinder {
+  public:
+    MatchedPulseFinder( const PulseFinderParams& par ) : PulseFinder( par ) { }
+    std::string name() const { return "matched"; }
+
+    using PulseFinder::Find;
+    void Find( const WaveformBatch& batch, std::vector< PulseList >& pulses ) const {
+      // build the filter once for the batch
+      double sigma = fPar.filter_sigma / batch.sample_ns;
+      int half = std::max( 1, int( 3. * sigma ) );
+      fKernel.resize( 2*half + 1 );
+      double norm = 0.;
+      for ( int j = -half; j <= half; ++j ){
+        fKernel[j+half] = std::exp( -0.5 * j * j / ( sigma * sigma ) );
+        norm += fKernel[j+half] * fKernel[j+half];
+      }
+      for ( double& h : fKernel ) h /= norm;
+      fFiltered.resize( batch.nsamples );
+      PulseFinder::Find( batch, pulses );
     }
-    
-    if(sample >= threshold && in_pulse){ // finished this pulse
-      in_pulse = false;
-      end_bin = ib;
-      double left_bin;
-      double right_bin;
-      double left_value;
-      double right_value;
-      if(fitresult->numPulses < MAX_PULSES){
-	double mid_value = baseline - (baseline - min_value) / 2;
-	for(int bin = start_bin; bin < end_bin; bin++){
-	  double left_check = hwaveform->GetBinContent(bin);
-	  double right_check = hwaveform->GetBinContent(bin+1);
-	  if((left_check >= mid_value) && (right_check <= mid_value)){
-	    left_bin = bin;
-	    right_bin = bin+1;
-	    left_value = left_check;
-	    right_value = right_check;
-	    break;
-	  }
-	}
-	double slope = (right_value - left_value) / (right_bin - left_bin);
-        double y_int = left_value - slope*left_bin;
-        double mid_bin = (mid_value - y_int) / slope;
-	fitresult->pulseTimesCFD[fitresult->numPulses] = mid_bin * 8.0;
-        fitresult->pulseTimes[fitresult->numPulses] = min_bin * 8.0;
-        fitresult->pulseCharges[fitresult->numPulses] = baseline - min_value;
-
-          //if(0)std::cout << "Pulse found : " << fitresult->numPulses << " " << min_bin
-          //          << " " << min_value << " " << std::endl;
-          fitresult->numPulses++;
+
+  protected:
+    void FindOne( const double* v, const WaveformBatch& batch, PulseList& pulses ) const {
+      int n = batch.nsamples;
+      int half = fKernel.size() / 2;
+      for ( int k = 0; k < n; ++k ){
+        double y = 0.;
+        int jlo = std::max( -half, -k ), jhi = std::min( half, n - 1 - k );
+        for ( int j = jlo; j <= jhi; ++j ) y += fKernel[j+half] * ( batch.baseline - v[k+j] );
+        fFiltered[k] = y;
+      }
+      bool in_pulse = false;
+      int start = 0, kmax = 0;
+      for ( int k = 0; k < n; ++k ){
+        if ( fFiltered[k] > fPar.filter_threshold && !in_pulse ){
+          in_pulse = true;
+          start = k;
+          kmax = k;
+        }
+        if ( !in_pulse ) continue;
+        if ( fFiltered[k] > fFiltered[kmax] ) kmax = k;
+        if ( fFiltered[k] <= fPar.filter_threshold ){
+          in_pulse = false;
+          // lowest sample near the filter maximum
+          int imin = kmax;
+          for ( int j = std::max( 0, kmax - half ); j <= std::min( n - 1, kmax + half ); ++j ){
+            if ( v[j] < v[imin] ) imin = j;
+          }
+          AddPulse( v, batch, std::min( start, imin ), imin, pulses, 0.5, fFiltered[kmax] );
+        }
       }
-      min_bin = 9999, min_value = 9999;
     }
-    
+
+  private:
+    mutable std::vector< double > fKernel;   // for the current batch
+    mutable std::vector< double > fFiltered; // filtered waveform
+  };
+
+  template< class T >
+  PulseFinder* make_finder( const PulseFinderParams& par ){ return new T( par ); }
+
+}
+
+
+PulseFinderRegistry* PulseFinderRegistry::singleton_ = nullptr;
+
+PulseFinderRegistry* PulseFinderRegistry::Get(){
+  if ( singleton_ == nullptr ) singleton_ = new PulseFinderRegistry();
+  return singleton_;
+}
+
+PulseFinderRegistry::PulseFinderRegistry(){
+  Register( "threshold", make_finder< ThresholdPulseFinder > );
+  Register( "slope",     make_finder< SlopePulseFinder > );
+  Register( "cfd",       make_finder< CFDPulseFinder > );
+  Register( "matched",   make_finder< MatchedPulseFinder > );
+}
+
+void PulseFinderRegistry::Register( const std::string& name, Factory factory ){
+  fFactories[ name ] = factory;
+}
+
+PulseFinder* PulseFinderRegistry::Create( const PulseFinderParams& par ) const {
+  auto it = fFactories.find( par.algorithm );
+  if ( it == fFactories.end() ){
+    std::cerr << "Invalid pulse finding algorithm = " << par.algorithm << ", known:";
+    for ( auto& f : fFactories ) std::cerr << " " << f.first;
+    std::cerr << ". Exiting" << std::endl;
+    exit( EXIT_FAILURE );
   }
+  return it->second( par );
+}
 
-  //  if(fitresult->numPulses){ std::cout << "number of pulses found: " << fitresult->numPulses << " " << std::endl;}
-  
+std::vector< std::string > PulseFinderRegistry::Names() const {
+  std::vector< std::string > names;
+  for ( auto& f : fFactories ) names.push_back( f.first );
+  return names;
 }
 
+
+void find_pulses( PulseFinder& finder, TH1D *hwaveform, WaveformFitResult *fitresult, PTF::PMT pmt ){
+  PERF_SCOPE( PerfPulseFinding );
+
+  double baseline = 1.0;
+
+  // If it is an mPMT channel, the use the baseline from BRB settings tree.
+  if(pmt.type == PTF::mPMT_REV0_PMT){
+    baseline = BrbSettingsTree::Get()->GetBaseline(pmt.channel);
+  }
+
+  finder.Find( hwaveform, baseline, fitresult );
+}
+
+void find_pulses( PulseFinder& finder, const ConditionedWaveform& wf, WaveformFitResult *fitresult, PTF::PMT pmt,
+                  double baseline ){
+  PERF_SCOPE( PerfPulseFinding );
+
+  WaveformBatch batch;
+  batch.volts = wf.volts.data();
+  batch.nwaves = 1;
+  batch.nsamples = wf.nsamples;
+  batch.sample_ns = wf.sample_ns;
+  batch.t0 = wf.t0;
+  if( wf.baseline_subtracted ){
+    batch.baseline = wf.pedestal;
+  } else if( !std::isnan( baseline ) ){
+    batch.baseline = baseline;
+  } else if( pmt.type == PTF::mPMT_REV0_PMT ){
+    batch.baseline = BrbSettingsTree::Get()->GetBaseline(pmt.channel);
+  } else {
+    batch.baseline = 1.0;
+  }
+
+  finder.Find( batch, fitresult );
+}
@@ -0,0 +1,160 @@
+#include "PulseTemplate.hpp"
+#include "Configuration.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+void PulseTemplateParams::Load( const Configuration& config, const std::string& prefix ){
+  config.Get( "use_pulse_template",        use );
+  config.Get( prefix+"training_pulses",    training_pulses );
+  config.Get( prefix+"oversample",         oversample );
+  config.Get( prefix+"tmin",               tmin );
+  config.Get( prefix+"tmax",               tmax );
+  config.Get( prefix+"search",             search );
+  config.Get( prefix+"train_chi2ndf",      train_chi2ndf );
+  config.Get( prefix+"min_height",         min_height );
+  config.Get( prefix+"max_chi2ndf",        max_chi2ndf );
+  if ( oversample < 1 ) oversample = 1;
+  if ( training_pulses < 1 ) training_pulses = 1;
+}
+
+PulseTemplate::PulseTemplate( const PulseTemplateParams& par, double sample_ns ) :
+  fPar( par ), fStep( sample_ns / par.oversample ) {
+  int n = int( ( fPar.tmax - fPar.tmin ) / fStep ) + 1;
+  fSum.assign( n, 0. );
+  fCount.assign( n, 0 );
+}
+
+void PulseTemplate::Add( const TH1D* h, double baseline, double height, double t0, double tpeak,
+                         const double* pars, int npars ){
+  if ( fReady || height <= 0. ) return;
+  for ( int ibin = 1; ibin <= h->GetNbinsX(); ++ibin ){
+    double rel = h->GetBinCenter( ibin ) - t0;
+    if ( rel < fPar.tmin || rel > fPar.tmax ) continue;
+    int k = int( std::floor( ( rel - fPar.tmin ) / fStep + 0.5 ) );
+    if ( k >= (int)fSum.size() ) continue;
+    fSum[k] += ( baseline - h->GetBinContent( ibin ) ) / height;
+    ++fCount[k];
+  }
+  fPeakOffset += t0 - tpeak;
+
+  if ( fSy.empty() ) fSy.assign( npars, 0. ), fSxy.assign( npars, 0. );
+  fSx  += height;
+  fSxx += height * height;
+  for ( int i = 0; i < npars && i < (int)fSy.size(); ++i ){
+    fSy[i]  += pars[i];
+    fSxy[i] += pars[i] * height;
+  }
+
+  if ( ++fNum >= fPar.training_pulses ) Build();
+}
+
+void PulseTemplate::Build(){
+  int n = fSum.size();
+  fShape.assign( n, 0. );
+
+  // average, and fill points no training sample landed on from their neighbours
+  int last = -1;
+  for ( int k = 0; k < n; ++k ){
+    if ( fCount[k] == 0 ) continue;
+    fShape[k] = fSum[k] / fCount[k];
+    if ( last < 0 ){
+      for ( int j = 0; j < k; ++j ) fShape[j] = fShape[k];
+    } else {
+      for ( int j = last + 1; j < k; ++j ){
+        fShape[j] = fShape[last] + ( fShape[k] - fShape[last] ) * ( j - last ) / double( k - last );
+      }
+    }
+    last = k;
+  }
+  for ( int j = last + 1; last >= 0 && j < n; ++j ) fShape[j] = fShape[last];
+
+  double peak = 0.;
+  for ( double s : fShape ) if ( s > peak ) peak = s;
+  if ( peak > 0. ) for ( double& s : fShape ) s /= peak;
+
+  fPeakOffset /= fNum;
+
+  // straight lines of the fit parameters against amplitude
+  int npars = fSy.size();
+  fIntercept.assign( npars, 0. );
+  fSlope.assign( npars, 0. );
+  double det = fNum * fSxx - fSx * fSx;
+  for ( int i = 0; i < npars; ++i ){
+    if ( std::fabs( det ) > 1e-12 * fSxx * fNum ){
+      fSlope[i] = ( fNum * fSxy[i] - fSx * fSy[i] ) / det;
+    }
+    fIntercept[i] = ( fSy[i] - fSlope[i] * fSx ) / fNum;
+  }
+
+  std::vector< double >().swap( fSum );
+  std::vector< int >().swap( fCount );
+  fReady = true;
+}
+
+double PulseTemplate::Eval( double t ) const {
+  double u = ( t - fPar.tmin ) / fStep;
+  int k = int( std::floor( u ) );
+  if ( k < 0 || k + 1 >= (int)fShape.size() ) return 0.;
+  double f = u - k;
+  return fShape[k] * ( 1. - f ) + fShape[k+1] * f;
+}
+
+double PulseTemplate::Calibrated( int ipar, double amp ) const {
+  if ( ipar < 0 || ipar >= (int)fSlope.size() ) return 0.;
+  return fIntercept[ipar] + fSlope[ipar] * amp;
+}
+
+PulseTemplate::Match PulseTemplate::Find( const TH1D* h, double baseline, double tpeak ) const {
+  Match m;
+  double tguess = tpeak + fPeakOffset;
+
+  // samples covered by the template at any lag of the search
+  std::vector< double > t, d, w;
+  int ilo = std::max( 1, h->FindBin( tguess - fPar.search + fPar.tmin ) );
+  int ihi = std::min( h->GetNbinsX(), h->FindBin( tguess + fPar.search + fPar.tmax ) );
+  double sdd = 0.;
+  for ( int ibin = ilo; ibin <= ihi; ++ibin ){
+    double err = h->GetBinError( ibin );
+    t.push_back( h->GetBinCenter( ibin ) );
+    d.push_back( baseline - h->GetBinContent( ibin ) );
+    w.push_back( err > 0. ? 1. / ( err * err ) : 1. );
+    sdd += w.back() * d.back() * d.back();
+  }
+  int n = t.size();
+  m.ndf = n - 2;
+  if ( n < 3 ) return m;
+
+  // least squares amplitude and chi2 for the template at time tau
+  auto match = [&]( double tau, double& amp ){
+    double sds = 0., sss = 0.;
+    for ( int i = 0; i < n; ++i ){
+      double s = Eval( t[i] - tau );
+      sds += w[i] * d[i] * s;
+      sss += w[i] * s * s;
+    }
+    amp = sss > 0. ? sds / sss : 0.;
+    return sdd - amp * sds;
+  };
+
+  int nlag = 2 * int( fPar.search / fStep ) + 1;
+  double tau0 = tguess - fStep * ( nlag / 2 );
+  std::vector< double > chi2( nlag );
+  int best = 0;
+  double amp;
+  for ( int j = 0; j < nlag; ++j ){
+    chi2[j] = match( tau0 + j * fStep, amp );
+    if ( chi2[j] < chi2[best] ) best = j;
+  }
+
+  // parabola through the best lag and its neighbours
+  double tau = tau0 + best * fStep;
+  if ( best > 0 && best < nlag - 1 ){
+    double denom = chi2[best-1] - 2. * chi2[best] + chi2[best+1];
+    if ( denom > 0. ) tau += 0.5 * fStep * ( chi2[best-1] - chi2[best+1] ) / denom;
+  }
+  m.chi2 = match( tau, amp );
+  m.time = tau;
+  m.amp = amp;
+  return m;
+}
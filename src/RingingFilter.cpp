@@ -0,0 +1,112 @@
+#include "RingingFilter.hpp"
+#include "Configuration.hpp"
+#include "FastMath.hpp"
+
+#include <cmath>
+#include <vector>
+
+
+void RingingFilterParams::Load( const Configuration& config, const std::string& prefix ){
+  config.Get( prefix+"filter", use );
+  config.Get( prefix+"tmin",   tmin );
+  config.Get( prefix+"tmax",   tmax );
+  config.Get( prefix+"wmin",   wmin );
+  config.Get( prefix+"wmax",   wmax );
+  config.Get( prefix+"nfreq",  nfreq );
+  if ( nfreq < 3 ) nfreq = 3;
+}
+
+
+double RingingFilter::Project( const TH1D* h, int bmin, int bmax, double w, double* coef, double* inv ) const {
+  // normal equations for the basis 1, sin( w t ), cos( w t )
+  double m00 = 0., m01 = 0., m02 = 0., m11 = 0., m12 = 0., m22 = 0.;
+  double r0 = 0., r1 = 0., r2 = 0., yy = 0.;
+  for ( int ib = bmin; ib <= bmax; ++ib ){
+    double s, c;
+    FastMath::SinCos( w * h->GetBinCenter( ib ), s, c );
+    double y = h->GetBinContent( ib );
+    m00 += 1.;  m01 += s;    m02 += c;
+    m11 += s*s; m12 += s*c;  m22 += c*c;
+    r0 += y;    r1 += y*s;   r2 += y*c;
+    yy += y*y;
+  }
+  // inverse by cofactors
+  double c00 = m11*m22 - m12*m12, c01 = m02*m12 - m01*m22, c02 = m01*m12 - m02*m11;
+  double c11 = m00*m22 - m02*m02, c12 = m01*m02 - m00*m12, c22 = m00*m11 - m01*m01;
+  double det = m00*c00 + m01*c01 + m02*c02;
+  if ( det == 0. ) return yy;
+  double a0 = ( c00*r0 + c01*r1 + c02*r2 ) / det;
+  double a1 = ( c01*r0 + c11*r1 + c12*r2 ) / det;
+  double a2 = ( c02*r0 + c12*r1 + c22*r2 ) / det;
+  if ( coef ){ coef[0] = a0; coef[1] = a1; coef[2] = a2; }
+  if ( inv ){
+    inv[0] = c00/det; inv[1] = c01/det; inv[2] = c02/det;
+    inv[3] = c01/det; inv[4] = c11/det; inv[5] = c12/det;
+    inv[6] = c02/det; inv[7] = c12/det; inv[8] = c22/det;
+  }
+  return yy - ( a0*r0 + a1*r1 + a2*r2 );
+}
+
+bool RingingFilter::Estimate( const TH1D* h ){
+  fRing = Ringing();
+  int bmin = 0, bmax = -1;
+  for ( int ib = 1; ib <= h->GetNbinsX(); ++ib ){
+    double t = h->GetBinCenter( ib );
+    if ( t < fPar.tmin || t >= fPar.tmax ) continue;
+    if ( bmin == 0 ) bmin = ib;
+    bmax = ib;
+  }
+  int n = bmax - bmin + 1;
+  if ( bmin == 0 || n < 4 ) return false;
+
+  // coarse scan of the frequency
+  double dw = ( fPar.wmax - fPar.wmin ) / ( fPar.nfreq - 1 );
+  std::vector< double > chi2( fPar.nfreq );
+  int kbest = 0;
+  for ( int k = 0; k < fPar.nfreq; ++k ){
+    chi2[k] = Project( h, bmin, bmax, fPar.wmin + k*dw );
+    if ( chi2[k] < chi2[kbest] ) kbest = k;
+  }
+
+  // parabola through the smallest chi2 and its neighbours
+  double w = fPar.wmin + kbest*dw;
+  double curv = 0.;
+  if ( kbest > 0 && kbest < fPar.nfreq-1 ){
+    double cm = chi2[kbest-1], c0 = chi2[kbest], cp = chi2[kbest+1];
+    double d2 = cm - 2.*c0 + cp;
+    if ( d2 > 0. ){
+      w -= 0.5 * dw * ( cp - cm ) / d2;
+      curv = d2 / ( dw*dw );
+    }
+  }
+
+  double coef[3], inv[9];
+  double chi2min = Project( h, bmin, bmax, w, coef, inv );
+  double sigma2 = n > 3 ? chi2min / ( n - 3 ) : 0.;
+
+  // offset + a sin + b cos = offset + amp sin( w t + phi )
+  double a = coef[1], b = coef[2];
+  double amp = std::sqrt( a*a + b*b );
+  fRing.amp    = amp;
+  fRing.w      = w;
+  fRing.phi    = std::atan2( b, a );
+  fRing.offset = coef[0];
+  fRing.offset_err = std::sqrt( sigma2 * inv[0] );
+  if ( amp > 0. ){
+    double vaa = sigma2 * inv[4], vbb = sigma2 * inv[8], vab = sigma2 * inv[5];
+    fRing.amp_err = std::sqrt( std::fabs( a*a*vaa + b*b*vbb + 2.*a*b*vab ) ) / amp;
+    fRing.phi_err = std::sqrt( std::fabs( b*b*vaa + a*a*vbb - 2.*a*b*vab ) ) / ( amp*amp );
+  }
+  // chi2 rises by sigma2 one error away from the minimum
+  if ( curv > 0. ) fRing.w_err = std::sqrt( 2. * sigma2 / curv );
+  return true;
+}
+
+void RingingFilter::Subtract( TH1D* h ) const {
+  if ( fRing.amp <= 0. ) return;
+  for ( int ib = 1; ib <= h->GetNbinsX(); ++ib ){
+    double s, c;
+    FastMath::SinCos( fRing.w * h->GetBinCenter( ib ) + fRing.phi, s, c );
+    h->SetBinContent( ib, h->GetBinContent( ib ) - fRing.amp * s );
+  }
+}
@@ -0,0 +1,374 @@
+#include "ScanIndex.hpp"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TBranch.h"
+#include "TObjArray.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <sys/stat.h>
+
+using std::cout;
+using std::endl;
+
+
+namespace {
+
+  // size and modification time of a file
+  bool stat_file( const std::string& path, ScanIndexSource& source ){
+    struct stat st;
+    if ( stat( path.c_str(), &st ) != 0 ) return false;
+    source.size = st.st_size;
+    source.mtime = st.st_mtime;
+    return true;
+  }
+
+}
+
+bool ScanIndex::CurrentSource( const std::string& rawfile, const std::string& treeName, ScanIndexSource& source ){
+  source = ScanIndexSource();
+  source.tree = treeName;
+  if ( !stat_file( rawfile, source ) ) return false;
+  // only the tree header is read
+  TFile * f = new TFile( rawfile.c_str(), "READ" );
+  if ( !f->IsOpen() ){
+    delete f;
+    return false;
+  }
+  TTree * tree = nullptr;
+  f->GetObject( treeName.c_str(), tree );
+  bool ok = tree != nullptr;
+  if ( ok ) source.entries = tree->GetEntries();
+  f->Close();
+  delete f;
+  return ok;
+}
+
+bool ScanIndex::Build( const std::string& rawfile, const std::string& treeName ){
+  TFile * f = new TFile( rawfile.c_str(), "READ" );
+  if ( !f->IsOpen() ){
+    cout << "ScanIndex: could not open " << rawfile << endl;
+    delete f;
+    return false;
+  }
+  TTree * tree = nullptr;
+  f->GetObject( treeName.c_str(), tree );
+  if ( tree == nullptr ){
+    cout << "ScanIndex: no " << treeName << " in " << rawfile << endl;
+    delete f;
+    return false;
+  }
+
+  // only the metadata branches are read
+  ScanIndexEntry cur;
+  tree->SetBranchStatus( "*", 0 );
+  auto attach = [&]( const char* name, void* address ){
+    TBranch * br = tree->GetBranch( name );
+    if ( br == nullptr ) return false;
+    tree->SetBranchStatus( name, 1 );
+    br->SetAddress( address );
+    return true;
+  };
+  char name[64];
+  GantryData* gantries[2] = { &cur.gantry0, &cur.gantry1 };
+  for ( int g = 0; g < 2; ++g ){
+    snprintf( name, 64, GANTRY_FORMAT_X, g );     attach( name, &gantries[g]->x );
+    snprintf( name, 64, GANTRY_FORMAT_Y, g );     attach( name, &gantries[g]->y );
+    snprintf( name, 64, GANTRY_FORMAT_Z, g );     attach( name, &gantries[g]->z );
+    snprintf( name, 64, GANTRY_FORMAT_THETA, g ); attach( name, &gantries[g]->theta );
+    snprintf( name, 64, GANTRY_FORMAT_PHI, g );   attach( name, &gantries[g]->phi );
+  }
+  attach( "timestamp", &cur.timestamp );
+  attach( "ext2_temp", &cur.ext2_temp );
+  if ( !attach( "num_points", &cur.num_points ) ){
+    cout << "ScanIndex: no num_points branch in " << rawfile << endl;
+    delete f;
+    return false;
+  }
+
+  fSource = rawfile;
+  fSourceInfo = ScanIndexSource();
+  fSourceInfo.tree = treeName;
+  fSourceInfo.entries = tree->GetEntries();
+  stat_file( rawfile, fSourceInfo );
+  fEntries.clear();
+  unsigned long long n = tree->GetEntries();
+  fEntries.reserve( n );
+  for ( unsigned long long i = 0; i < n; ++i ){
+    tree->GetEntry( i );
+    cur.entry = i;
+    fEntries.push_back( cur );
+  }
+
+  // baskets of every branch, the last one only if it was written out
+  fBaskets.clear();
+  TObjArray * branches = tree->GetListOfBranches();
+  for ( int ib = 0; ib < branches->GetEntriesFast(); ++ib ){
+    TBranch * br = (TBranch*)branches->At( ib );
+    BranchBaskets b;
+    b.name = br->GetName();
+    long long * first = br->GetBasketEntry();
+    int * bytes = br->GetBasketBytes();
+    int nbaskets = std::min( br->GetWriteBasket() + 1, br->GetMaxBaskets() );
+    for ( int k = 0; k < nbaskets; ++k ){
+      long long seek = br->GetBasketSeek( k );
+      if ( seek == 0 ) continue;
+      b.basket.push_back( k );
+      b.first_entry.push_back( first[k] );
+      b.seek.push_back( seek );
+      b.bytes.push_back( bytes[k] );
+    }
+    fBaskets.push_back( b );
+  }
+
+  f->Close();
+  delete f;
+  SortByTime();
+  return true;
+}
+
+bool ScanIndex::Write( const std::string& indexfile ) const {
+  TFile * f = new TFile( indexfile.c_str(), "RECREATE" );
+  if ( !f->IsOpen() ){
+    cout << "ScanIndex: could not create " << indexfile << endl;
+    delete f;
+    return false;
+  }
+  ScanIndexEntry e;
+  TTree * t = new TTree( "scan_index", fSource.c_str() );
+  t->Branch( "entry",         &e.entry,         "entry/l" );
+  t->Branch( "gantry0_x",     &e.gantry0.x,     "gantry0_x/D" );
+  t->Branch( "gantry0_y",     &e.gantry0.y,     "gantry0_y/D" );
+  t->Branch( "gantry0_z",     &e.gantry0.z,     "gantry0_z/D" );
+  t->Branch( "gantry0_rot",   &e.gantry0.theta, "gantry0_rot/D" );
+  t->Branch( "gantry0_tilt",  &e.gantry0.phi,   "gantry0_tilt/D" );
+  t->Branch( "gantry1_x",     &e.gantry1.x,     "gantry1_x/D" );
+  t->Branch( "gantry1_y",     &e.gantry1.y,     "gantry1_y/D" );
+  t->Branch( "gantry1_z",     &e.gantry1.z,     "gantry1_z/D" );
+  t->Branch( "gantry1_rot",   &e.gantry1.theta, "gantry1_rot/D" );
+  t->Branch( "gantry1_tilt",  &e.gantry1.phi,   "gantry1_tilt/D" );
+  t->Branch( "timestamp",     &e.timestamp,     "timestamp/D" );
+  t->Branch( "ext2_temp",     &e.ext2_temp,     "ext2_temp/D" );
+  t->Branch( "num_points",    &e.num_points,    "num_points/l" );
+  for ( const ScanIndexEntry& entry : fEntries ){
+    e = entry;
+    t->Fill();
+  }
+
+  char branch[256];
+  int basket, bytes;
+  unsigned long long first_entry;
+  long long seek;
+  TTree * tb = new TTree( "scan_baskets", "baskets of the scan_tree branches" );
+  tb->Branch( "branch",      branch,       "branch/C" );
+  tb->Branch( "basket",      &basket,      "basket/I" );
+  tb->Branch( "first_entry", &first_entry, "first_entry/l" );
+  tb->Branch( "seek",        &seek,        "seek/L" );
+  tb->Branch( "bytes",       &bytes,       "bytes/I" );
+  for ( const BranchBaskets& b : fBaskets ){
+    snprintf( branch, 256, "%s", b.name.c_str() );
+    for ( unsigned k = 0; k < b.seek.size(); ++k ){
+      basket = b.basket[k];
+      first_entry = b.first_entry[k];
+      seek = b.seek[k];
+      bytes = b.bytes[k];
+      tb->Fill();
+    }
+  }
+
+  char tree[256];
+  ScanIndexSource s = fSourceInfo;
+  snprintf( tree, 256, "%s", s.tree.c_str() );
+  TTree * ts = new TTree( "scan_source", "raw run the index was built from" );
+  ts->Branch( "tree",    tree,       "tree/C" );
+  ts->Branch( "entries", &s.entries, "entries/l" );
+  ts->Branch( "size",    &s.size,    "size/L" );
+  ts->Branch( "mtime",   &s.mtime,   "mtime/L" );
+  ts->Fill();
+
+  f->Write();
+  f->Close();
+  delete f;
+  return true;
+}
+
+bool ScanIndex::Read( const std::string& indexfile ){
+  TFile * f = new TFile( indexfile.c_str(), "READ" );
+  if ( !f->IsOpen() ){
+    cout << "ScanIndex: could not open " << indexfile << endl;
+    delete f;
+    return false;
+  }
+  TTree * t = nullptr;
+  TTree * tb = nullptr;
+  f->GetObject( "scan_index", t );
+  f->GetObject( "scan_baskets", tb );
+  if ( t == nullptr || tb == nullptr ){
+    cout << "ScanIndex: " << indexfile << " is not a scan index" << endl;
+    delete f;
+    return false;
+  }
+
+  ScanIndexEntry e;
+  t->SetBranchAddress( "entry",        &e.entry );
+  t->SetBranchAddress( "gantry0_x",    &e.gantry0.x );
+  t->SetBranchAddress( "gantry0_y",    &e.gantry0.y );
+  t->SetBranchAddress( "gantry0_z",    &e.gantry0.z );
+  t->SetBranchAddress( "gantry0_rot",  &e.gantry0.theta );
+  t->SetBranchAddress( "gantry0_tilt", &e.gantry0.phi );
+  t->SetBranchAddress( "gantry1_x",    &e.gantry1.x );
+  t->SetBranchAddress( "gantry1_y",    &e.gantry1.y );
+  t->SetBranchAddress( "gantry1_z",    &e.gantry1.z );
+  t->SetBranchAddress( "gantry1_rot",  &e.gantry1.theta );
+  t->SetBranchAddress( "gantry1_tilt", &e.gantry1.phi );
+  t->SetBranchAddress( "timestamp",    &e.timestamp );
+  t->SetBranchAddress( "ext2_temp",    &e.ext2_temp );
+  t->SetBranchAddress( "num_points",   &e.num_points );
+  fSource = t->GetTitle();
+  fEntries.clear();
+  unsigned long long n = t->GetEntries();
+  fEntries.reserve( n );
+  for ( unsigned long long i = 0; i < n; ++i ){
+    t->GetEntry( i );
+    fEntries.push_back( e );
+  }
+
+  char branch[256];
+  int basket, bytes;
+  unsigned long long first_entry;
+  long long seek;
+  tb->SetBranchAddress( "branch",      branch );
+  tb->SetBranchAddress( "basket",      &basket );
+  tb->SetBranchAddress( "first_entry", &first_entry );
+  tb->SetBranchAddress( "seek",        &seek );
+  tb->SetBranchAddress( "bytes",       &bytes );
+  fBaskets.clear();
+  unsigned long long nb = tb->GetEntries();
+  for ( unsigned long long i = 0; i < nb; ++i ){
+    tb->GetEntry( i );
+    if ( fBaskets.empty() || fBaskets.back().name != branch ){
+      fBaskets.push_back( BranchBaskets() );
+      fBaskets.back().name = branch;
+    }
+    fBaskets.back().basket.push_back( basket );
+    fBaskets.back().first_entry.push_back( first_entry );
+    fBaskets.back().seek.push_back( seek );
+    fBaskets.back().bytes.push_back( bytes );
+  }
+
+  // indexes written before the source was recorded have none, and never
+  // match their run
+  fSourceInfo = ScanIndexSource();
+  TTree * ts = nullptr;
+  f->GetObject( "scan_source", ts );
+  if ( ts != nullptr && ts->GetEntries() > 0 ){
+    char tree[256];
+    ts->SetBranchAddress( "tree",    tree );
+    ts->SetBranchAddress( "entries", &fSourceInfo.entries );
+    ts->SetBranchAddress( "size",    &fSourceInfo.size );
+    ts->SetBranchAddress( "mtime",   &fSourceInfo.mtime );
+    ts->GetEntry( 0 );
+    fSourceInfo.tree = tree;
+  }
+
+  f->Close();
+  delete f;
+  SortByTime();
+  return true;
+}
+
+bool ScanIndex::Open( const std::string& rawfile, const std::string& treeName ){
+  std::string indexfile = FileName( rawfile );
+  if ( std::ifstream( indexfile.c_str() ).good() ){
+    ScanIndexSource current;
+    if ( Read( indexfile ) && CurrentSource( rawfile, treeName, current ) && current == fSourceInfo ) return true;
+    cout << "ScanIndex: " << indexfile << " does not match " << rawfile << ", rebuilding it" << endl;
+  } else {
+    cout << "ScanIndex: building " << indexfile << endl;
+  }
+  if ( !Build( rawfile, treeName ) ) return false;
+  // the index is still usable if it can not be saved (e.g. read only data)
+  Write( indexfile );
+  return true;
+}
+
+std::string ScanIndex::FileName( const std::string& rawfile ){
+  const std::string ext = ".root";
+  if ( rawfile.size() > ext.size() && rawfile.compare( rawfile.size() - ext.size(), ext.size(), ext ) == 0 )
+    return rawfile.substr( 0, rawfile.size() - ext.size() ) + ".index.root";
+  return rawfile + ".index.root";
+}
+
+unsigned long long ScanIndex::total_points() const {
+  unsigned long long n = 0;
+  for ( const ScanIndexEntry& e : fEntries ) n += e.num_points;
+  return n;
+}
+
+
+std::vector< unsigned long long > ScanIndex::InBox( PTF::Gantry g, double xmin, double xmax, double ymin, double ymax,
+                                                    double zmin, double zmax ) const {
+  std::vector< unsigned long long > result;
+  for ( const ScanIndexEntry& e : fEntries ){
+    const GantryData& p = e.gantry( g );
+    if ( p.x >= xmin && p.x <= xmax && p.y >= ymin && p.y <= ymax && p.z >= zmin && p.z <= zmax )
+      result.push_back( e.entry );
+  }
+  return result;
+}
+
+std::vector< unsigned long long > ScanIndex::InCircle( PTF::Gantry g, double x, double y, double r ) const {
+  std::vector< unsigned long long > result;
+  for ( const ScanIndexEntry& e : fEntries ){
+    const GantryData& p = e.gantry( g );
+    double dx = p.x - x, dy = p.y - y;
+    if ( dx * dx + dy * dy <= r * r ) result.push_back( e.entry );
+  }
+  return result;
+}
+
+void ScanIndex::SortByTime(){
+  fByTime.clear();
+  for ( const ScanIndexEntry& e : fEntries ) if ( std::isfinite( e.timestamp ) ) fByTime.push_back( e.entry );
+  std::stable_sort( fByTime.begin(), fByTime.end(), [this]( unsigned long long a, unsigned long long b ){
+      return fEntries[a].timestamp < fEntries[b].timestamp; } );
+}
+
+std::vector< unsigned long long > ScanIndex::InTimeWindow( double t0, double t1 ) const {
+  auto before = [this]( unsigned long long e, double t ){ return fEntries[e].timestamp < t; };
+  auto begin = std::lower_bound( fByTime.begin(), fByTime.end(), t0, before );
+  auto end   = std::lower_bound( begin, fByTime.end(), t1, before );
+  std::vector< unsigned long long > result( begin, end );
+  std::sort( result.begin(), result.end() );
+  return result;
+}
+
+unsigned long long ScanIndex::NearestInTime( double t ) const {
+  if ( fByTime.empty() ) return fEntries.size();
+  auto before = [this]( unsigned long long e, double tt ){ return fEntries[e].timestamp < tt; };
+  auto it = std::lower_bound( fByTime.begin(), fByTime.end(), t, before );
+  if ( it == fByTime.end() ) return fByTime.back();
+  if ( it != fByTime.begin() && t - fEntries[ *(it-1) ].timestamp < fEntries[ *it ].timestamp - t ) --it;
+  return *it;
+}
+
+
+std::vector< BasketLocation > ScanIndex::Baskets( unsigned long long entry ) const {
+  std::vector< BasketLocation > result;
+  for ( const BranchBaskets& b : fBaskets ){
+    auto it = std::upper_bound( b.first_entry.begin(), b.first_entry.end(), entry );
+    if ( it == b.first_entry.begin() ) continue;
+    int k = ( it - b.first_entry.begin() ) - 1;
+    result.push_back( BasketLocation{ b.name, b.basket[k], b.first_entry[k], b.seek[k], b.bytes[k] } );
+  }
+  return result;
+}
+
+std::vector< std::string > ScanIndex::BasketBranches() const {
+  std::vector< std::string > names;
+  for ( const BranchBaskets& b : fBaskets ) names.push_back( b.name );
+  return names;
+}
@@ -22,8 +22,8 @@ ScanPoint::ScanPoint( double x, double y, double z,double time_1,double t_ext2,
 }
 
 void WriteScanPoints( const std::vector< ScanPoint > & scanpoints ){
-  float X,Y,Z,Time_1,T_ext2;
-  unsigned long long Entry,Entries;
+  float X,Y,Z,Time_1,T_ext2,Baseline,BaselineSpread;
+  unsigned long long Entry,Entries,Waveforms;
 
   TTree * tt = new TTree( "scanpoints", "scanpoints" );
   tt->Branch( "X",       &X,       "X/F" );
@@ -35,6 +35,9 @@ void WriteScanPoints( const std::vector< ScanPoint > & scanpoints ){
   tt->Branch( "T_ext2",       &T_ext2,       "T_ext2/F" );
   tt->Branch( "Entry",   &Entry,   "Entry/l" );
   tt->Branch( "Entries", &Entries, "Entries/l" );
+  tt->Branch( "Waveforms", &Waveforms, "Waveforms/l" );
+  tt->Branch( "Baseline",       &Baseline,       "Baseline/F" );
+  tt->Branch( "BaselineSpread", &BaselineSpread, "BaselineSpread/F" );
 
   for ( const ScanPoint& sp : scanpoints ){
     X=sp.x();
@@ -47,6 +50,9 @@ void WriteScanPoints( const std::vector< ScanPoint > & scanpoints ){
 	
     Entry=sp.get_entry();
     Entries=sp.nentries();
+    Waveforms=sp.nwaveforms();
+    Baseline=sp.baseline();
+    BaselineSpread=sp.baseline_spread();
     //    std::cout<<"Filling TTree with "<<sp<<std::endl;
     tt->Fill();
   }
@@ -55,8 +61,8 @@ void WriteScanPoints( const std::vector< ScanPoint > & scanpoints ){
 
 std::vector< ScanPoint > ReadScanPoints( TFile * fin ){
   std::vector< ScanPoint > result;
-  float X,Y,Z,Time_1,T_ext2;
-  unsigned long long Entry,Entries;
+  float X,Y,Z,Time_1,T_ext2,Baseline=0.,BaselineSpread=0.;
+  unsigned long long Entry,Entries,Waveforms=0;
 
   TTree * tt = (TTree*)fin->Get("scanpoints");
   if ( tt == nullptr ) {
@@ -72,11 +78,20 @@ std::vector< ScanPoint > ReadScanPoints( TFile * fin ){
   tt->SetBranchAddress( "T_ext2", &T_ext2 );
   tt->SetBranchAddress( "Entry", &Entry );
   tt->SetBranchAddress( "Entries", &Entries );
+  // waveforms recorded are only in files written since the preview mode
+  if ( tt->GetBranch( "Waveforms" ) ) tt->SetBranchAddress( "Waveforms", &Waveforms );
+  // baselines are only in files written since they were tracked
+  if ( tt->GetBranch( "Baseline" ) ){
+    tt->SetBranchAddress( "Baseline", &Baseline );
+    tt->SetBranchAddress( "BaselineSpread", &BaselineSpread );
+  }
 
   unsigned long long n = tt->GetEntries();
   for ( unsigned long long i = 0 ; i < n ; ++i ){
     tt->GetEvent( i );
     result.push_back( ScanPoint( X, Y, Z,Time_1,T_ext2 , Entry, Entries ) );
+    result.back().set_baseline( Baseline, BaselineSpread );
+    result.back().set_nwaveforms( Waveforms );
   }
   return result;
 }
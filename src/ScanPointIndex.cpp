@@ -0,0 +1,174 @@
+#include "ScanPointIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+ScanAxis ScanAxis::Infer( std::vector< double > values, double tolerance ){
+  ScanAxis axis;
+  std::sort( values.begin(), values.end() );
+  for ( double v : values ){
+    if ( axis.positions.empty() || std::fabs( v - axis.positions.back() ) >= tolerance ) axis.positions.push_back( v );
+  }
+  if ( axis.positions.empty() ) return axis;
+
+  unsigned n = axis.positions.size();
+  axis.origin = axis.positions[0];
+  if ( n > 1 ){
+    std::vector< double > spacing;
+    for ( unsigned i = 1; i < n; ++i ) spacing.push_back( axis.positions[i] - axis.positions[i-1] );
+    std::nth_element( spacing.begin(), spacing.begin() + spacing.size()/2, spacing.end() );
+    axis.step = spacing[ spacing.size()/2 ];
+  }
+
+  axis.regular = axis.step > 0.;
+  for ( unsigned i = 0; i < n && axis.regular; ++i ){
+    if ( std::fabs( axis.positions[i] - ( axis.origin + i * axis.step ) ) >= tolerance ) axis.regular = false;
+  }
+
+  double half = n > 1 ? axis.step / 2 : tolerance;
+  axis.edges.push_back( axis.positions[0] - half );
+  for ( unsigned i = 1; i < n; ++i ) axis.edges.push_back( ( axis.positions[i-1] + axis.positions[i] ) / 2 );
+  axis.edges.push_back( axis.positions[n-1] + half );
+  return axis;
+}
+
+ScanAxis ScanAxis::Regular( double origin, double step, int n ){
+  std::vector< double > values;
+  for ( int i = 0; i < n; ++i ) values.push_back( origin + i * step );
+  return Infer( values, std::fabs( step ) / 2 );
+}
+
+int ScanAxis::FindBin( double v ) const {
+  if ( positions.empty() || !( v >= edges.front() && v < edges.back() ) ) return -1;
+  if ( regular ){ // straight from the step, the edges are half way between
+    int bin = int( std::floor( ( v - edges.front() ) / step ) );
+    return std::max( 0, std::min( size() - 1, bin ) );
+  }
+  return int( std::upper_bound( edges.begin(), edges.end(), v ) - edges.begin() ) - 1;
+}
+
+int ScanAxis::Nearest( double v ) const {
+  if ( positions.empty() ) return -1;
+  int i = int( std::lower_bound( positions.begin(), positions.end(), v ) - positions.begin() );
+  if ( i == size() ) return i - 1;
+  if ( i > 0 && v - positions[i-1] < positions[i] - v ) return i - 1;
+  return i;
+}
+
+
+namespace {
+
+  bool is_parked( double x, double y ){ return x < 1e-5 && y < 1e-5; } // (0,0,0), see Utilities::get_bins
+
+  const std::vector< unsigned > no_scanpoints;
+
+}
+
+ScanPointIndex::ScanPointIndex( const std::vector< ScanPoint >& scanpoints, double tolerance ) : fTolerance( tolerance ) {
+  std::vector< double > xs, ys;
+  for ( const ScanPoint& sp : scanpoints ){
+    fX.push_back( sp.x() );
+    fY.push_back( sp.y() );
+    if ( is_parked( sp.x(), sp.y() ) ) continue;
+    xs.push_back( sp.x() );
+    ys.push_back( sp.y() );
+  }
+  fXAxis = ScanAxis::Infer( xs, tolerance );
+  fYAxis = ScanAxis::Infer( ys, tolerance );
+
+  fCells.resize( fXAxis.size() * fYAxis.size() );
+  for ( unsigned i = 0; i < size(); ++i ){
+    if ( is_parked( fX[i], fY[i] ) ){
+      fXBin.push_back( -1 );
+      fYBin.push_back( -1 );
+      fParked.push_back( i );
+      continue;
+    }
+    fXBin.push_back( fXAxis.Nearest( fX[i] ) );
+    fYBin.push_back( fYAxis.Nearest( fY[i] ) );
+    fCells[ fXBin[i] + fXAxis.size() * fYBin[i] ].push_back( i );
+  }
+}
+
+const std::vector< unsigned >& ScanPointIndex::InCell( int ix, int iy ) const {
+  if ( ix < 0 || ix >= fXAxis.size() || iy < 0 || iy >= fYAxis.size() ) return no_scanpoints;
+  return fCells[ ix + fXAxis.size() * iy ];
+}
+
+unsigned ScanPointIndex::Nearest( double x, double y ) const {
+  unsigned best = size();
+  double best_d2 = std::numeric_limits< double >::infinity();
+  auto consider = [&]( unsigned i ){
+    double d2 = ( fX[i] - x ) * ( fX[i] - x ) + ( fY[i] - y ) * ( fY[i] - y );
+    if ( d2 < best_d2 || ( d2 == best_d2 && i < best ) ){ best_d2 = d2; best = i; }
+  };
+  for ( unsigned i : fParked ) consider( i );
+
+  // rings of cells around the nearest cell, until the next ring is further
+  // away than the nearest scan point found
+  int nx = fXAxis.size(), ny = fYAxis.size();
+  if ( nx == 0 || ny == 0 ) return best;
+  int ix0 = fXAxis.Nearest( x ), iy0 = fYAxis.Nearest( y );
+  int maxring = std::max( std::max( ix0, nx - 1 - ix0 ), std::max( iy0, ny - 1 - iy0 ) );
+  for ( int d = 0; d <= maxring; ++d ){
+    double reach = std::numeric_limits< double >::infinity(); // how close ring d comes to (x,y)
+    if ( ix0 - d >= 0 ) reach = std::min( reach, std::fabs( x - fXAxis.positions[ ix0 - d ] ) );
+    if ( ix0 + d < nx ) reach = std::min( reach, std::fabs( x - fXAxis.positions[ ix0 + d ] ) );
+    if ( iy0 - d >= 0 ) reach = std::min( reach, std::fabs( y - fYAxis.positions[ iy0 - d ] ) );
+    if ( iy0 + d < ny ) reach = std::min( reach, std::fabs( y - fYAxis.positions[ iy0 + d ] ) );
+    reach -= fTolerance; // the points of a cell are within the tolerance of its positions
+    if ( reach > 0. && reach * reach > best_d2 ) break;
+    for ( int iy = iy0 - d; iy <= iy0 + d; ++iy ){
+      int step = ( iy == iy0 - d || iy == iy0 + d ) ? 1 : 2 * d; // only the edge of the ring
+      for ( int ix = ix0 - d; ix <= ix0 + d; ix += std::max( step, 1 ) ){
+        for ( unsigned i : InCell( ix, iy ) ) consider( i );
+      }
+    }
+  }
+  return best;
+}
+
+std::vector< unsigned > ScanPointIndex::InBox( double xmin, double xmax, double ymin, double ymax ) const {
+  std::vector< unsigned > result;
+  for ( unsigned i : fParked ){
+    if ( fX[i] >= xmin && fX[i] <= xmax && fY[i] >= ymin && fY[i] <= ymax ) result.push_back( i );
+  }
+  int nx = fXAxis.size(), ny = fYAxis.size();
+  if ( nx > 0 && ny > 0 && xmin <= xmax && ymin <= ymax ){
+    // cells of the positions in the box, and one more each side for the
+    // points within the tolerance of a position just outside it
+    auto first = []( const ScanAxis& a, double v ){
+      return std::max( 0, int( std::lower_bound( a.positions.begin(), a.positions.end(), v ) - a.positions.begin() ) - 1 );
+    };
+    auto last = []( const ScanAxis& a, double v ){
+      return std::min( a.size() - 1, int( std::upper_bound( a.positions.begin(), a.positions.end(), v ) - a.positions.begin() ) );
+    };
+    int ixlo = first( fXAxis, xmin ), ixhi = last( fXAxis, xmax );
+    int iylo = first( fYAxis, ymin ), iyhi = last( fYAxis, ymax );
+    for ( int iy = iylo; iy <= iyhi; ++iy ){
+      for ( int ix = ixlo; ix <= ixhi; ++ix ){
+        for ( unsigned i : InCell( ix, iy ) ){
+          if ( fX[i] >= xmin && fX[i] <= xmax && fY[i] >= ymin && fY[i] <= ymax ) result.push_back( i );
+        }
+      }
+    }
+  }
+  std::sort( result.begin(), result.end() );
+  return result;
+}
+
+std::vector< unsigned > ScanPointIndex::InCircle( double xc, double yc, double r ) const {
+  std::vector< unsigned > result;
+  for ( unsigned i : InBox( xc - r, xc + r, yc - r, yc + r ) ){
+    if ( ( fX[i] - xc ) * ( fX[i] - xc ) + ( fY[i] - yc ) * ( fY[i] - yc ) < r * r ) result.push_back( i );
+  }
+  return result;
+}
+
+std::vector< bool > ScanPointIndex::InsideCircle( double xc, double yc, double r ) const {
+  std::vector< bool > inside( size(), false );
+  for ( unsigned i : InCircle( xc, yc, r ) ) inside[i] = true;
+  return inside;
+}
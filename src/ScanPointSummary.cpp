@@ -0,0 +1,275 @@
+#include "ScanPointSummary.hpp"
+#include "Configuration.hpp"
+#include "WaveformFitResult.hpp"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TLeaf.h"
+#include "TH1.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+
+
+namespace {
+
+  void load_binning( const Configuration& config, const std::string& prefix, SummaryBinning& b ){
+    config.Get( prefix+"_bins", b.nbins );
+    config.Get( prefix+"_min",  b.xmin );
+    config.Get( prefix+"_max",  b.xmax );
+    if ( b.nbins < 1 || b.xmax <= b.xmin ){
+      std::cout << "ScanPointSummaryParams Error: bad binning " << b.nbins << " bins from "
+                << b.xmin << " to " << b.xmax << " of " << prefix << std::endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  const double sqrt2pi = std::sqrt( 2 * std::acos(-1) );
+
+}
+
+void ScanPointSummaryParams::Load( const Configuration& config, const std::string& prefix ){
+  config.Get( "summary_tree", use );
+  load_binning( config, prefix+"charge", charge );
+  load_binning( config, prefix+"fine",   fine );
+  load_binning( config, prefix+"amp",    amp );
+  load_binning( config, prefix+"time",   time );
+}
+
+
+void SummaryHistogram::Book( const SummaryBinning& b ){
+  binning = b;
+  counts.assign( b.nbins + 2, 0 );
+}
+
+void SummaryHistogram::Fill( double x ){
+  if ( !std::isfinite( x ) ) return;
+  int i;
+  if ( x < binning.xmin ) i = 0;
+  else if ( x >= binning.xmax ) i = binning.nbins + 1;
+  else i = std::min( binning.nbins, // rounding just below xmax
+                     1 + int( binning.nbins * ( x - binning.xmin ) / ( binning.xmax - binning.xmin ) ) );
+  ++counts[i];
+}
+
+void SummaryHistogram::Add( const SummaryHistogram& other ){
+  if ( counts.empty() ){ // not booked yet
+    *this = other;
+    return;
+  }
+  if ( other.binning.nbins != binning.nbins || other.binning.xmin != binning.xmin ||
+       other.binning.xmax != binning.xmax ){
+    std::cout << "SummaryHistogram::Add Error: can not merge histograms of different binning" << std::endl;
+    exit( EXIT_FAILURE );
+  }
+  for ( unsigned i = 0; i < counts.size(); ++i ) counts[i] += other.counts[i];
+}
+
+void SummaryHistogram::Reset(){
+  std::fill( counts.begin(), counts.end(), 0 );
+}
+
+double SummaryHistogram::Center( int i ) const {
+  double w = ( binning.xmax - binning.xmin ) / binning.nbins;
+  return binning.xmin + ( i - 0.5 ) * w; // also outside for the under and overflow
+}
+
+void SummaryHistogram::AddTo( TH1* h, double weight, double shift, const SummaryHistogram* subtract ) const {
+  double entries = h->GetEntries();
+  for ( unsigned i = 0; i < counts.size(); ++i ){
+    double c = counts[i] - ( subtract ? subtract->counts[i] : 0 );
+    if ( c == 0 ) continue;
+    int b = h->FindBin( Center( i ) + shift );
+    double err = h->GetBinError( b );
+    h->SetBinContent( b, h->GetBinContent( b ) + c * weight );
+    h->SetBinError( b, std::sqrt( err * err + c * weight * weight ) );
+    entries += c;
+  }
+  h->SetEntries( entries );
+}
+
+
+void ScanPointSummary::Book( const ScanPointSummaryParams& par ){
+  hq.Book( par.charge );
+  hqsig.Book( par.charge );
+  hqfine.Book( par.fine );
+  hamp.Book( par.amp );
+  ht.Book( par.time );
+  htall.Book( par.time );
+}
+
+void ScanPointSummary::BeginScanPoint( int pt, float xx, float yy, float zz, unsigned long long nwaveforms ){
+  Reset();
+  scanpt = pt;
+  x = xx; y = yy; z = zz;
+  waveforms = nwaveforms;
+}
+
+void ScanPointSummary::Fill( const WaveformFitResult& wf ){
+  double q = sqrt2pi * std::fabs( wf.amp * wf.sigma );
+  ++entries;
+  q_sum    += q;
+  q_sum2   += q * q;
+  tall_sum  += wf.mean;
+  tall_sum2 += wf.mean * wf.mean;
+  hq.Fill( q );
+  hqfine.Fill( q );
+  hamp.Fill( wf.amp );
+  htall.Fill( wf.mean );
+  if ( wf.qsum > -999. ){
+    ++nqsum;
+    qsum_sum  += wf.qsum;
+    qsum_sum2 += wf.qsum * wf.qsum;
+  }
+  if ( wf.haswf ){
+    ++nhaswf;
+    qsig_sum  += q;
+    qsig_sum2 += q * q;
+    t_sum  += wf.mean;
+    t_sum2 += wf.mean * wf.mean;
+    hqsig.Fill( q );
+    ht.Fill( wf.mean );
+  }
+}
+
+void ScanPointSummary::Add( const ScanPointSummary& o ){
+  if ( entries == 0 && waveforms == 0 ){
+    scanpt = o.scanpt;
+    x = o.x; y = o.y; z = o.z;
+  }
+  entries   += o.entries;
+  waveforms += o.waveforms;
+  nhaswf    += o.nhaswf;
+  nqsum     += o.nqsum;
+  qsum_sum += o.qsum_sum;  qsum_sum2 += o.qsum_sum2;
+  q_sum    += o.q_sum;     q_sum2    += o.q_sum2;
+  qsig_sum += o.qsig_sum;  qsig_sum2 += o.qsig_sum2;
+  t_sum    += o.t_sum;     t_sum2    += o.t_sum2;
+  tall_sum += o.tall_sum;  tall_sum2 += o.tall_sum2;
+  hq.Add( o.hq );
+  hqsig.Add( o.hqsig );
+  hqfine.Add( o.hqfine );
+  hamp.Add( o.hamp );
+  ht.Add( o.ht );
+  htall.Add( o.htall );
+}
+
+void ScanPointSummary::Reset(){
+  scanpt = -1;
+  x = y = z = 0.;
+  entries = waveforms = nhaswf = nqsum = 0;
+  qsum_sum = qsum_sum2 = q_sum = q_sum2 = qsig_sum = qsig_sum2 = 0.;
+  t_sum = t_sum2 = tall_sum = tall_sum2 = 0.;
+  hq.Reset();
+  hqsig.Reset();
+  hqfine.Reset();
+  hamp.Reset();
+  ht.Reset();
+  htall.Reset();
+}
+
+
+namespace {
+
+  // the counts as a fixed length array, and the range of its bins
+  void histogram_branches( TTree * t, const std::string& name, SummaryHistogram& h ){
+    std::string n = std::to_string( h.counts.size() );
+    t->Branch( name.c_str(), &h.counts[0], ( name + "[" + n + "]/I" ).c_str() );
+    t->Branch( ( name + "_min" ).c_str(), &h.binning.xmin, ( name + "_min/D" ).c_str() );
+    t->Branch( ( name + "_max" ).c_str(), &h.binning.xmax, ( name + "_max/D" ).c_str() );
+  }
+
+  void histogram_addresses( TTree * t, const std::string& name, SummaryHistogram& h ){
+    TLeaf * leaf = t->GetLeaf( name.c_str() );
+    int n = leaf ? leaf->GetLenStatic() : 0;
+    if ( n < 3 ){
+      std::cout << "ScanPointSummary Error: no histogram " << name << " in tree" << std::endl;
+      exit( EXIT_FAILURE );
+    }
+    h.Book( SummaryBinning{ n - 2, 0., 1. } );
+    t->SetBranchAddress( name.c_str(), &h.counts[0] );
+    t->SetBranchAddress( ( name + "_min" ).c_str(), &h.binning.xmin );
+    t->SetBranchAddress( ( name + "_max" ).c_str(), &h.binning.xmax );
+  }
+
+}
+
+void ScanPointSummary::MakeTTreeBranches( TTree * t ){
+  t->Branch( "scanpt",    &scanpt,    "scanpt/I" );
+  t->Branch( "x",         &x,         "x/F" );
+  t->Branch( "y",         &y,         "y/F" );
+  t->Branch( "z",         &z,         "z/F" );
+  t->Branch( "entries",   &entries,   "entries/l" );
+  t->Branch( "waveforms", &waveforms, "waveforms/l" );
+  t->Branch( "nhaswf",    &nhaswf,    "nhaswf/l" );
+  t->Branch( "nqsum",     &nqsum,     "nqsum/l" );
+  t->Branch( "qsum_sum",  &qsum_sum,  "qsum_sum/D" );
+  t->Branch( "qsum_sum2", &qsum_sum2, "qsum_sum2/D" );
+  t->Branch( "q_sum",     &q_sum,     "q_sum/D" );
+  t->Branch( "q_sum2",    &q_sum2,    "q_sum2/D" );
+  t->Branch( "qsig_sum",  &qsig_sum,  "qsig_sum/D" );
+  t->Branch( "qsig_sum2", &qsig_sum2, "qsig_sum2/D" );
+  t->Branch( "t_sum",     &t_sum,     "t_sum/D" );
+  t->Branch( "t_sum2",    &t_sum2,    "t_sum2/D" );
+  t->Branch( "tall_sum",  &tall_sum,  "tall_sum/D" );
+  t->Branch( "tall_sum2", &tall_sum2, "tall_sum2/D" );
+  histogram_branches( t, "hq",     hq );
+  histogram_branches( t, "hqsig",  hqsig );
+  histogram_branches( t, "hqfine", hqfine );
+  histogram_branches( t, "hamp",   hamp );
+  histogram_branches( t, "ht",     ht );
+  histogram_branches( t, "htall",  htall );
+}
+
+void ScanPointSummary::SetBranchAddresses( TTree * t ){
+  t->SetBranchAddress( "scanpt",    &scanpt );
+  t->SetBranchAddress( "x",         &x );
+  t->SetBranchAddress( "y",         &y );
+  t->SetBranchAddress( "z",         &z );
+  t->SetBranchAddress( "entries",   &entries );
+  t->SetBranchAddress( "waveforms", &waveforms );
+  t->SetBranchAddress( "nhaswf",    &nhaswf );
+  t->SetBranchAddress( "nqsum",     &nqsum );
+  t->SetBranchAddress( "qsum_sum",  &qsum_sum );
+  t->SetBranchAddress( "qsum_sum2", &qsum_sum2 );
+  t->SetBranchAddress( "q_sum",     &q_sum );
+  t->SetBranchAddress( "q_sum2",    &q_sum2 );
+  t->SetBranchAddress( "qsig_sum",  &qsig_sum );
+  t->SetBranchAddress( "qsig_sum2", &qsig_sum2 );
+  t->SetBranchAddress( "t_sum",     &t_sum );
+  t->SetBranchAddress( "t_sum2",    &t_sum2 );
+  t->SetBranchAddress( "tall_sum",  &tall_sum );
+  t->SetBranchAddress( "tall_sum2", &tall_sum2 );
+  histogram_addresses( t, "hq",     hq );
+  histogram_addresses( t, "hqsig",  hqsig );
+  histogram_addresses( t, "hqfine", hqfine );
+  histogram_addresses( t, "hamp",   hamp );
+  histogram_addresses( t, "ht",     ht );
+  histogram_addresses( t, "htall",  htall );
+}
+
+
+std::string ScanPointSummaryTreeName( int pmt ){
+  return "scansummary" + std::to_string( pmt );
+}
+
+std::vector< ScanPointSummary > ReadScanPointSummaries( TFile * fin, int pmt ){
+  std::vector< ScanPointSummary > result;
+  std::string name = ScanPointSummaryTreeName( pmt );
+  TTree * tt = (TTree*)fin->Get( name.c_str() );
+  if ( tt == nullptr ) {
+    std::cerr<<"ReadScanPointSummaries: could not find TTree named "<<name<<std::endl;
+    return result;
+  }
+  ScanPointSummary summary;
+  summary.SetBranchAddresses( tt );
+  unsigned long long n = tt->GetEntries();
+  for ( unsigned long long i = 0 ; i < n ; ++i ){
+    tt->GetEntry( i );
+    result.push_back( summary );
+  }
+  tt->ResetBranchAddresses();
+  return result;
+}
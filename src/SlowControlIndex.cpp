@@ -0,0 +1,151 @@
+#include "SlowControlIndex.hpp"
+#include "config.hpp"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TBranch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+
+void TimeSeries::Add( double t, double value, long long entry ){
+  if ( !std::isfinite( t ) || !std::isfinite( value ) ) return;
+  if ( fT.empty() || t >= fT.back() ){ // readings normally come in time order
+    fT.push_back( t );
+    fV.push_back( value );
+    fE.push_back( entry );
+    return;
+  }
+  unsigned i = std::upper_bound( fT.begin(), fT.end(), t ) - fT.begin();
+  fT.insert( fT.begin() + i, t );
+  fV.insert( fV.begin() + i, value );
+  fE.insert( fE.begin() + i, entry );
+}
+
+int TimeSeries::Before( double t ) const {
+  return int( std::upper_bound( fT.begin(), fT.end(), t ) - fT.begin() ) - 1;
+}
+
+double TimeSeries::Interpolate( int i, double t ) const {
+  if ( i < 0 ) return fV.front();
+  if ( i + 1 >= int( fT.size() ) ) return fV.back();
+  double dt = fT[i+1] - fT[i];
+  if ( dt <= 0. ) return fV[i+1];
+  return fV[i] + ( fV[i+1] - fV[i] ) * ( t - fT[i] ) / dt;
+}
+
+double TimeSeries::At( double t ) const {
+  if ( fT.empty() || std::isnan( t ) ) return NAN;
+  return Interpolate( Before( t ), t );
+}
+
+double TimeSeries::Cursor::At( double t ){
+  const std::vector< double >& times = fSeries->fT;
+  if ( times.empty() || std::isnan( t ) ) return NAN;
+  if ( fI >= 0 && t < times[ fI ] ) fI = fSeries->Before( t ); // went back
+  else while ( fI + 1 < int( times.size() ) && times[ fI + 1 ] <= t ) ++fI;
+  return fSeries->Interpolate( fI, t );
+}
+
+
+bool SlowControlIndex::Build( const std::string& rawfile, const std::vector< int >& phidgets,
+                              const std::string& treeName ){
+  TFile * f = new TFile( rawfile.c_str(), "READ" );
+  if ( !f->IsOpen() ){
+    cout << "SlowControlIndex: could not open " << rawfile << endl;
+    delete f;
+    return false;
+  }
+  TTree * tree = nullptr;
+  f->GetObject( treeName.c_str(), tree );
+  if ( tree == nullptr ){
+    cout << "SlowControlIndex: no " << treeName << " in " << rawfile << endl;
+    delete f;
+    return false;
+  }
+
+  // only the timestamp and slow control branches are read
+  tree->SetBranchStatus( "*", 0 );
+  auto attach = [&]( const std::string& name, void* address ){
+    TBranch * br = tree->GetBranch( name.c_str() );
+    if ( br == nullptr ) return false;
+    tree->SetBranchStatus( name.c_str(), 1 );
+    br->SetAddress( address );
+    return true;
+  };
+  double timestamp = NAN;
+  if ( !attach( "timestamp", &timestamp ) ){
+    cout << "SlowControlIndex: no timestamp branch in " << rawfile << endl;
+    delete f;
+    return false;
+  }
+
+  // the value of each series for the current entry
+  std::vector< std::string > names;
+  std::vector< double* > values;
+  double ext2_temp = NAN;
+  if ( attach( "ext2_temp", &ext2_temp ) ){
+    names.push_back( "ext2_temp" );
+    values.push_back( &ext2_temp );
+  }
+  const char* formats[6] = { PHIDGET_FORMAT_X, PHIDGET_FORMAT_Y, PHIDGET_FORMAT_Z,
+                             PHIDGET_FORMAT_ACCX, PHIDGET_FORMAT_ACCY, PHIDGET_FORMAT_ACCZ };
+  std::vector< std::vector< double > > arrays( 6 * phidgets.size(), std::vector< double >( 150, NAN ) );
+  char name[64];
+  for ( unsigned ip = 0; ip < phidgets.size(); ++ip ){
+    for ( int k = 0; k < 6; ++k ){
+      snprintf( name, 64, formats[k], phidgets[ip] );
+      std::vector< double >& a = arrays[ 6 * ip + k ];
+      if ( !attach( name, &a[0] ) ) continue;
+      names.push_back( name );
+      values.push_back( &a[0] );
+    }
+  }
+
+  fSeries.clear();
+  std::vector< TimeSeries* > series;
+  for ( const std::string& n : names ) series.push_back( &( fSeries[ n ] = TimeSeries( n ) ) );
+  unsigned long long nentries = tree->GetEntries();
+  for ( unsigned long long i = 0; i < nentries; ++i ){
+    tree->GetEntry( i );
+    for ( unsigned k = 0; k < series.size(); ++k ) series[k]->Add( timestamp, *values[k], i );
+  }
+
+  f->Close();
+  delete f;
+  return true;
+}
+
+const TimeSeries& SlowControlIndex::operator[]( const std::string& name ) const {
+  auto it = fSeries.find( name );
+  if ( it == fSeries.end() ){
+    cout << "SlowControlIndex Error: no readings of " << name << endl;
+    exit( EXIT_FAILURE );
+  }
+  return it->second;
+}
+
+std::vector< std::string > SlowControlIndex::Names() const {
+  std::vector< std::string > names;
+  for ( const auto& s : fSeries ) names.push_back( s.first );
+  return names;
+}
+
+double SlowControlIndex::tmin() const {
+  double t = INFINITY;
+  for ( const auto& s : fSeries ) if ( !s.second.empty() ) t = std::min( t, s.second.time( 0 ) );
+  return t;
+}
+
+double SlowControlIndex::tmax() const {
+  double t = -INFINITY;
+  for ( const auto& s : fSeries ) if ( !s.second.empty() ) t = std::max( t, s.second.time( s.second.size() - 1 ) );
+  return t;
+}
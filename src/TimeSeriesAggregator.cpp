@@ -0,0 +1,219 @@
+#include "TimeSeriesAggregator.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+
+//------------------------------------------------------------------------------
+// P2Quantile
+
+P2Quantile::P2Quantile( double p ) : fP( p ) {
+  for ( int i=0; i<5; ++i ){
+    q[i] = 0.;
+    n[i] = i;
+  }
+  np[0] = 0.;  np[1] = 2*p;  np[2] = 4*p;  np[3] = 2+2*p;  np[4] = 4.;
+  dn[0] = 0.;  dn[1] = p/2;  dn[2] = p;    dn[3] = (1+p)/2; dn[4] = 1.;
+}
+
+double P2Quantile::parabolic( int i, int d ) const {
+  return q[i] + d / ( n[i+1] - n[i-1] ) *
+    ( ( n[i] - n[i-1] + d ) * ( q[i+1] - q[i] ) / ( n[i+1] - n[i] ) +
+      ( n[i+1] - n[i] - d ) * ( q[i] - q[i-1] ) / ( n[i] - n[i-1] ) );
+}
+
+double P2Quantile::linear( int i, int d ) const {
+  return q[i] + d * ( q[i+d] - q[i] ) / ( n[i+d] - n[i] );
+}
+
+void P2Quantile::add( double val ){
+  // first five values just initialize the markers
+  if ( npts < 5 ){
+    q[ npts++ ] = val;
+    if ( npts == 5 ) std::sort( q, q+5 );
+    return;
+  }
+  ++npts;
+
+  // find cell k containing val, and extend the extreme markers if needed
+  int k;
+  if ( val < q[0] ) { q[0] = val; k = 0; }
+  else if ( val >= q[4] ) { q[4] = val; k = 3; }
+  else {
+    k = 0;
+    while ( k < 3 && val >= q[k+1] ) ++k;
+  }
+  for ( int i=k+1; i<5; ++i ) n[i] += 1.;
+  for ( int i=0; i<5; ++i ) np[i] += dn[i];
+
+  // adjust the middle three markers
+  for ( int i=1; i<=3; ++i ){
+    double d = np[i] - n[i];
+    if ( ( d >=  1. && n[i+1] - n[i] >  1. ) ||
+         ( d <= -1. && n[i-1] - n[i] < -1. ) ){
+      int id = ( d > 0. ) ? 1 : -1;
+      double qp = parabolic( i, id );
+      if ( q[i-1] < qp && qp < q[i+1] ) q[i] = qp;
+      else q[i] = linear( i, id );
+      n[i] += id;
+    }
+  }
+}
+
+double P2Quantile::value() const {
+  if ( npts == 0 ) return 0.;
+  if ( npts <= 5 ){
+    double tmp[5];
+    std::copy( q, q+npts, tmp );
+    std::sort( tmp, tmp+npts );
+    int idx = int( std::floor( fP * ( npts - 1 ) + 0.5 ) );
+    return tmp[ idx ];
+  }
+  return q[2];
+}
+
+//------------------------------------------------------------------------------
+// TimeWindowStats
+
+TimeWindowStats::TimeWindowStats( double tstart, double tstop, const std::vector< double >& quantiles,
+                                  unsigned nbins, double xmin, double xmax ) :
+  fTStart( tstart ), fTStop( tstop ), fHist( nbins, 0 ), fXMin( xmin ) {
+  fBinWid = ( nbins > 0 ) ? ( xmax - xmin ) / nbins : 1.;
+  for ( double p : quantiles ) fQuantiles.push_back( P2Quantile( p ) );
+}
+
+void TimeWindowStats::add( double val ){
+  fMeanRMS.add( val );
+  for ( P2Quantile& pq : fQuantiles ) pq.add( val );
+  double fbin = ( val - fXMin ) / fBinWid;
+  if ( fbin < 0. || fbin >= fHist.size() ) ++fOverflow;
+  else ++fHist[ unsigned( fbin ) ];
+}
+
+double TimeWindowStats::mean_err() const {
+  if ( nentries() < 2 ) return 0.;
+  return rms() / std::sqrt( double( nentries() ) );
+}
+
+double TimeWindowStats::peak() const {
+  if ( fHist.empty() ) return mean();
+  auto imax = std::max_element( fHist.begin(), fHist.end() ) - fHist.begin();
+  if ( fHist[ imax ] == 0 ) return mean();
+  double offset = 0.;
+  if ( imax > 0 && imax+1 < (long)fHist.size() ){
+    double ym = fHist[ imax-1 ], y0 = fHist[ imax ], yp = fHist[ imax+1 ];
+    double denom = ym - 2*y0 + yp;
+    if ( denom != 0. ) offset = 0.5 * ( ym - yp ) / denom;
+  }
+  return fXMin + ( imax + 0.5 + offset ) * fBinWid;
+}
+
+double TimeWindowStats::peak_hwhm() const {
+  if ( fHist.empty() ) return 0.;
+  long imax = std::max_element( fHist.begin(), fHist.end() ) - fHist.begin();
+  double half = fHist[ imax ] / 2.;
+  if ( half == 0. ) return 0.;
+  // walk down each side to half maximum and interpolate within the bin
+  long il = imax;
+  while ( il > 0 && fHist[ il ] > half ) --il;
+  long ir = imax;
+  while ( ir+1 < (long)fHist.size() && fHist[ ir ] > half ) ++ir;
+  double xl = il, xr = ir;
+  if ( fHist[ il ] <= half && il < imax )
+    xl = il + ( half - fHist[ il ] ) / ( double( fHist[ il+1 ] ) - fHist[ il ] );
+  if ( fHist[ ir ] <= half && ir > imax )
+    xr = ir - ( half - fHist[ ir ] ) / ( double( fHist[ ir-1 ] ) - fHist[ ir ] );
+  return 0.5 * ( xr - xl ) * fBinWid;
+}
+
+//------------------------------------------------------------------------------
+// TimeSeriesAggregator
+
+TimeSeriesAggregator::TimeSeriesAggregator( double width, double step ) :
+  fWidth( width ), fStep( step > 0. ? step : width ) {
+  if ( fWidth <= 0. ){
+    std::cout << "TimeSeriesAggregator Error: window width must be positive!" << std::endl;
+    exit( EXIT_FAILURE );
+  }
+  if ( fStep > fWidth ){
+    std::cout << "TimeSeriesAggregator Warning: step " << fStep << " larger than width " << fWidth
+              << ", some times will not be in any window" << std::endl;
+  }
+  fQuantiles = { 0.16, 0.5, 0.84 };
+}
+
+void TimeSeriesAggregator::add( double t, double val ){
+  if ( !fHaveOrigin ) set_origin( t );
+  double dt = t - fOrigin;
+  // window k covers [ origin + k*step, origin + k*step + width )
+  long long kmax = (long long) std::floor( dt / fStep );
+  long long kmin = (long long) std::floor( ( dt - fWidth ) / fStep ) + 1;
+  for ( long long k = kmin; k <= kmax; ++k ){
+    auto it = fWindows.find( k );
+    if ( it == fWindows.end() ){
+      double t0 = fOrigin + k * fStep;
+      it = fWindows.insert( std::make_pair( k, TimeWindowStats( t0, t0 + fWidth, fQuantiles, fNBins, fXMin, fXMax ) ) ).first;
+    }
+    it->second.add( val );
+  }
+}
+
+unsigned long long TimeSeriesAggregator::fill_from_tree( TTree* tt, WaveformFitResult* wf, Extractor extract ){
+  if ( tt == nullptr || wf == nullptr ) return 0;
+  std::vector< double > vals;
+  unsigned long long n = tt->GetEntries();
+  for ( unsigned long long i = 0; i < n; ++i ){
+    if ( i % 100000 == 0 ) std::cout << "TimeSeriesAggregator entry " << i << " / " << n << std::endl;
+    tt->GetEvent( i );
+    vals.clear();
+    extract( *wf, vals );
+    for ( double v : vals ) add( wf->evt_timestamp, v );
+  }
+  return n;
+}
+
+std::vector< TimeWindowStats > TimeSeriesAggregator::windows() const {
+  std::vector< TimeWindowStats > result;
+  result.reserve( fWindows.size() );
+  for ( const auto& w : fWindows ) result.push_back( w.second );
+  return result;
+}
+
+void TimeSeriesAggregator::write( const std::string& treename ) const {
+  const int maxq = 16;
+  double tstart, tstop, mean, rms, mean_err, peak, peak_hwhm;
+  double quant[ maxq ];
+  unsigned long long nentries, overflow;
+  int nquant;
+
+  TTree * tt = new TTree( treename.c_str(), treename.c_str() );
+  tt->Branch( "tstart",    &tstart,    "tstart/D" );
+  tt->Branch( "tstop",     &tstop,     "tstop/D" );
+  tt->Branch( "nentries",  &nentries,  "nentries/l" );
+  tt->Branch( "overflow",  &overflow,  "overflow/l" );
+  tt->Branch( "mean",      &mean,      "mean/D" );
+  tt->Branch( "rms",       &rms,       "rms/D" );
+  tt->Branch( "mean_err",  &mean_err,  "mean_err/D" );
+  tt->Branch( "peak",      &peak,      "peak/D" );
+  tt->Branch( "peak_hwhm", &peak_hwhm, "peak_hwhm/D" );
+  tt->Branch( "nquant",    &nquant,    "nquant/I" );
+  tt->Branch( "quant",     quant,      "quant[nquant]/D" );
+
+  for ( const auto& it : fWindows ){
+    const TimeWindowStats& w = it.second;
+    tstart    = w.tstart();
+    tstop     = w.tstop();
+    nentries  = w.nentries();
+    overflow  = w.overflow();
+    mean      = w.mean();
+    rms       = w.rms();
+    mean_err  = w.mean_err();
+    peak      = w.peak();
+    peak_hwhm = w.peak_hwhm();
+    nquant    = std::min( (int)w.nquantiles(), maxq );
+    for ( int iq=0; iq<nquant; ++iq ) quant[iq] = w.quantile( iq );
+    tt->Fill();
+  }
+  tt->Write();
+}
@@ -0,0 +1,112 @@
+#include "TreeOutputPolicy.hpp"
+#include "Configuration.hpp"
+
+#include "TFile.h"
+#include "TTree.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+// ROOT compression algorithm codes, and the levels ROOT recommends for each
+static int compression_algorithm( const std::string& name ){
+  if ( name == "none" ) return 0;
+  if ( name == "zlib" ) return 1;
+  if ( name == "lzma" ) return 2;
+  if ( name == "lz4"  ) return 4;
+  if ( name == "zstd" ) return 5;
+  std::cout << "TreeOutputPolicy: unknown compression " << name
+            << " (use default, none, zlib, lzma, lz4 or zstd)" << std::endl;
+  exit( EXIT_FAILURE );
+}
+
+static int default_level( int algorithm ){
+  switch ( algorithm ){
+  case 2: return 7;
+  case 4: return 4;
+  case 5: return 5;
+  default: return 1;
+  }
+}
+
+static void parse_autoflush( const std::string& value, TreeOutputPolicy& p ){
+  p.flush_scanpoint = false;
+  p.flush_entries = 0;
+  if ( value == "default" ) return;
+  if ( value == "scanpoint" ){
+    p.flush_scanpoint = true;
+    return;
+  }
+  char * end;
+  p.flush_entries = strtol( value.c_str(), &end, 10 );
+  if ( *end != '\0' ){
+    std::cout << "TreeOutputPolicy: bad autoflush " << value
+              << " (use default, scanpoint or a number of entries)" << std::endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
+void TreeOutputPolicy::Load( const Configuration& config, const std::string& prefix ){
+  config.Get( prefix+"compression", compression );
+  config.Get( prefix+"compression_level", level );
+  std::string autoflush;
+  if ( config.Get( prefix+"autoflush", autoflush ) ) parse_autoflush( autoflush, *this );
+  config.Get( prefix+"scanpoints_per_cluster", scanpoints_per_cluster );
+  config.Get( prefix+"basket_size", basket_size );
+  if ( compression != "default" ) compression_algorithm( compression ); // check it now
+  if ( scanpoints_per_cluster < 1 ) scanpoints_per_cluster = 1;
+}
+
+void TreeOutputPolicy::Parse( const std::string& spec ){
+  std::vector< std::string > fields;
+  std::stringstream ss( spec );
+  std::string field;
+  while ( std::getline( ss, field, ':' ) ) fields.push_back( field );
+
+  *this = TreeOutputPolicy();
+  if ( fields.size() > 0 && !fields[0].empty() ) compression = fields[0];
+  if ( fields.size() > 1 && !fields[1].empty() ) level = atoi( fields[1].c_str() );
+  if ( fields.size() > 2 && !fields[2].empty() ) parse_autoflush( fields[2], *this );
+  if ( fields.size() > 3 && !fields[3].empty() ) basket_size = atoi( fields[3].c_str() );
+  if ( compression != "default" ) compression_algorithm( compression );
+}
+
+int TreeOutputPolicy::CompressionSettings() const {
+  if ( compression == "default" ) return -1;
+  int algorithm = compression_algorithm( compression );
+  if ( algorithm == 0 ) return 0;
+  return 100 * algorithm + ( level >= 0 ? level : default_level( algorithm ) );
+}
+
+std::string TreeOutputPolicy::Name() const {
+  std::string name = compression;
+  int settings = CompressionSettings();
+  if ( settings > 0 ) name += ":" + std::to_string( settings % 100 );
+  if ( flush_scanpoint ){
+    name += ":scanpoint";
+    if ( scanpoints_per_cluster > 1 ) name += "x" + std::to_string( scanpoints_per_cluster );
+  }
+  else if ( flush_entries != 0 ) name += ":" + std::to_string( flush_entries );
+  if ( basket_size > 0 ) name += ":b" + std::to_string( basket_size );
+  return name;
+}
+
+void TreeOutputPolicy::Apply( TFile * f ) const {
+  int settings = CompressionSettings();
+  if ( f && settings >= 0 ) f->SetCompressionSettings( settings );
+}
+
+void TreeOutputPolicy::Apply( TTree * t ){
+  fScanPoints = 0;
+  if ( flush_scanpoint ) t->SetAutoFlush( 0 ); // flushed by EndScanPoint instead
+  else if ( flush_entries != 0 ) t->SetAutoFlush( flush_entries );
+  if ( basket_size > 0 ) t->SetBasketSize( "*", basket_size );
+}
+
+void TreeOutputPolicy::EndScanPoint( TTree * t ){
+  if ( !flush_scanpoint ) return;
+  if ( ++fScanPoints < scanpoints_per_cluster ) return;
+  t->FlushBaskets();
+  fScanPoints = 0;
+}
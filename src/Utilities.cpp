@@ -1,18 +1,24 @@
 #include "Utilities.hpp"
 #include "PTFStyle.hpp"
+#include "ScanPointIndex.hpp"
 
 #include "TROOT.h"
 #include "TStyle.h"
 #include "TColor.h"
+#include "TH1.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
 
 using namespace std;
 
-const std::vector< double > Utilities::get_bins( std::vector< ScanPoint > scanpoints, char dim ){
+const std::vector< double > Utilities::get_bins( const std::vector< ScanPoint >& scanpoints, char dim ){
 
   vector< double > positions;
 
   for(unsigned int iscan=0; iscan<scanpoints.size(); iscan++){
-    ScanPoint scanpoint = scanpoints[ iscan ];
+    const ScanPoint& scanpoint = scanpoints[ iscan ];
     if( scanpoint.x() < 1e-5 && scanpoint.y() < 1e-5 ) continue; // Ignore position (0,0,0)
     if( dim == 'x' ){
       positions.push_back( scanpoint.x() );
@@ -35,8 +41,7 @@ const std::vector< double > Utilities::get_bins( std::vector< ScanPoint > scanpo
     }
   }
 
-  sort( positions.begin(), positions.end() );
-  positions.erase( unique( positions.begin(), positions.end(), comparison ), positions.end() ); // comparison function may not be necessary but was concerned about the comparison of doubles
+  positions = ScanAxis::Infer( positions ).positions; // sorted, the same within 1e-5
 
   //std::cout << "positions contains:";
   //vector<double>::iterator it;
@@ -181,3 +186,65 @@ bool Utilities::HasWaveform( WaveformFitResult *wf, int pmt ){
   }
   return true;
 }
+
+std::vector< RunFile > Utilities::read_run_list( const std::string& listfile ){
+  std::vector< RunFile > runs;
+  ifstream fin( listfile.c_str() );
+  if ( !fin.good() ){
+    cout << "Utilities::read_run_list Error: cannot read run list " << listfile << endl;
+    exit( EXIT_FAILURE );
+  }
+  string line;
+  while ( getline( fin, line ) ){
+    size_t pos = line.find( '#' );
+    if ( pos != string::npos ) line = line.substr( 0, pos );
+    istringstream is( line );
+    RunFile rf;
+    if ( !( is >> rf.filename ) ) continue;
+    if ( !( is >> rf.run ) ){
+      cout << "Utilities::read_run_list Error: no run number for " << rf.filename << endl;
+      exit( EXIT_FAILURE );
+    }
+    runs.push_back( rf );
+  }
+  if ( runs.empty() ){
+    cout << "Utilities::read_run_list Error: no runs in " << listfile << endl;
+    exit( EXIT_FAILURE );
+  }
+  return runs;
+}
+
+double Utilities::sampled_fraction( const std::vector< ScanPoint >& scanpoints ){
+  double entries = 0., waveforms = 0.;
+  for ( const ScanPoint& sp : scanpoints ){
+    entries += sp.nentries();
+    waveforms += sp.nwaveforms();
+  }
+  return waveforms > 0. ? entries / waveforms : 1.;
+}
+
+double Utilities::mean_entries( const std::vector< ScanPoint >& scanpoints ){
+  double entries = 0.;
+  for ( const ScanPoint& sp : scanpoints ) entries += sp.nentries();
+  return scanpoints.empty() ? 0. : entries / scanpoints.size();
+}
+
+std::string Utilities::preview_label( const std::vector< ScanPoint >& scanpoints, double error ){
+  double fraction = sampled_fraction( scanpoints );
+  if ( fraction >= 1. ) return "";
+  ostringstream os;
+  os.precision( 2 );
+  os << " (" << 100. * fraction << "% of waveforms analysed";
+  if ( error >= 0. ) os << ", #pm" << error << " per scan point";
+  os << ")";
+  return os.str();
+}
+
+void Utilities::label_preview( TH1* h, const std::vector< ScanPoint >& scanpoints, double error ){
+  std::string label = preview_label( scanpoints, error );
+  if ( label.empty() ) return;
+  std::string title = h->GetTitle();
+  size_t axes = title.find( ';' );
+  title.insert( axes == std::string::npos ? title.size() : axes, label );
+  h->SetTitle( title.c_str() );
+}
@@ -0,0 +1,112 @@
+#include "WaveformConditioner.hpp"
+#include "Configuration.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+
+void ConditioningParams::Load( const Configuration& config, int channel ){
+  std::vector< std::string > prefixes( 1, "condition_" );
+  if ( channel >= 0 ) prefixes.push_back( "condition_ch" + std::to_string( channel ) + "_" );
+  for ( const std::string& prefix : prefixes ){
+    config.Get( prefix+"baseline_samples",  baseline_samples );
+    config.Get( prefix+"subtract_baseline", subtract_baseline );
+    config.Get( prefix+"baseline_level",    baseline_level );
+    config.Get( prefix+"smooth",            smooth );
+    config.Get( prefix+"decimate",          decimate );
+    config.Get( prefix+"invert",            invert );
+    config.Get( prefix+"roi_tmin",          roi_tmin );
+    config.Get( prefix+"roi_tmax",          roi_tmax );
+  }
+}
+
+
+WaveformConditioner::WaveformConditioner( const ConditioningParams& par, int nraw, double raw_sample_ns, double scale ) :
+  fPar( par ), fNraw( nraw ), fRawSampleNs( raw_sample_ns ), fScale( scale ) {
+  fHalf = std::max( fPar.smooth, 1 ) / 2;
+  fPar.smooth = 2*fHalf + 1;
+  fDecimate = std::max( fPar.decimate, 1 );
+  fPar.decimate = fDecimate;
+  fPar.baseline_samples = std::min( std::max( fPar.baseline_samples, 0 ), nraw );
+
+  int last = nraw;
+  fFirst = 0;
+  if ( fPar.roi_tmax > fPar.roi_tmin ){
+    fFirst = std::min( std::max( int( std::floor( fPar.roi_tmin / raw_sample_ns ) ), 0 ), nraw );
+    last   = std::min( std::max( int( std::ceil( fPar.roi_tmax / raw_sample_ns ) ), fFirst ), nraw );
+  }
+  fN = ( last - fFirst ) / fDecimate;
+  if ( fN < 1 ){
+    std::cerr << "WaveformConditioner: no samples left of " << nraw << " with " << Describe()
+              << ". Exiting" << std::endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
+double WaveformConditioner::error_scale() const {
+  return fScale / std::sqrt( double( fDecimate ) );
+}
+
+std::string WaveformConditioner::Describe() const {
+  std::ostringstream os;
+  os << "scale " << fScale << " V/count";
+  if ( fPar.subtract_baseline ) os << ", baseline of " << fPar.baseline_samples
+                                  << " samples moved to " << fPar.baseline_level << " V";
+  if ( fPar.smooth > 1 ) os << ", smooth " << fPar.smooth;
+  if ( fPar.decimate > 1 ) os << ", decimate " << fPar.decimate;
+  if ( fPar.invert ) os << ", invert";
+  if ( fPar.roi_tmax > fPar.roi_tmin ) os << ", roi " << fPar.roi_tmin << " to " << fPar.roi_tmax << " ns";
+  return os.str();
+}
+
+void WaveformConditioner::Process( const double* raw, ConditionedWaveform& out ) const {
+  out.volts.resize( fN );
+  out.nsamples = fN;
+  out.t0 = tmin();
+  out.sample_ns = sample_ns();
+
+  // baseline from the start of the waveform
+  int nb = fPar.baseline_samples;
+  double base = 0., lowest = nb > 0 ? raw[0] : 0.;
+  for ( int i = 0; i < nb; ++i ){
+    base += raw[i];
+    lowest = std::min( lowest, raw[i] );
+  }
+  base = nb > 0 ? fScale * base / nb : 0.;
+  out.raw_baseline = base;
+  out.raw_baseline_min = fScale * lowest;
+  out.baseline_subtracted = fPar.subtract_baseline;
+
+  // scale, baseline and inversion as v = a * ( sum of raw counts ) + b
+  double sign = fPar.invert ? -1. : 1.;
+  double a = sign * fScale / ( fPar.smooth * fDecimate );
+  double b = fPar.subtract_baseline ? sign * ( fPar.baseline_level - base ) : 0.;
+  out.pedestal = sign * ( fPar.subtract_baseline ? fPar.baseline_level : base );
+
+  double* v = &out.volts[0];
+  const double* x = raw + fFirst;
+  if ( fHalf == 0 && fDecimate == 1 ){
+    for ( int k = 0; k < fN; ++k ) v[k] = a * x[k] + b;
+    return;
+  }
+
+  // running boxcar sum over raw samples i-half..i+half, repeating the end
+  // samples past the ends of the waveform.  The counts are integers, so the
+  // running sum is exact.
+  const int last = fNraw - 1;
+  auto at = [raw, last]( int i ){ return raw[ std::min( std::max( i, 0 ), last ) ]; };
+  double s = 0.;
+  for ( int j = -fHalf; j <= fHalf; ++j ) s += at( fFirst + j );
+  int i = fFirst;
+  for ( int k = 0; k < fN; ++k ){
+    double sum = 0.;
+    for ( int d = 0; d < fDecimate; ++d, ++i ){
+      sum += s;
+      s += at( i + fHalf + 1 ) - at( i - fHalf );
+    }
+    v[k] = a * sum + b;
+  }
+}
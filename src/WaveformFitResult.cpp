@@ -13,15 +13,40 @@ void WaveformFitResult::Init(){
   fitstat=-1;
   fftmaxbin=-1; fftmaxval=0.;
   haswf=0; qped=0.; qsum=-999.;
-  numPulses = 0;
+  numPulses = 0; // pulse arrays beyond numPulses are not used, no need to clear
   pulseArea = 0.0;
-  for(int i = 0; i < MAX_PULSES; i++){
-    pulseTimes[i] = 0.0;
-    pulseTimesCFD[i] = 0.0;
-    pulseTimeErr[i] = 0.0;
-    pulseCharges[i] = 0.0;
-    pulseChargeErr[i] = 0.0;
-  }
+}
+
+PulseInfo PulseIterator::operator*() const {
+  return fWf->pulse( fIdx );
+}
+
+void WaveformFitResult::AddPulse( float time, float timeCFD, float charge, float timeErr, float chargeErr ){
+  if ( numPulses >= (int)pulseTimes.size() ) GrowPulses( 2 * pulseTimes.size() );
+  pulseTimes[ numPulses ]     = time;
+  pulseTimesCFD[ numPulses ]  = timeCFD;
+  pulseTimeErr[ numPulses ]   = timeErr;
+  pulseCharges[ numPulses ]   = charge;
+  pulseChargeErr[ numPulses ] = chargeErr;
+  ++numPulses;
+}
+
+void WaveformFitResult::GrowPulses( unsigned n ){
+  if ( n <= pulseTimes.size() ) return;
+  pulseTimes.resize( n );
+  pulseTimesCFD.resize( n );
+  pulseTimeErr.resize( n );
+  pulseCharges.resize( n );
+  pulseChargeErr.resize( n );
+  if ( fTree ) SetPulseAddresses();
+}
+
+void WaveformFitResult::SetPulseAddresses(){
+  fTree->SetBranchAddress( "pulseTimes", &pulseTimes[0] );
+  fTree->SetBranchAddress( "pulseTimesCFD", &pulseTimesCFD[0] );
+  fTree->SetBranchAddress( "pulseTimeErr", &pulseTimeErr[0] );
+  fTree->SetBranchAddress( "pulseCharges", &pulseCharges[0] );
+  fTree->SetBranchAddress( "pulseChargeErr", &pulseChargeErr[0] );
 }
 
 const char * WaveformFitResult::GetRootString(){
@@ -100,11 +125,12 @@ void WaveformFitResult::MakeTTreeBranches(TTree * t){
   t->Branch( "qped",      &qped,      "qped/F" );
   t->Branch( "qsum",      &qsum,      "qsum/F" );
   t->Branch( "numPulses", &numPulses, "numPulses/I" );
-  t->Branch( "pulseTimes",pulseTimes,"pulseTimes[numPulses]/F" );
-  t->Branch( "pulseTimesCFD",pulseTimesCFD,"pulseTimesCFD[numPulses]/F" );
-  t->Branch( "pulseTimeErr",pulseTimeErr,"pulseTimeErr[numPulses]/F" );
-  t->Branch( "pulseCharges",pulseCharges,"pulseCharges[numPulses]/F" );
-  t->Branch( "pulseChargeErr",pulseChargeErr,"pulseChargeErr[numPulses]/F" );
+  t->Branch( "pulseTimes",&pulseTimes[0],"pulseTimes[numPulses]/F" );
+  t->Branch( "pulseTimesCFD",&pulseTimesCFD[0],"pulseTimesCFD[numPulses]/F" );
+  t->Branch( "pulseTimeErr",&pulseTimeErr[0],"pulseTimeErr[numPulses]/F" );
+  t->Branch( "pulseCharges",&pulseCharges[0],"pulseCharges[numPulses]/F" );
+  t->Branch( "pulseChargeErr",&pulseChargeErr[0],"pulseChargeErr[numPulses]/F" );
+  fTree = t; // so the branches can follow the pulse arrays when they grow
 
   return;
 }
@@ -141,11 +167,11 @@ void WaveformFitResult::SetBranchAddresses(TTree * t){
   t->SetBranchAddress( "qped",      &qped );
   t->SetBranchAddress( "qsum",      &qsum );
   t->SetBranchAddress( "numPulses", &numPulses );
-  t->SetBranchAddress( "pulseTimes", pulseTimes );
-  t->SetBranchAddress( "pulseTimesCFD", pulseTimesCFD );
-  t->SetBranchAddress( "pulseTimeErr", pulseTimeErr );
-  t->SetBranchAddress( "pulseCharges", pulseCharges );
-  t->SetBranchAddress( "pulseChargeErr", pulseChargeErr );
+  // make the pulse arrays big enough for every entry in the tree
+  fTree = t;
+  double maxpulses = t->GetMaximum( "numPulses" );
+  if ( maxpulses > pulseTimes.size() ) GrowPulses( unsigned( maxpulses ) );
+  SetPulseAddresses();
   t->SetBranchAddress( "pulseArea", &pulseArea );
   
   return;
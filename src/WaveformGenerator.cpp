@@ -0,0 +1,134 @@
+#include "WaveformGenerator.hpp"
+#include "Configuration.hpp"
+
+#include "TMath.h"
+
+#include <cmath>
+#include <algorithm>
+
+void WaveformGeneratorParams::Load( const Configuration& config, const std::string& prefix ){
+  config.Get( prefix+"nsamples",          nsamples );
+  config.Get( prefix+"sample_ns",         sample_ns );
+  config.Get( prefix+"full_scale",        full_scale );
+  config.Get( prefix+"resolution",        resolution );
+  config.Get( prefix+"baseline",          baseline );
+  config.Get( prefix+"noise",             noise );
+  config.Get( prefix+"shape",             shape );
+  config.Get( prefix+"pulse_time",        pulse_time );
+  config.Get( prefix+"pulse_jitter",      pulse_jitter );
+  config.Get( prefix+"pulse_sigma",       pulse_sigma );
+  config.Get( prefix+"pulse_tau",         pulse_tau );
+  config.Get( prefix+"pe_amplitude",      pe_amplitude );
+  config.Get( prefix+"pe_spread",         pe_spread );
+  config.Get( prefix+"mu",                mu );
+  config.Get( prefix+"ring_amp",          ring_amp );
+  config.Get( prefix+"ring_freq",         ring_freq );
+  config.Get( prefix+"afterpulse_prob",   afterpulse_prob );
+  config.Get( prefix+"afterpulse_delay",  afterpulse_delay );
+  config.Get( prefix+"afterpulse_spread", afterpulse_spread );
+  config.Get( prefix+"dark_rate",         dark_rate );
+}
+
+void WaveformTruth::Clear(){
+  npe = 0; nafterpulses = 0; ndark = 0;
+  time = 0.; amp = 0.; charge = 0.;
+  ring_amp = 0.; ring_phase = 0.;
+  pulse_times.clear();
+  pulse_amps.clear();
+}
+
+WaveformGenerator::WaveformGenerator( const WaveformGeneratorParams& par, unsigned seed ) :
+  fPar( par ), fRand( seed ), fVolts( par.nsamples, 0. ) {
+  fCountsPerVolt = std::pow( 2.0, fPar.resolution ) / fPar.full_scale;
+  fMaxCounts = std::pow( 2.0, fPar.resolution ) - 1;
+
+  // Normalize the pulse shape to unit peak height, and find its area
+  // by sampling finely around the pulse
+  fNorm = 1.;
+  double tmin = -10*fPar.pulse_sigma;
+  double tmax = 10*fPar.pulse_sigma + ( fPar.shape == EMGPulse ? 20*fPar.pulse_tau : 0. );
+  double dt = fPar.pulse_sigma / 50.;
+  double peak = 0., area = 0.;
+  for ( double t = tmin; t < tmax; t += dt ){
+    double s = shape( t, 0. );
+    peak = std::max( peak, s );
+    area += s * dt;
+  }
+  if ( peak > 0. ){
+    fNorm = 1. / peak;
+    fArea = area / peak;
+  }
+}
+
+double WaveformGenerator::shape( double t, double t0 ) const {
+  if ( fPar.shape == EMGPulse ){
+    // same form as PTFAnalysis::funcEMG with unit amplitude and zero baseline
+    double s = fPar.pulse_sigma, tau = fPar.pulse_tau;
+    return fNorm * ( tau/2. ) * std::exp( ( t0 + s*s/tau/2. - t ) / tau ) *
+      TMath::Erfc( ( t0 + s*s/tau - t ) / std::sqrt(2.) / s );
+  }
+  double arg = ( t - t0 ) / fPar.pulse_sigma;
+  return std::exp( -0.5*arg*arg );
+}
+
+void WaveformGenerator::add_pulse( double t0, double amp, WaveformTruth& truth ){
+  truth.pulse_times.push_back( t0 );
+  truth.pulse_amps.push_back( amp );
+  truth.charge += amp * fArea;
+  // only evaluate the shape where it is not negligible
+  double tlo = t0 - 6*fPar.pulse_sigma;
+  double thi = t0 + 6*fPar.pulse_sigma + ( fPar.shape == EMGPulse ? 12*fPar.pulse_tau : 0. );
+  int ilo = std::max( 0, int( tlo / fPar.sample_ns ) );
+  int ihi = std::min( fPar.nsamples, int( thi / fPar.sample_ns ) + 1 );
+  for ( int i = ilo; i < ihi; ++i ){
+    fVolts[i] -= amp * shape( i * fPar.sample_ns, t0 );
+  }
+}
+
+void WaveformGenerator::generate( double* out, WaveformTruth& truth ){
+  truth.Clear();
+  double length = fPar.nsamples * fPar.sample_ns;
+
+  // baseline, noise and ringing
+  truth.ring_amp = fPar.ring_amp;
+  truth.ring_phase = fRand.Uniform( -TMath::Pi(), TMath::Pi() );
+  for ( int i = 0; i < fPar.nsamples; ++i ){
+    double t = i * fPar.sample_ns;
+    fVolts[i] = fPar.baseline + fRand.Gaus( 0., fPar.noise );
+    if ( fPar.ring_amp > 0. ) fVolts[i] += fPar.ring_amp * std::sin( fPar.ring_freq * t + truth.ring_phase );
+  }
+
+  // laser pulse photoelectrons
+  truth.time = fRand.Gaus( fPar.pulse_time, fPar.pulse_jitter );
+  truth.npe = fRand.Poisson( fPar.mu );
+  for ( int ipe = 0; ipe < truth.npe; ++ipe ){
+    double amp = fPar.pe_amplitude * std::max( 0., fRand.Gaus( 1.0, fPar.pe_spread ) );
+    truth.amp += amp;
+    add_pulse( truth.time, amp, truth );
+  }
+
+  // afterpulses of the laser photoelectrons
+  if ( fPar.afterpulse_prob > 0. ){
+    for ( int ipe = 0; ipe < truth.npe; ++ipe ){
+      if ( fRand.Rndm() >= fPar.afterpulse_prob ) continue;
+      double t = truth.time + fRand.Gaus( fPar.afterpulse_delay, fPar.afterpulse_spread );
+      if ( t < 0. || t >= length ) continue;
+      ++truth.nafterpulses;
+      add_pulse( t, fPar.pe_amplitude * std::max( 0., fRand.Gaus( 1.0, fPar.pe_spread ) ), truth );
+    }
+  }
+
+  // dark pulses uniformly in the window
+  if ( fPar.dark_rate > 0. ){
+    truth.ndark = fRand.Poisson( fPar.dark_rate * length * 1.0e-9 );
+    for ( int idark = 0; idark < truth.ndark; ++idark ){
+      add_pulse( fRand.Uniform( 0., length ), fPar.pe_amplitude * std::max( 0., fRand.Gaus( 1.0, fPar.pe_spread ) ), truth );
+    }
+  }
+
+  // digitize
+  for ( int i = 0; i < fPar.nsamples; ++i ){
+    double counts = std::floor( fVolts[i] * fCountsPerVolt + 0.5 );
+    out[i] = std::min( fMaxCounts, std::max( 0., counts ) );
+  }
+}
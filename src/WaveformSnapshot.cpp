@@ -0,0 +1,144 @@
+#include "WaveformSnapshot.hpp"
+#include "WaveformFitResult.hpp"
+#include "Configuration.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+void SnapshotSelection::Load( const Configuration& config, const std::string& prefix ){
+  config.Get( prefix+"x",        x );
+  config.Get( prefix+"y",        y );
+  config.Get( prefix+"radius",   radius );
+  config.Get( prefix+"haswf",    haswf );
+  config.Get( prefix+"fitstat",  fitstat );
+  config.Get( prefix+"prescale", prescale );
+  config.Get( prefix+"max",      max );
+  config.Get( prefix+"fft",      fft );
+  config.Get( prefix+"seed",     seed );
+}
+
+bool SnapshotSelector::Select( const WaveformFitResult& wf ){
+  if ( fSel.radius >= 0. ){
+    if ( !( wf.x == fLastX && wf.y == fLastY ) ){
+      fLastX = wf.x;
+      fLastY = wf.y;
+      fInRegion = !( std::fabs( wf.x - fSel.x ) > fSel.radius || std::fabs( wf.y - fSel.y ) > fSel.radius );
+    }
+    if ( !fInRegion ) return false;
+  }
+  int has = wf.haswf ? 1 : 0;
+  if ( fSel.haswf >= 0 && has != fSel.haswf ) return false;
+  if ( fNum[ has ] >= fSel.max ) return false;
+  if ( fSel.fitstat == 0 && wf.fitstat != 0 ) return false;
+  if ( fSel.fitstat == 1 && wf.fitstat == 0 ) return false;
+  if ( fSel.prescale < 1.0 && fRand.Rndm() >= fSel.prescale ) return false;
+  ++fNum[ has ];
+  return true;
+}
+
+void WaveformSnapshot::Resize( int n, int nf ){
+  bool grown = false;
+  if ( n > (int)samples.size() ){ samples.resize( n ); grown = true; }
+  if ( nf > (int)fft.size() ){ fft.resize( nf ); grown = true; }
+  if ( grown && fTree ){
+    fTree->SetBranchAddress( "samples", &samples[0] );
+    fTree->SetBranchAddress( "fft", &fft[0] );
+  }
+}
+
+void WaveformSnapshot::MakeTTreeBranches( TTree * t ){
+  Resize( 1, 1 ); // so that the branches have an address
+  t->Branch( "entry", &entry, "entry/l" );
+  t->Branch( "scanpt", &scanpt, "scanpt/I" );
+  t->Branch( "wavenum", &wavenum, "wavenum/I" );
+  t->Branch( "channel", &channel, "channel/I" );
+  t->Branch( "haswf", &haswf, "haswf/I" );
+  t->Branch( "fitstat", &fitstat, "fitstat/I" );
+  t->Branch( "nsamples", &nsamples, "nsamples/I" );
+  t->Branch( "tmin", &tmin, "tmin/F" );
+  t->Branch( "tmax", &tmax, "tmax/F" );
+  t->Branch( "samples", &samples[0], "samples[nsamples]/F" );
+  t->Branch( "nfft", &nfft, "nfft/I" );
+  t->Branch( "fmin", &fmin, "fmin/F" );
+  t->Branch( "fmax", &fmax, "fmax/F" );
+  t->Branch( "fft", &fft[0], "fft[nfft]/F" );
+  fTree = t; // so the branches can follow the arrays when they grow
+}
+
+void WaveformSnapshot::SetBranchAddresses( TTree * t ){
+  fTree = t;
+  int n = std::max( 1, int( t->GetMaximum( "nsamples" ) ) );
+  int nf = std::max( 1, int( t->GetMaximum( "nfft" ) ) );
+  t->SetBranchAddress( "entry", &entry );
+  t->SetBranchAddress( "scanpt", &scanpt );
+  t->SetBranchAddress( "wavenum", &wavenum );
+  t->SetBranchAddress( "channel", &channel );
+  t->SetBranchAddress( "haswf", &haswf );
+  t->SetBranchAddress( "fitstat", &fitstat );
+  t->SetBranchAddress( "nsamples", &nsamples );
+  t->SetBranchAddress( "tmin", &tmin );
+  t->SetBranchAddress( "tmax", &tmax );
+  t->SetBranchAddress( "nfft", &nfft );
+  t->SetBranchAddress( "fmin", &fmin );
+  t->SetBranchAddress( "fmax", &fmax );
+  samples.clear();
+  fft.clear();
+  Resize( n, nf );
+}
+
+void WaveformSnapshot::Set( unsigned long long ientry, int ichannel, const WaveformFitResult& wf,
+                            const TH1 * hwaveform, const TH1 * hfft ){
+  entry   = ientry;
+  scanpt  = wf.scanpt;
+  wavenum = wf.wavenum;
+  channel = ichannel;
+  haswf   = wf.haswf;
+  fitstat = wf.fitstat;
+  nsamples = hwaveform->GetNbinsX();
+  nfft = hfft ? hfft->GetNbinsX() : 0;
+  Resize( nsamples, nfft );
+  tmin = hwaveform->GetXaxis()->GetXmin();
+  tmax = hwaveform->GetXaxis()->GetXmax();
+  for ( int i = 0; i < nsamples; ++i ) samples[i] = hwaveform->GetBinContent( i+1 );
+  if ( hfft ){
+    fmin = hfft->GetXaxis()->GetXmin();
+    fmax = hfft->GetXaxis()->GetXmax();
+    for ( int i = 0; i < nfft; ++i ) fft[i] = hfft->GetBinContent( i+1 );
+  }
+}
+
+TH1D * WaveformSnapshot::MakeWaveform( const char * name ) const {
+  std::string title = haswf ? "HAS a pulse" : "Noise pulse";
+  title += "; Time (ns); Voltage (V)";
+  TH1D * h = new TH1D( name, title.c_str(), nsamples, tmin, tmax );
+  h->SetDirectory( nullptr );
+  for ( int i = 0; i < nsamples; ++i ) h->SetBinContent( i+1, samples[i] );
+  return h;
+}
+
+TH1D * WaveformSnapshot::MakeFFT( const char * name ) const {
+  if ( nfft == 0 ) return nullptr;
+  std::string title = haswf ? "HAS a pulse" : "Noise pulse";
+  title += "; Frequency; Coefficient";
+  TH1D * h = new TH1D( name, title.c_str(), nfft, fmin, fmax );
+  h->SetDirectory( nullptr );
+  for ( int i = 0; i < nfft; ++i ) h->SetBinContent( i+1, fft[i] );
+  return h;
+}
+
+TH1D * WaveformSnapshot::GetWaveform( TTree * t, unsigned long long ientry, const char * name, bool wantfft ){
+  if ( t == nullptr ) return nullptr;
+  WaveformSnapshot snap;
+  snap.SetBranchAddresses( t );
+  TH1D * h = nullptr;
+  TBranch * bentry = t->GetBranch( "entry" );
+  for ( long long i = 0; i < t->GetEntries(); ++i ){
+    bentry->GetEntry( i ); // only read the samples of the one that is wanted
+    if ( snap.entry != ientry ) continue;
+    t->GetEntry( i );
+    h = wantfft ? snap.MakeFFT( name ) : snap.MakeWaveform( name );
+    break;
+  }
+  t->ResetBranchAddresses();
+  return h;
+}
@@ -0,0 +1,165 @@
+#include "ZeroSuppression.hpp"
+#include "Configuration.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+void ZeroSuppressionParams::Load( const Configuration& config, const std::string& prefix ){
+  config.Get( prefix+"threshold",        threshold );
+  config.Get( prefix+"nsigma",           nsigma );
+  config.Get( prefix+"pre",              pre );
+  config.Get( prefix+"post",             post );
+  config.Get( prefix+"baseline_samples", baseline_samples );
+  config.Get( prefix+"keep_baseline",    keep_baseline );
+  config.Get( prefix+"keep_first",       keep_first );
+  config.Get( prefix+"keep_last",        keep_last );
+  if ( pre < 0 ) pre = 0;
+  if ( post < 0 ) post = 0;
+  if ( baseline_samples < 1 ) baseline_samples = 1;
+}
+
+
+namespace {
+
+  void put_varint( std::vector< unsigned char >& out, unsigned v ){
+    while ( v >= 0x80 ){
+      out.push_back( (unsigned char)( v | 0x80 ) );
+      v >>= 7;
+    }
+    out.push_back( (unsigned char)v );
+  }
+
+  bool get_varint( const unsigned char*& p, const unsigned char* end, unsigned& v ){
+    v = 0;
+    for ( int shift = 0; shift < 35; shift += 7 ){
+      if ( p >= end ) return false;
+      unsigned char b = *p++;
+      v |= unsigned( b & 0x7f ) << shift;
+      if ( !( b & 0x80 ) ) return true;
+    }
+    return false;
+  }
+
+  unsigned zigzag( int d ){ return ( unsigned( d ) << 1 ) ^ unsigned( d >> 31 ); }
+  int unzigzag( unsigned z ){ return int( z >> 1 ) ^ -int( z & 1 ); }
+
+}
+
+
+ZeroSuppressor::ZeroSuppressor( const ZeroSuppressionParams& par ) : fPar( par ) { }
+
+bool ZeroSuppressor::Encode( const double* samples, int n, std::vector< unsigned char >& out,
+                             float& baseline, float& rms ){
+  // baseline statistics
+  int nb = std::min( fPar.baseline_samples, n );
+  double sum = 0., sum2 = 0.;
+  for ( int k = 0; k < nb; ++k ){
+    sum  += samples[k];
+    sum2 += samples[k] * samples[k];
+  }
+  double mean = nb > 0 ? sum / nb : 0.;
+  double var  = nb > 0 ? sum2 / nb - mean * mean : 0.;
+  baseline = mean;
+  rms = var > 0. ? std::sqrt( var ) : 0.;
+  double thr = std::max( fPar.threshold, fPar.nsigma * rms );
+
+  // windows around the crossings, sorted and merged where they touch
+  fWindows.clear();
+  auto keep = [&]( int a, int b ){
+    a = std::max( a, 0 );
+    b = std::min( b, n );
+    if ( b > a ) fWindows.push_back( std::make_pair( a, b ) );
+  };
+  if ( fPar.keep_baseline ) keep( 0, nb );
+  if ( fPar.keep_last >= fPar.keep_first ) keep( fPar.keep_first, fPar.keep_last + 1 );
+  for ( int k = 0; k < n; ++k ){
+    if ( std::fabs( samples[k] - mean ) > thr ) keep( k - fPar.pre, k + fPar.post + 1 );
+  }
+  std::sort( fWindows.begin(), fWindows.end() );
+  fStart.clear();
+  fEnd.clear();
+  for ( const std::pair< int, int >& w : fWindows ){
+    if ( !fEnd.empty() && w.first <= fEnd.back() ) fEnd.back() = std::max( fEnd.back(), w.second );
+    else { fStart.push_back( w.first ); fEnd.push_back( w.second ); }
+  }
+
+  // pack the differences of each window
+  int ref = (int)std::lround( (double)baseline ); // as the decoder sees it
+  put_varint( out, fStart.size() );
+  int last = 0;
+  std::vector< unsigned > zz;
+  for ( unsigned iw = 0; iw < fStart.size(); ++iw ){
+    int a = fStart[iw], b = fEnd[iw];
+    zz.resize( b - a );
+    int prev = ref;
+    unsigned zmax = 0;
+    for ( int k = a; k < b; ++k ){
+      if ( samples[k] != std::floor( samples[k] ) || std::fabs( samples[k] ) > 1e9 ) return false;
+      int s = (int)samples[k];
+      zz[k-a] = zigzag( s - prev );
+      zmax |= zz[k-a];
+      prev = s;
+    }
+    int width = 0;
+    while ( zmax >> width ) ++width;
+
+    put_varint( out, a - last );
+    put_varint( out, b - a );
+    out.push_back( (unsigned char)width );
+    unsigned long long acc = 0;
+    int nacc = 0;
+    for ( unsigned z : zz ){
+      acc |= (unsigned long long)z << nacc;
+      nacc += width;
+      while ( nacc >= 8 ){
+        out.push_back( (unsigned char)( acc & 0xff ) );
+        acc >>= 8;
+        nacc -= 8;
+      }
+    }
+    if ( nacc > 0 ) out.push_back( (unsigned char)( acc & 0xff ) );
+    last = b;
+    fSamplesKept += b - a;
+  }
+  fSamplesIn += n;
+  ++fWaveforms;
+  return true;
+}
+
+
+bool ZeroSuppressedDecode( const unsigned char*& p, const unsigned char* end,
+                           double baseline, double* out, int n ){
+  std::fill( out, out + n, baseline );
+  int ref = (int)std::lround( baseline );
+  unsigned nwin;
+  if ( !get_varint( p, end, nwin ) ) return false;
+  unsigned last = 0;
+  for ( unsigned iw = 0; iw < nwin; ++iw ){
+    unsigned gap, len;
+    if ( !get_varint( p, end, gap ) || !get_varint( p, end, len ) || p >= end ) return false;
+    int width = *p++;
+    unsigned a = last + gap;
+    if ( width > 32 || a + len > (unsigned)n ) return false;
+    if ( end - p < (long)( ( (unsigned long long)len * width + 7 ) / 8 ) ) return false;
+    unsigned long long acc = 0, mask = ( 1ULL << width ) - 1;
+    int nacc = 0, prev = ref;
+    for ( unsigned k = a; k < a + len; ++k ){
+      while ( nacc < width ){
+        acc |= (unsigned long long)( *p++ ) << nacc;
+        nacc += 8;
+      }
+      prev += unzigzag( unsigned( acc & mask ) );
+      acc >>= width;
+      nacc -= width;
+      out[k] = prev;
+    }
+    last = a + len;
+  }
+  return true;
+}
+
+
+std::string ZeroSuppressedBranch( const std::string& name, const std::string& suffix ){
+  return "zs_" + name + suffix;
+}
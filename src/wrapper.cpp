@@ -1,5 +1,7 @@
 #include "wrapper.hpp"
 #include "BrbSettingsTree.hxx"
+#include "PerfStats.hpp"
+#include "ZeroSuppression.hpp"
 
 using namespace std;
 using namespace PTF;
@@ -8,26 +10,23 @@ using namespace PTF;
 //constructor of the class
 
 
-Wrapper::Wrapper(unsigned long long maxSamples, unsigned long long sampleSize, const vector<PMT>& activePMTs, const vector<int>& phidgets, const vector<Gantry>& gantries, DigitizerModel digi)
-
-  : maxSamples(maxSamples), sampleSize(sampleSize)
+Wrapper::Wrapper(const vector<PMT>& activePMTs, const vector<int>& phidgets, const vector<Gantry>& gantries, DigitizerModel digi)
 {
+  // buffers are allocated when a file is opened, once its sizes are known
   for (auto pmt : activePMTs) {
-    double* data = new double[maxSamples * sampleSize];
     PMTSet* pmtSet  = new PMTSet();
     pmtSet->channel = pmt.channel;
     pmtSet->type = pmt.type;
-    pmtSet->data    = data;
-    pmtData[pmt.pmt] = pmtSet;
+    pmtData[pmt.pmt].reset(pmtSet);
   }
   for (auto phidget : phidgets) {
     PhidgetSet* pSet = new PhidgetSet();
-    phidgetData[phidget] = pSet;
+    phidgetData[phidget].reset(pSet);
   }
   for (auto gantry : gantries) {
     GantrySet* gSet = new GantrySet();
     gSet->gantry = gantry;
-    gantryData[gantry] = gSet;
+    gantryData[gantry].reset(gSet);
   }
   digiData.model = digi;
   switch( digi ) {
@@ -42,8 +41,13 @@ Wrapper::Wrapper(unsigned long long maxSamples, unsigned long long sampleSize, c
       digiData.resolution = mPMT_DIGITIZER_RESOLUTION;
       break;
   }
+}
 
-  for(int i =0; i < nPoints_max; i++){evt_timestamp[i] = -1.0;}
+
+Wrapper::Wrapper(unsigned long long maxSamples, unsigned long long sampleSize, const vector<PMT>& activePMTs, const vector<int>& phidgets, const vector<Gantry>& gantries, DigitizerModel digi)
+  : Wrapper(activePMTs, phidgets, gantries, digi) {
+  defaultMaxSamples = maxSamples;
+  defaultSampleSize = sampleSize;
 }
 
 
@@ -54,32 +58,10 @@ Wrapper::Wrapper(unsigned long long maxSamples, unsigned long long sampleSize, c
 
 
 Wrapper::~Wrapper() {
-  return;
-  // for some reason doing cleanup below causes
-  // program to crash as exiting?
-  for (auto pmt : pmtData) {
-    delete[] pmt.second->data;
-    delete pmt.second;
-  }
-  
-  for (auto phidget : phidgetData) {
-    delete phidget.second;
-  }
-
-  for (auto gantry : gantryData) {
-    delete gantry.second;
-  }
-
-  if (tree) {
-    unsetDataPointers();
-    delete tree;
-    tree = nullptr;
-  }
-  if (file) {
-    file->Close();
-    delete file;
-    file = nullptr;
-  }
+  // Detach the branches from the buffers and close the file first; the
+  // buffer pool and the PMT, phidget and gantry sets are then released
+  // by their owners
+  closeFile();
 }
 
 
@@ -99,6 +81,85 @@ double* Wrapper::getDataForPmt(int pmt) const {
 }
 
 
+bool Wrapper::sizeBuffers() {
+  unsigned long long points = 0, length = 0;
+  char branchName[64];
+  for (auto& pmt : pmtData) {
+    snprintf(branchName, 64, PMT_CHANNEL_FORMAT, pmt.second->channel);
+    TBranch* br = tree->GetBranch(branchName);
+    TLeaf* leaf = br ? br->GetLeaf(branchName) : nullptr;
+    unsigned long long len = 0;
+    TLeaf* count = nullptr;
+    if (leaf) {
+      // V1730_wave0[num_points][70]/D: 70 samples, up to max(num_points) waveforms
+      len = leaf->GetLenStatic();
+      count = leaf->GetLeafCount();
+    } else {
+      // zero suppressed: zs_length samples, zs_V1730_wave0_baseline[num_points]/F
+      string zsName = ZeroSuppressedBranch(branchName, "_baseline");
+      TBranch* zsBr = tree->GetBranch(zsName.c_str());
+      TLeaf* zsLeaf = zsBr ? zsBr->GetLeaf(zsName.c_str()) : nullptr;
+      if (zsLeaf == nullptr || tree->GetBranch("zs_length") == nullptr) continue; // reported by setDataPointers
+      len = (unsigned long long) tree->GetMaximum("zs_length");
+      count = zsLeaf->GetLeafCount();
+    }
+    unsigned long long npts = 1;
+    if (count) {
+      npts = count->GetMaximum();
+      if (npts == 0) npts = (unsigned long long) tree->GetMaximum(count->GetName());
+    }
+    if (length != 0 && len != length) {
+      cout << "Wrapper: waveform length " << len << " of " << branchName
+           << " differs from " << length << " of other channels" << endl;
+      return false;
+    }
+    length = len;
+    points = std::max(points, npts);
+  }
+
+  // timestamps have one value per waveform
+  TBranch* brTime = tree->GetBranch("evt_timestamp");
+  TLeaf* leafTime = brTime ? brTime->GetLeaf("evt_timestamp") : nullptr;
+  if (leafTime && leafTime->GetLeafCount()) {
+    points = std::max(points, (unsigned long long) leafTime->GetLeafCount()->GetMaximum());
+  }
+
+  if (length == 0) length = defaultSampleSize;
+  if (points == 0) points = defaultMaxSamples;
+  if (length == 0 || points == 0) {
+    cout << "Wrapper: could not find the waveform sizes from the tree" << endl;
+    return false;
+  }
+  growBuffers(points, length);
+  return true;
+}
+
+
+void Wrapper::growBuffers(unsigned long long points, unsigned long long length) {
+  if (length == sampleSize && points <= maxSamples) return;
+  if (length != sampleSize) maxSamples = 0; // different layout
+  sampleSize = length;
+  // the pool only reallocates if the new layout does not fit
+  bufferPool.reserve(pmtData.size(), std::max(maxSamples, points) * sampleSize);
+  maxSamples = bufferPool.size() / sampleSize;
+
+  unsigned ibuf = 0;
+  for (auto& pmt : pmtData) {
+    pmt.second->data = bufferPool.buffer(ibuf++);
+    if (pmt.second->branch) pmt.second->branch->SetAddress(pmt.second->data);
+    if (pmt.second->zsBaselineBranch) {
+      pmt.second->zsBaseline.resize(maxSamples);
+      pmt.second->zsBaselineBranch->SetAddress(&pmt.second->zsBaseline[0]);
+    }
+  }
+  evt_timestamp.resize(maxSamples, -1.0);
+  if (tree) {
+    TBranch* brTime = tree->GetBranch("evt_timestamp");
+    if (brTime) brTime->SetAddress(&evt_timestamp[0]);
+  }
+}
+
+
 bool Wrapper::setDataPointers() {
   if (tree == nullptr || file == nullptr){
     cout << "false tree or file ppointer" << endl;
@@ -107,11 +168,16 @@ bool Wrapper::setDataPointers() {
   
   // Set PMT branches
   char branchName[64];
-  for (auto pmt : pmtData) {
+  zeroSuppressed = false;
+  for (auto& pmt : pmtData) {
     snprintf(branchName, 64, PMT_CHANNEL_FORMAT, pmt.second->channel);
     pmt.second->branch = nullptr;
     pmt.second->branch = tree->GetBranch(branchName);
     if (pmt.second->branch == nullptr) {
+      if (setZeroSuppressedPointers(*pmt.second, branchName)) {
+        zeroSuppressed = true;
+        continue;
+      }
       cout << "False second branch pointer " << branchName << endl;   
    return false;
     }
@@ -119,7 +185,7 @@ bool Wrapper::setDataPointers() {
   }
 
   // Set phidget branches
-  for (auto phidget : phidgetData) {
+  for (auto& phidget : phidgetData) {
     snprintf(branchName, 64, PHIDGET_FORMAT_X, phidget.first);
     phidget.second->branchX = nullptr;
     phidget.second->branchX = tree->GetBranch(branchName);
@@ -160,7 +226,7 @@ bool Wrapper::setDataPointers() {
 
 
   // Set gantry branches
-  for (auto gantry : gantryData) {
+  for (auto& gantry : gantryData) {
     snprintf(branchName, 64, GANTRY_FORMAT_X, (int)gantry.second->gantry);
     gantry.second->branchX = nullptr;
     gantry.second->branchX = tree->GetBranch(branchName);
@@ -196,9 +262,12 @@ bool Wrapper::setDataPointers() {
   }
 
 
-  TBranch* brNumSamples = tree->GetBranch("num_points");
-
-  brNumSamples->SetAddress(&numSamples);
+  numSamplesBranch = tree->GetBranch("num_points");
+  if (numSamplesBranch == nullptr) {
+    cout << "False num_points branch pointer" << endl;
+    return false;
+  }
+  numSamplesBranch->SetAddress(&numSamples);
   TBranch
     //*T_int = tree->GetBranch("int_temp"),//, *T_ext1 = tree->GetBranch("ext1_temp")
     *T_ext2 = tree->GetBranch("ext2_temp");
@@ -221,7 +290,7 @@ bool Wrapper::setDataPointers() {
   // Set the branch for the timestamp for each event
   TBranch *Time_2=tree->GetBranch("evt_timestamp");
   if(Time_2){
-    Time_2->SetAddress(&evt_timestamp);
+    Time_2->SetAddress(&evt_timestamp[0]);
     std::cout << "Found event timestamp branch.  Setting address" << std::endl;
   }else{
     std::cout << "Did not event timestamp branch." << std::endl;
@@ -237,21 +306,76 @@ bool Wrapper::setDataPointers() {
 }
 
 
+bool Wrapper::setZeroSuppressedPointers(PMTSet& pmt, const string& branchName) {
+  pmt.zsBranch = tree->GetBranch(ZeroSuppressedBranch(branchName).c_str());
+  pmt.zsNBytesBranch = tree->GetBranch(ZeroSuppressedBranch(branchName, "_nbytes").c_str());
+  pmt.zsBaselineBranch = tree->GetBranch(ZeroSuppressedBranch(branchName, "_baseline").c_str());
+  if (pmt.zsBranch == nullptr || pmt.zsNBytesBranch == nullptr || pmt.zsBaselineBranch == nullptr) {
+    pmt.zsBranch = pmt.zsNBytesBranch = pmt.zsBaselineBranch = nullptr;
+    return false;
+  }
+  pmt.zsNBytesBranch->SetAddress(&pmt.zsNBytes);
+  pmt.zsBaseline.resize(std::max(maxSamples, 1ULL));
+  pmt.zsBaselineBranch->SetAddress(&pmt.zsBaseline[0]);
+  pmt.zsBytes.resize(std::max(pmt.zsBytes.size(), (size_t)1));
+  pmt.zsBranch->SetAddress(&pmt.zsBytes[0]);
+  return true;
+}
+
+
+void Wrapper::reserveZeroSuppressed(unsigned long long entry) {
+  // the packed size changes from entry to entry
+  for (auto& pmt : pmtData) {
+    PMTSet& set = *pmt.second;
+    if (set.zsBranch == nullptr) continue;
+    set.zsNBytesBranch->GetEntry(entry);
+    if (set.zsNBytes < 0) {
+      throw new Exceptions::ZeroSuppressedDataError();
+    }
+    if ((size_t)set.zsNBytes > set.zsBytes.size()) {
+      set.zsBytes.resize(set.zsNBytes);
+      set.zsBranch->SetAddress(&set.zsBytes[0]);
+    }
+  }
+}
+
+
+void Wrapper::decodeZeroSuppressed() {
+  for (auto& pmt : pmtData) {
+    PMTSet& set = *pmt.second;
+    if (set.zsBranch == nullptr) continue;
+    const unsigned char* p = &set.zsBytes[0];
+    const unsigned char* end = p + set.zsNBytes;
+    for (unsigned long long j = 0; j < numSamples; ++j) {
+      if (!ZeroSuppressedDecode(p, end, set.zsBaseline[j], set.data + j * sampleSize, sampleSize)) {
+        cout << "Wrapper: zero suppressed waveform " << j << " of channel " << set.channel
+             << " in entry " << entry << " is corrupt" << endl;
+        throw new Exceptions::ZeroSuppressedDataError();
+      }
+    }
+  }
+}
+
+
 bool Wrapper::unsetDataPointers() {
   if (tree == nullptr || file == nullptr)
     return false;
   
-  for (auto pmt : pmtData) {
+  for (auto& pmt : pmtData) {
     pmt.second->branch = nullptr;
+    pmt.second->zsBranch = nullptr;
+    pmt.second->zsNBytesBranch = nullptr;
+    pmt.second->zsBaselineBranch = nullptr;
   }
+  numSamplesBranch = nullptr;
 
-  for (auto phidget : phidgetData) {
+  for (auto& phidget : phidgetData) {
     phidget.second->branchX = nullptr;
     phidget.second->branchY= nullptr;
     phidget.second->branchZ = nullptr;
   }
 
-  for (auto gantry : gantryData) {
+  for (auto& gantry : gantryData) {
     gantry.second->branchX = nullptr;
     gantry.second->branchY= nullptr;
     gantry.second->branchZ = nullptr;
@@ -267,6 +391,9 @@ bool Wrapper::unsetDataPointers() {
 
 
 void Wrapper::openFile(const string& fileName, const string& treeName) {
+  // reopening: release the previous file, keep the buffers
+  if (file || tree) closeFile();
+
   file = new TFile(fileName.c_str(), "READ");
 
   if (!file->IsOpen()) {
@@ -284,7 +411,9 @@ void Wrapper::openFile(const string& fileName, const string& treeName) {
     throw new Exceptions::InvalidTreeName(treeName);
   }
 
-  auto res = setDataPointers();
+  // waveforms with no timestamps in this file read back as -1
+  std::fill(evt_timestamp.begin(), evt_timestamp.end(), -1.0);
+  auto res = sizeBuffers() && setDataPointers();
 
 
   if (!res) {
@@ -293,7 +422,12 @@ void Wrapper::openFile(const string& fileName, const string& treeName) {
 
   numEntries = tree->GetEntries();
 
-  tree->GetEntry(0);
+  if (zeroSuppressed) {
+    cout << "Wrapper: " << fileName << " is zero suppressed" << endl;
+    if (numEntries > 0) setCurrentEntry(0);
+  } else {
+    tree->GetEntry(0);
+  }
   entry = 0;
 }
 
@@ -305,7 +439,9 @@ bool Wrapper::isFileOpen() const {
 
 void Wrapper::closeFile() {
   if (tree) {
+    // the buffers outlive the file, so detach the branches from them
     unsetDataPointers();
+    tree->ResetBranchAddresses();
     delete tree;
     tree = nullptr;
   }
@@ -318,6 +454,20 @@ void Wrapper::closeFile() {
 }
 
 
+void Wrapper::setRunList(const vector<string>& fileNames, const string& treeName) {
+  runFiles = fileNames;
+  runTreeName = treeName;
+}
+
+
+void Wrapper::openRun(unsigned irun) {
+  if (irun >= runFiles.size()) {
+    throw new Exceptions::EntryOutOfRange();
+  }
+  openFile(runFiles[irun], runTreeName);
+}
+
+
 int Wrapper::LoadBrbSettingsTree(){
 
   return BrbSettingsTree::Get()->LoadSettingsTree(file);
@@ -339,7 +489,7 @@ int Wrapper::getChannelForPmt(int pmt) const {
 
 
 int Wrapper::getPmtForChannel(int channel) const {
-  for (auto pmt : pmtData) {
+  for (auto& pmt : pmtData) {
     if (pmt.second->channel == channel) {
       return pmt.first;
     }
@@ -372,8 +522,17 @@ void Wrapper::setCurrentEntry(unsigned long long entry) {
     throw new Exceptions::EntryOutOfRange();
   }
 
-  this->tree->GetEntry(entry);
+  PERF_SCOPE( PerfRead );
+  // check the number of waveforms fits before reading them
+  numSamplesBranch->GetEntry(entry);
+  if (numSamples > maxSamples) {
+    growBuffers(numSamples, sampleSize);
+  }
+  if (zeroSuppressed) reserveZeroSuppressed(entry);
+  int nbytes = this->tree->GetEntry(entry);
+  PERF_COUNT( PerfBytesRead, nbytes > 0 ? nbytes : 0 );
   this->entry = entry;
+  if (zeroSuppressed) decodeZeroSuppressed();
 }
 
 
@@ -386,7 +545,7 @@ unsigned long long Wrapper::getNumSamples() const {
 
 
 double* Wrapper::getPmtSample(int pmt, unsigned long long sample) const {
-  if (sample > numSamples) {
+  if (sample >= numSamples) {
     throw new Exceptions::SampleOutOfRange();
   }
   auto pmtData = getDataForPmt(pmt);
@@ -402,7 +561,7 @@ int Wrapper::getSampleLength() const {
 }
 
 double Wrapper::getEventTimestamp(unsigned long long sample) const {
-  if(sample > nPoints_max or sample < 0){
+  if(sample >= numSamples || sample >= evt_timestamp.size()){
     throw new Exceptions::SampleOutOfRange();
   }
  
@@ -6,6 +6,7 @@
 #include "PTFAnalysis.hpp"
 #include "PTFQEAnalysis.hpp"
 #include "Utilities.hpp"
+#include "SlowControlIndex.hpp"
 #include <string>
 #include <iostream>
 #include <ostream>
@@ -51,28 +52,19 @@ int main(int argc, char** argv) {
   //string outname = string("output_0000") + argv[2] + ".root";
   //TFile * outFile = new TFile(outname.c_str(), "NEW");
 
-  vector<int> phidgets = {0, 1, 3, 4};
-  vector<PTF::PMT> activePMTs = {};
-  vector<PTF::Gantry> gantries = {PTF::Gantry0, PTF::Gantry1}; 
-  Wrapper wrapper = Wrapper(16384, 70, activePMTs, phidgets, gantries, PTF_CAEN_V1730);
-
-  wrapper.openFile(argv[1], "scan_tree");
+  // the ext2_temp readings of the run in time order, without reading the waveforms
+  SlowControlIndex sc;
+  if ( !sc.Build( argv[1], {} ) ) exit( EXIT_FAILURE );
+  if ( !sc.Has( "ext2_temp" ) ) {
+    cerr << "No ext2_temp branch in " << argv[1] << endl;
+    exit( EXIT_FAILURE );
+  }
+  const TimeSeries& temperature = sc[ "ext2_temp" ];
 
-  cerr << "Num entries: " << wrapper.getNumEntries() << endl << endl;
+  cerr << "Num readings: " << temperature.size() << endl << endl;
   
-  for (unsigned int i = 0; i < wrapper.getNumEntries(); i++) {
-      wrapper.setCurrentEntry(i);
-      //auto location = wrapper.getDataForCurrentEntry(PTF::Gantry1);
-      auto reading  = wrapper.getReadingTemperature();
-      auto time_value=wrapper.getReadingTime();
-      wrapper.setCurrentEntry(0);
-      auto time_s=wrapper.getReadingTime();
-      auto reading_2  = wrapper.getReadingTemperature();
-      cout <<wrapper.getCurrentEntry()<<endl;
-      //cerr << location.x << " " << location.y << " " << location.z << " "<<endl;
-      cerr <<" "<<reading.ext_2<< " "<<time_value.time_c-time_s.time_c <<endl;
-      //cout<<setprecision(5)<<time_value.time_c<<endl;
+  for (unsigned int i = 0; i < temperature.size(); i++) {
+      cout << temperature.entry(i) << endl; // readings that are not finite are left out
+      cerr << " " << temperature.value(i) << " " << temperature.time(i) - temperature.time(0) << endl;
   }
 }
-
-
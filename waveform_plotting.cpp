@@ -121,7 +121,7 @@ int main(int argc, char** argv) {
   
   vector<int> phidgets = {0, 1, 3};
   vector<PTF::Gantry> gantries = {PTF::Gantry0, PTF::Gantry1};
-  Wrapper wrapper = Wrapper(1, 1024, activePMTs, phidgets, gantries,mPMT_DIGITIZER);
+  Wrapper wrapper(activePMTs, phidgets, gantries,mPMT_DIGITIZER);
   wrapper.openFile( string(argv[1]), "scan_tree");
 
   // Retrieve waveform display for specified event number in each channel
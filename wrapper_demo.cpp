@@ -19,9 +19,8 @@ int main(void) {
   vector<PTF::Gantry> gantries = {PTF::Gantry0, PTF::Gantry1};
 
   // initialize the wrapper
-  auto wrapper = PTF::Wrapper(
-    6000, // the maximum number of samples
-    70, // the size of one sample
+  // the buffers are sized from the file when it is opened
+  PTF::Wrapper wrapper(
     activePMTs,
     phidgets,
     gantries,
@@ -49,7 +48,7 @@ int main(void) {
 
     for (size_t sample = 0; sample < numSamples; sample++) {
       // Gets a pointer to the data for PMT 1 for this sample
-      // It's an array with the length of one sample, set above, in this case 34.
+      // It's an array with the length of one sample, wrapper.getSampleLength().
       double* data = getPmtSample(1, sample);
       // do something with data
     }